@@ -199,6 +199,31 @@ typedef struct luaL_Stream {
 
 
 
+/*
+** {======================================================
+** String buffers of the strbuf library
+** =======================================================
+*/
+
+/*
+** A string buffer is a userdata with metatable 'LUA_STRBUFHANDLE' and
+** structure 'luaL_StrBuf'. Its block comes from 'lua_resizestrbuf', so
+** that 'lua_pushstrbuf' turns the contents into a string in place.
+*/
+
+#define LUA_STRBUFHANDLE        "STRBUF*"
+
+
+typedef struct luaL_StrBuf {
+  char *b;  /* block (NULL while nothing was reserved) */
+  size_t n;  /* number of bytes in use */
+  size_t size;  /* room in the block */
+} luaL_StrBuf;
+
+/* }====================================================== */
+
+
+
 /* compatibility with old module system */
 #if defined(LUA_COMPAT_MODULE)
 
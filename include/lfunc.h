@@ -30,11 +30,15 @@
 
 
 /*
-** Upvalues for Lua closures
+** Upvalues for Lua closures. Closures count their uses of an upvalue,
+** not of its value: while open, the value is referenced by its stack
+** slot; once closed, by the upvalue itself (one reference).
 */
 struct UpVal {
 	StkId v;  /* points to stack or to its own value */
-  lu_mem refcount;  /* reference counter */
+  lu_mem refcount;  /* number of closures using it */
+  lu_mem gcseen;  /* closures seen by the cycle pass 'gcpass' */
+  unsigned int gcpass;
   union {
     struct {  /* (when open) */
       UpVal *next;  /* linked list */
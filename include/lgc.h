@@ -129,6 +129,7 @@ void luaC_upvalbarrier(lua_State *L, UpVal *uv);
 
 LUAI_FUNC void luaC_fix(lua_State *L, GCObj *o);
 LUAI_FUNC void luaC_freeallobjects(lua_State *L);
+LUAI_FUNC void luaC_callallgc(lua_State *L);
 LUAI_FUNC void luaC_step(lua_State *L);
 LUAI_FUNC void luaC_runtilstate(lua_State *L, int statesmask);
 LUAI_FUNC void luaC_fullgc(lua_State *L, int isemergency);
@@ -0,0 +1,49 @@
+/*
+ ** Baseline compiler: hot Lua functions as x86-64 machine code
+ ** See Copyright Notice in lua.h
+ */
+
+#ifndef ljit_h
+#define ljit_h
+
+#include "lobject.h"
+#include "lstate.h"
+
+/*
+ ** The compiler emits x86-64 code into mmap'd pages, so it needs Linux
+ ** and GCC or Clang; define LUA_NOJIT to leave it out.
+ */
+#if !defined(LUA_USE_JIT) && !defined(LUA_NOJIT) && defined(__GNUC__) && \
+		defined(__x86_64__) && defined(__linux__)
+#define LUA_USE_JIT
+#endif
+
+/* function entries and backward jumps before a function gets compiled */
+#define LUAJ_HOTCOUNT	56
+
+#if defined(LUA_USE_JIT)
+
+#define LUAJ_ENABLED	1
+
+/*
+ ** is the function of a frame ready to run as native code? Counting
+ ** stops at LUAJ_HOTCOUNT, so a function that failed to compile is not
+ ** tried again.
+ */
+#define luaJ_hot(L,p)	(G(L)->jiton && ((p)->jit != NULL || \
+	((p)->hotcount < LUAJ_HOTCOUNT && ++(p)->hotcount == LUAJ_HOTCOUNT && \
+	luaJ_compile(L, p))))
+
+LUAI_FUNC int luaJ_compile(lua_State *L, Proto *p);
+LUAI_FUNC int luaJ_run(lua_State *L, CallInfo *ci);
+LUAI_FUNC void luaJ_free(lua_State *L, Proto *p);
+
+#else
+
+#define LUAJ_ENABLED	0
+
+#define luaJ_free(L,p)	((void)0)
+
+#endif
+
+#endif
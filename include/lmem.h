@@ -58,6 +58,50 @@
 
 LUAI_FUNC l_noret luaM_toobig (lua_State *L);
 
+/*
+** Cache of freed blocks of one size ('blocksize'), kept in the global
+** state. Its capacity adapts to the churn of the last epoch of
+** CACHE_EPOCH releases: it doubles when a burst overflowed it, and the
+** blocks that stayed unused for a whole epoch (its low watermark) are
+** given back to the allocator. Releases run on free paths (down to
+** 'lua_close'), so they never allocate: a full cache frees the block,
+** and a new capacity is only applied when a take finds the cache empty.
+*/
+#define CACHE_EPOCH	1024
+#define CACHE_MINLIMIT	32
+#define CACHE_MAXLIMIT	(1 << 16)
+
+typedef struct FreeCache {
+  void **items;
+  int n;  /* number of cached blocks */
+  int limit;  /* size of 'items' (high watermark) */
+  int target;  /* size for 'items' at the next miss */
+  int low;  /* fewest blocks cached during the current epoch */
+  int overflow;  /* releases that found the cache full in this epoch */
+  int ops;  /* releases in the current epoch */
+  size_t blocksize;
+} FreeCache;
+
+/* take a block from cache 'c'; NULL when it is empty */
+#define luaM_cacheget(L,c) \
+	((c)->n == 0 ? luaM_cachemiss(L, c) : \
+	 ((c)->n <= (c)->low ? (void)((c)->low = (c)->n - 1) : (void)0, \
+	  (c)->items[--(c)->n]))
+
+/* give block 'b' back to cache 'c' */
+#define luaM_cacheput(L,c,b) \
+	(++(c)->ops >= CACHE_EPOCH || (c)->n == (c)->limit \
+		? luaM_cacherelease(L, c, b) : (void)((c)->items[(c)->n++] = (b)))
+
+LUAI_FUNC void luaM_cacheinit (FreeCache *c, size_t blocksize);
+LUAI_FUNC void luaM_cacherelease (lua_State *L, FreeCache *c, void *block);
+LUAI_FUNC void *luaM_cachemiss (lua_State *L, FreeCache *c);
+LUAI_FUNC size_t luaM_cachetrim (lua_State *L, FreeCache *c);
+LUAI_FUNC size_t luaM_cachebytes (const FreeCache *c);
+LUAI_FUNC void luaM_initcaches (lua_State *L);
+LUAI_FUNC size_t luaM_trimcaches (lua_State *L);
+LUAI_FUNC size_t luaM_cachedbytes (lua_State *L);
+
 /* not to be called directly */
 LUAI_FUNC void *luaM_realloc_ (lua_State *L, void *block, size_t oldsize,
                                                           size_t size);
@@ -0,0 +1,32 @@
+/*
+ ** Conversions between numbers and numerals
+ ** See Copyright Notice in lua.h
+ */
+
+#ifndef lnumber_h
+#define lnumber_h
+
+#include "llimits.h"
+#include "lua.h"
+
+/*
+ ** The fast paths assume IEEE doubles formatted with "%.<n>g" (see
+ ** LUA_NUMBER_DIGITS) and a compiler with 128-bit integers; define
+ ** LUA_NOFASTNUM to always go through the C library instead.
+ */
+#if !defined(LUA_NOFASTNUM) && LUA_FLOAT_TYPE == LUA_FLOAT_DOUBLE && \
+		defined(LUA_NUMBER_DIGITS) && defined(__SIZEOF_INT128__)
+#define LUAN_FAST
+#endif
+
+/* largest precision handled without the C library */
+#define LUAN_MAXPREC	17
+
+/* buffer size that is always enough for the fast paths */
+#define LUAN_BUFFSZ	32
+
+LUAI_FUNC int luaN_int2str(char *buff, size_t sz, lua_Integer n);
+LUAI_FUNC int luaN_num2str(char *buff, size_t sz, lua_Number n, int prec);
+LUAI_FUNC const char *luaN_str2d(const char *s, lua_Number *result);
+
+#endif
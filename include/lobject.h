@@ -298,9 +298,9 @@ typedef struct TString {
 //	Value *data; VarType tt:8;
 	GCHead;
 	lu_byte extra; /* reserved words for short strings; "has hash" for longs */
-	lu_byte info; /* length for short strings */
+	lu_byte info; /* kind of a long string (LSTR*); API cache set of a short one */
 	unsigned int hash; //length
-	size_t length; /* length for long strings */
+	size_t length; /* length, for short and long strings */
 	char val[];
 } TString;
 
@@ -313,11 +313,31 @@ typedef union UTString {
 } UTString;
 
 /*
- ** Get the actual string (array of bytes) from a 'TString'.
- ** (Access to 'extra' ensures that value is really a 'TString'.)
+ ** Kinds of long string, kept in 'info' (short strings use it only for
+ ** the API string cache, see 'STRCACHED'):
+ ** a growable string keeps spare room for in-place appends (see
+ ** 'luaV_concat'); a slice borrows its bytes from a parent long string
+ ** (see 'luaS_sub') and its 'val' holds a 'StrSlice' instead of them.
+ */
+#define LSTRPLAIN	0
+#define LSTRGROW	1
+#define LSTRSLICE	2
+
+typedef struct StrSlice {
+	const char *data; /* first byte, inside 'parent' */
+	TString *parent; /* plain or growable string kept alive by the slice */
+	char *cstr; /* '\0'-terminated copy, made on demand (see 'luaS_cstr') */
+} StrSlice;
+
+#define strslice(ts)	cast(StrSlice *, (ts)->val)
+#define isslice(ts)	((ts)->info == LSTRSLICE)
+
+/*
+ ** Get the actual string (array of bytes) from a 'TString'. For a slice
+ ** the bytes are not necessarily followed by a '\0'.
  */
 #define getstr(ts)  \
-  ((ts)->val)
+  (isslice(ts) ? cast(char *, strslice(ts)->data) : (ts)->val)
 
 /* get the actual string (array of bytes) from a Lua value */
 #define svalue(o)       getstr(tsvalue(o))
@@ -411,6 +431,8 @@ struct Proto {
 	LocVar *locvars; /* information about local variables (debug information) */
 	Upvaldesc *upvalues; /* upvalue information */
 	struct LClosure *cache; /* last-created closure with this prototype */
+	struct JitCode *jit; /* native code of the function (see 'ljit.c') */
+	int hotcount; /* entries and backward jumps, up to LUAJ_HOTCOUNT */
 	TString *source; /* used for debug information */
 	Module *module;
 	GCObj *gclist;
@@ -490,11 +512,13 @@ typedef struct Table {
 	GCHead;
 	lu_byte flags; /* 1<<p means tagmethod(p) is not present */
 	lu_byte type;
+	lu_byte keepsize; /* pinned by 'table.new', 'table.reserve' or 'table.clear': never shrink */
 	unsigned int sizearray; /* size of 'array' array */
 	TValue **array; /* array part */
 	Entry *entry; //Node *node;
 	lua_Integer nodemask; //Node *lastfree; /* any free position is before this position */
 	struct Table *metatable;
+	struct TMCache *tmcache; /* resolved metamethods, when it is a metatable */
 	GCObj *gclist; //Table *
 	lua_Integer lsizenode; /* log2 of size of 'node' array */
 	lua_Integer length;
@@ -554,18 +578,19 @@ void const_destroy(lua_State *L);
 	*(L->top) =cast(TValue*,obj);\
 	api_incr_top(L);\
 }while(0)
+/* the slot is cleared first: a '__gc' run by 'refDec' pushes onto it */
 #define stack_pop(L) do{\
-	L->top--;\
-  refDec(L, *L->top);\
+	TValue *_o = *--L->top;\
   *L->top = NULL;\
+  refDec(L, _o);\
 }while(0)
 #define box_remove(L,bp) do{\
   qlist l = (qlist) (G(L)->boxs);\
-  List.remove(l, (lNode) bp, 0);\
+  List.remove(l, (lNode) bp);\
 }while(0)
 #ifdef LUA_OBJ_DEBUG
 #define obj_remove(L,ob) \
-	lua_assert(list_del((qlist) (G(L)->objs), (listType ) ob))
+	lua_assert(list_del(L, (qlist) (G(L)->objs), (listType ) ob))
 #else
 #define obj_remove(L,ob)
 #endif
@@ -575,19 +600,23 @@ void const_destroy(lua_State *L);
   list_head(boxs));\
 }while(0)
 
+/* the new value is referenced before the old one is released, so that
+ * assigning a slot to itself (e.g. 'ra == rb' in OP_CONCAT) is safe */
 static inline void setsvalue(lua_State *L, StkId obj, TString *x) {
-	if (!ttisnil(*obj))
-		refDec(L, *obj);
-	*obj = (TValue*) x;
+	TValue *old = *obj;
 	refInc(x);
+	*obj = (TValue*) x;
+	if (!ttisnil(old))
+		refDec(L, old);
 	checkliveness(L, x);
 }
 static inline void setobj2s(lua_State *L, StkId obj1, const TValue *obj2) {
-	if (!ttisnil(*obj1)) {
-		refDec(L, *obj1);
-	}
-	*obj1 = (TValue *) (obj2);
+	TValue *old = *obj1;
 	refInc(obj2);
+	*obj1 = (TValue *) (obj2);
+	if (!ttisnil(old)) {
+		refDec(L, old);
+	}
 }
 
 static inline void moveobj(lua_State *L, StkId obj1, StkId obj2) {
@@ -598,10 +627,10 @@ static inline void moveobj(lua_State *L, StkId obj1, StkId obj2) {
 	checkliveness(L, obj1);
 }
 static inline void setobj(lua_State *L, StkId obj1, StkId obj2) {
-	TValue *o = *obj2;
-	refDec(L, *obj1);
-	*obj1 = o;
+	TValue *o = *obj2, *old = *obj1;
 	refInc(o);
+	*obj1 = o;
+	refDec(L, old);
 }
 #endif
 
@@ -209,16 +209,35 @@ OP_TAILCALL ,/*	A B C	return R(A)(R(A+1), ... ,R(A+B-1))		*/
 OP_RETURN   ,/*	A B	return R(A), ... ,R(A+B-2)	(see note)	*/
 OP_FORLOOP  ,/*	A sBx	R(A)+=R(A+2);if R(A) <?= R(A+1) then { pc+=sBx; R(A+3)=R(A) }*/
 OP_FORPREP  ,/*	A sBx	R(A)-=R(A+2); pc+=sBx				*/
-OP_TFORCALL ,/*	A C	R(A+3), ... ,R(A+2+C) := R(A)(R(A+1), R(A+2));	*/
-OP_TFORLOOP ,/*	A sBx	if R(A+1) ~= nil then { R(A)=R(A+1); pc += sBx }*/
+OP_TFORCALL ,/*	A C	R(A+4), ... ,R(A+3+C) := R(A)(R(A+1), R(A+2));	*/
+OP_TFORLOOP ,/*	A sBx	if R(A+2) ~= nil then { R(A)=R(A+2); pc += sBx }*/
 OP_SETLIST  ,/*	A B C	R(A)[(C-1)*FPF+i] := R(A+i), 1 <= i <= B	*/
 OP_CLOSURE  ,/*	A Bx	R(A) := closure(KPROTO[Bx])			*/
 OP_VARARG   ,/*	A B	R(A), R(A+1), ..., R(A+B-2) = vararg		*/
 OP_EXTRAARG ,/*	Ax	extra (larger) argument for previous opcode	*/
+
+/* superinstructions (see note) */
+OP_GETTABUPCALL,/*	A B C	OP_GETTABUP, then the OP_CALL that follows	*/
+OP_SELFCALL ,/*	A B C	OP_SELF, then the OP_CALL that follows		*/
+OP_EQBOOL   ,/*	A B C	OP_EQ, then the OP_LOADBOOL it goes to		*/
+OP_LTBOOL   ,/*	A B C	OP_LT, then the OP_LOADBOOL it goes to		*/
+OP_LEBOOL   ,/*	A B C	OP_LE, then the OP_LOADBOOL it goes to		*/
+OP_VARARGCALL,/*	A B	OP_VARARG, then the (tail) call of R(A-2) that follows */
+
+/* quickened opcodes (see note) */
+OP_LTNUM    ,/*	A B C	OP_LT when RK(B) and RK(C) are numbers		*/
+OP_LENUM    ,/*	A B C	OP_LE when RK(B) and RK(C) are numbers		*/
+OP_GETTABLEI,/*	A B C	OP_GETTABLE of the array part of a table	*/
+OP_GETTABLES /*	A B C	OP_GETTABLE with a short string key		*/
 } OpCode;
 
 
-#define NUM_OPCODES	(cast(int, OP_EXTRAARG) + 1)
+#define NUM_OPCODES	(cast(int, OP_GETTABLES) + 1)
+
+#define FIRST_FUSED	OP_GETTABUPCALL
+#define FIRST_QUICK	OP_LTNUM
+
+#define isquick(o)	((o) >= FIRST_QUICK)
 
 
 
@@ -236,6 +255,10 @@ OP_EXTRAARG ,/*	Ax	extra (larger) argument for previous opcode	*/
   (*) In OP_SETLIST, if (B == 0) then B = 'top'; if (C == 0) then next
   'instruction' is EXTRAARG(real C).
 
+  (*) In OP_TFORCALL, R(A+3) is the traversal cursor: when R(A) is the
+  library 'next' and R(A+1) a table, the table is stepped directly and
+  the cursor keeps the position of the last key.
+
   (*) In OP_LOADKX, the next 'instruction' is always EXTRAARG.
 
   (*) For comparisons, A specifies what condition the test should accept
@@ -243,6 +266,22 @@ OP_EXTRAARG ,/*	Ax	extra (larger) argument for previous opcode	*/
 
   (*) All 'skips' (pc++) assume that next instruction is a jump.
 
+  (*) A superinstruction only replaces the opcode of the first
+  instruction of a pair (see 'luaK_fuse'); it does the same as that
+  opcode and then runs the next instruction to be executed, which stays
+  in place, without a dispatch. So jumps into the pair, line information
+  and an interrupted superinstruction all see the plain code.
+
+  (*) When R(A-2) is the library 'select', OP_VARARGCALL does the call
+  'select(R(A-1), ...)' itself, reading the vararg arguments in place,
+  and skips the OP_CALL (or the OP_TAILCALL, leaving the results to the
+  OP_RETURN after it).
+
+  (*) The interpreter rewrites a plain opcode into its quickened form
+  after seeing the operand types that form handles, and back when a
+  guard fails ('quicken' in lvm.c). Dumps carry the plain opcode, for
+  these and for superinstructions, which loading fuses again.
+
 ===========================================================================*/
 
 
@@ -273,6 +312,12 @@ LUAI_DDEC const lu_byte luaP_opmodes[NUM_OPCODES];
 
 LUAI_DDEC const char *const luaP_opnames[NUM_OPCODES+1];  /* opcode names */
 
+LUAI_DDEC const lu_byte luaP_plainops[NUM_OPCODES - FIRST_FUSED];
+
+/* plain opcode that a superinstruction or a quickened opcode stands for */
+#define plainop(o)	((o) < FIRST_FUSED ? (o) : \
+			cast(OpCode, luaP_plainops[(o) - FIRST_FUSED]))
+
 
 /* number of list items to accumulate before a SETLIST instruction */
 #define LFIELDS_PER_FLUSH	50
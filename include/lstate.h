@@ -63,6 +63,9 @@ struct lua_longjmp;
 
 #define BASIC_STACK_SIZE        (3*LUA_MINSTACK)
 
+/* 'CallInfo's allocated with the stack, in one block (see 'cis') */
+#define BASIC_CI_SIZE	16
+
 /* kinds of Garbage Collection */
 #define KGC_NORMAL	0
 #define KGC_EMERGENCY	1	/* gc was forced by an allocation failure */
@@ -125,6 +128,16 @@ typedef struct CallInfo {
 /*
  ** 'global state', shared by all threads of this state
  */
+/* kinds of blocks kept in 'global_State.cache' */
+#define CACHE_TABLE	0 /* 'Table' objects, with their 'GCPrefix' */
+#define CACHE_MAP	1 /* 'NodeMap' hash nodes */
+#define CACHE_SET	2 /* 'NodeSet' hash nodes */
+#define CACHE_LIST	3 /* 'qlist' headers */
+#define CACHE_LNODE	4 /* 'qlist' nodes */
+#define CACHE_N		5
+
+#define gcache(L,i)	(&G(L)->cache[i])
+
 typedef struct global_State {
 	lua_Alloc frealloc; /* function to reallocate memory */
 	void *ud; /* auxiliary data to 'frealloc' */
@@ -165,6 +178,13 @@ typedef struct global_State {
 	TString *memerrmsg; /* memory-error message */
 	TString *tmname[TM_N]; /* array with tag-method names */
 	struct Table *mt[LUA_NUMTAGS]; /* metatables for basic types */
+	lua_CFunction iternext; /* 'next' of the base library (see OP_TFORCALL) */
+	lua_CFunction iteripairs; /* 'ipairs' iterator of the base library */
+	lua_CFunction select; /* 'select' of the base library (see OP_VARARGCALL) */
+	lu_byte collate; /* collation mode for strings (LUA_COLL*) */
+	lu_byte bytecmp; /* compare strings bytewise? (see 'luaV_setcollate') */
+	lu_byte jiton; /* compile hot functions? (see 'ljit.c') */
+	int njit; /* number of functions with native code */
 #ifdef USE_INT_POOL
 	Table *intt;
 #else
@@ -174,7 +194,8 @@ typedef struct global_State {
 //	GCPrefix *finboxs;
 	ObjNode *recycle_bin;
 	ObjNode *objs;
-//  TString *strcache[STRCACHE_N][STRCACHE_M];  /* cache for strings in API */
+	FreeCache cache[CACHE_N]; /* freed blocks kept for reuse (see lmem.h) */
+	TString *strcache[STRCACHE_N][STRCACHE_M]; /* cache for strings in API */
 } global_State;
 
 extern global_State *_G;
@@ -183,7 +204,7 @@ extern global_State *_G;
  */
 struct lua_State {
 	GCHead;
-	unsigned short nci; /* number of items in 'ci' list */
+	unsigned short nci; /* number of items in 'ci' list, besides 'cis' */
 	StatusThred status;
 	StkId top; /* first free slot in the stack */
 	global_State *l_G;
@@ -196,6 +217,7 @@ struct lua_State {
 	struct lua_State *twups; /* list of threads with open upvalues */
 	struct lua_longjmp *errorJmp; /* current error recover point */
 	CallInfo base_ci; /* CallInfo for first level (C calling Lua) */
+	CallInfo *cis; /* the first BASIC_CI_SIZE items after 'base_ci' */
 	volatile lua_Hook hook;
 	ptrdiff_t errfunc; /* current error handling function (stack index) */
 	int stacksize;
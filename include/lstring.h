@@ -14,6 +14,35 @@
 #define sizelstring(l)  (sizeof(ObjPrefix)+sizeof(union UTString) + ((l) + 1) * sizeof(char))
 #define sizesstring(l)  (sizeof(NodeSet)+sizeof(ObjPrefix)+sizeof(union UTString) + ((l) + 1) * sizeof(char))
 
+/*
+ ** A long string built by repeated concatenation keeps spare room for
+ ** in-place appends: its block holds 'luaS_capacity(length)' characters
+ ** (see 'luaV_concat'). The block of a slice holds only its 'StrSlice'.
+ */
+#define isgrowable(ts)	((ts)->info == LSTRGROW)
+#define sizelngstr(ts) sizelstring(isgrowable(ts) ? \
+		luaS_capacity((ts)->length) : \
+		isslice(ts) ? sizeof(StrSlice) : (ts)->length)
+
+/*
+ ** A substring of a long string shares its parent's bytes only when it
+ ** is long (short strings are interned) and is at least 1/LSTRSLICERATIO
+ ** of the parent, so that a small slice never pins a large buffer
+ */
+#define LSTRSLICERATIO	16
+
+/*
+ ** A short string in the API string cache (see 'luaS_new') keeps the
+ ** index of its cache set in 'info', so that freeing it clears just that
+ ** set. These values never clash with the kinds of long string.
+ */
+#define STRCACHED	0x80
+#define incache(ts)	((ts)->info & STRCACHED)
+#define cacheset(ts)	((ts)->info & ~STRCACHED)
+
+/* '\0'-terminated contents of 'ts' */
+#define luaS_cstr(L,ts)	(isslice(ts) ? luaS_terminate(L, ts) : getstr(ts))
+
 #define sizeludata(l)	(sizeof(union UUdata) + (l))
 #define sizeudata(u)	sizeludata((u)->len)
 
@@ -42,5 +71,13 @@ LUAI_FUNC Udata *luaS_newudata(lua_State *L, size_t s);
 LUAI_FUNC TString *luaS_newlstr(lua_State *L, const char *str, size_t l);
 LUAI_FUNC TString *luaS_new(lua_State *L, const char *str);
 LUAI_FUNC TString *luaS_createlngstrobj(lua_State *L, size_t l);
+LUAI_FUNC size_t luaS_capacity(size_t l);
+LUAI_FUNC TString *luaS_newgrowable(lua_State *L, size_t l);
+LUAI_FUNC TString *luaS_growlngstr(lua_State *L, TString *ts, size_t l);
+LUAI_FUNC char *luaS_resizebuff(lua_State *L, char *b, size_t ocap, size_t cap);
+LUAI_FUNC TString *luaS_adoptbuff(lua_State *L, char *b, size_t cap, size_t l);
+LUAI_FUNC TString *luaS_sub(lua_State *L, TString *ts, size_t i, size_t l);
+LUAI_FUNC const char *luaS_terminate(lua_State *L, TString *ts);
+LUAI_FUNC void luaS_freeslice(lua_State *L, TString *ts);
 
 #endif
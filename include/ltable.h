@@ -8,6 +8,7 @@
 #define ltable_h
 
 #include "lobject.h"
+#include "ltm.h"
 
 //#define gnode(t,i)	(&(t)->node[i])
 //#define gval(n)		(&(n)->i_val)
@@ -20,7 +21,13 @@
  ** but not to the whole (which has incompatible type)
  */
 //#define wgkey(n)		(&(n)->i_key.nk)
-#define invalidateTMcache(t)	((t)->flags = 0)
+#define invalidateTMcache(t)	((t)->flags = 0, (t)->tmcache == NULL ? 0 : \
+	((t)->tmcache->known = 0))
+
+/* writing key 'k' may change a metamethod only if its name starts with "__" */
+#define invalidateTMkey(t,k) \
+	{ if (ttisstring(k) && getstr(tsvalue(k))[0] == '_' && \
+			getstr(tsvalue(k))[1] == '_') invalidateTMcache(t); }
 
 /* true when 't' is using 'dummynode' as its hash part */
 #define isdummy(t)		(sizenode(t) == 0)
@@ -32,13 +39,13 @@
 #define keyfromval(v) \
   (gkey(cast(Node *, cast(char *, (v)) - offsetof(Node, i_val))))
 
-LUAI_FUNC const TValue *luaH_getint(Table *t, lua_Integer key);
+LUAI_FUNC const TValue *luaH_getint(lua_State *L, Table *t, lua_Integer key);
 LUAI_FUNC void luaH_setint(lua_State *L, Table *t, lua_Integer key,
 		TValue *value);
 LUAI_FUNC const TValue *luaH_getshortstr(Table *t, TString *key);
-LUAI_FUNC const TValue *luaH_getstr(Table *t, TString *key);
+LUAI_FUNC const TValue *luaH_getstr(lua_State *L, Table *t, TString *key);
 
-LUAI_FUNC TValue *luaH_get(Table *t, const TValue *key);
+LUAI_FUNC TValue *luaH_get(lua_State *L, Table *t, const TValue *key);
 LUAI_FUNC TValue *luaH_newkey(lua_State *L, Table *t, const TValue *key);
 LUAI_FUNC TValue *luaH_set(lua_State *L, Table *t, const TValue *key);
 LUAI_FUNC Table *luaH_new(lua_State *L);
@@ -48,6 +55,8 @@ LUAI_FUNC void luaH_resize(lua_State *L, Table *t, unsigned int nasize,
 LUAI_FUNC void luaH_resizearray(lua_State *L, Table *t, unsigned int nasize);
 //LUAI_FUNC void luaH_free(lua_State *L, Table *t);
 LUAI_FUNC int luaH_next(lua_State *L, Table *t, StkId key);
+LUAI_FUNC int luaH_nextc(lua_State *L, Table *t, StkId key,
+		lua_Integer *cursor);
 lua_Integer gethash(const TValue *key);
 LUAI_FUNC lua_Unsigned luaH_getn(Table *t);
 
@@ -57,11 +66,15 @@ LUAI_FUNC TValue *luaH_gset_int(lua_State *L, Table *t, lua_Integer key);
 LUAI_FUNC void luaH_free(lua_State *L, Table *t);
 LUAI_FUNC void luaH_resize_(lua_State *L, Table *t, lua_Integer size);
 LUAI_FUNC int luaH_setifexist(lua_State *L, Table *t, TValue *key, TValue *val);
+LUAI_FUNC void luaH_clear(lua_State *L, Table *t);
 LUAI_FUNC void luaH_free_set(lua_State *L, Table *t);
 LUAI_FUNC int luaH_del(lua_State *L, Table *t, const TValue *key, NodeMap *res);
 int luaH_del_set(lua_State *L, Table *t, const TValue *key, lua_Integer hash);
 void luaH_setdel(lua_State *L, Table *t, TValue *key, TValue *value);
-void table_clear_cache();
+#ifdef USE_INT_POOL
 #define int_get(L,i) luaH_gset_int(L, G(L)->intt, i)
+#else /* 'intt' is a plain vector, which 'luaH_gset_int' reads itself */
+#define int_get(L,i) luaH_gset_int(L, NULL, i)
+#endif
 
 #endif
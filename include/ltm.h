@@ -45,10 +45,25 @@ typedef enum {
 
 
 
+/*
+** Metamethods resolved in a metatable, allocated by its first lookup
+** through 'fasttm' and emptied by writes to it (see 'invalidateTMcache'):
+** 'tm[e]' holds the metamethod for event 'e' (NULL if there is none)
+** when bit 'e' of 'known' is set.
+*/
+typedef struct TMCache {
+  unsigned int known;
+  const TValue *tm[TM_N];
+} TMCache;
+
+
+/* negative cache only ('flags'), for the collector */
 #define gfasttm(g,et,e) ((et) == NULL ? NULL : \
   ((et)->flags & (1u<<(e))) ? NULL : luaT_gettm(et, e, (g)->tmname[e]))
 
-#define fasttm(l,et,e)	gfasttm(G(l), et, e)
+#define fasttm(l,et,e)	((et) == NULL ? NULL : \
+  ((et)->tmcache != NULL && ((et)->tmcache->known & (1u<<(e)))) ? \
+    (et)->tmcache->tm[e] : luaT_gettmcached(l, et, e))
 
 #define ttypename(x)	luaT_typenames_[(x) + 1]
 
@@ -58,6 +73,8 @@ LUAI_DDEC const char *const luaT_typenames_[LUA_TOTALTAGS];
 LUAI_FUNC const char *luaT_objtypename (lua_State *L, const TValue *o);
 
 LUAI_FUNC const TValue *luaT_gettm (Table *events, TMS event, TString *ename);
+LUAI_FUNC const TValue *luaT_gettmcached (lua_State *L, Table *events,
+                                                        TMS event);
 LUAI_FUNC const TValue *luaT_gettmbyobj (lua_State *L, const TValue *o,
                                                        TMS event);
 LUAI_FUNC void luaT_init (lua_State *L);
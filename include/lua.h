@@ -205,6 +205,7 @@ LUA_API lua_Number (lua_tonumberx)(lua_State *L, int idx, int *isnum);
 LUA_API lua_Integer (lua_tointegerx)(lua_State *L, int idx, int *isnum);
 LUA_API int (lua_toboolean)(lua_State *L, int idx);
 LUA_API const char *(lua_tolstring)(lua_State *L, int idx, size_t *len);
+LUA_API const char *(lua_tolstringview)(lua_State *L, int idx, size_t *len);
 LUA_API size_t (lua_rawlen)(lua_State *L, int idx);
 LUA_API lua_CFunction (lua_tocfunction)(lua_State *L, int idx);
 LUA_API void *(lua_touserdata)(lua_State *L, int idx);
@@ -247,6 +248,10 @@ LUA_API void (lua_pushnumber)(lua_State *L, lua_Number n);
 LUA_API void (lua_pushinteger)(lua_State *L, lua_Integer n);
 LUA_API const char *(lua_pushlstring)(lua_State *L, const char *s, size_t len);
 LUA_API const char *(lua_pushstring)(lua_State *L, const char *s);
+LUA_API const char *(lua_pushsubstring)(lua_State *L, int idx, size_t i,
+		size_t len);
+LUA_API const char *(lua_pushstrbuf)(lua_State *L, char *b, size_t size,
+		size_t len);
 LUA_API const char *(lua_pushvfstring)(lua_State *L, const char *fmt,
 		va_list argp);
 LUA_API const char *(lua_pushfstring)(lua_State *L, const char *fmt, ...);
@@ -324,6 +329,8 @@ LUA_API int (lua_isyieldable)(lua_State *L);
 #define LUA_GCSETPAUSE		6
 #define LUA_GCSETSTEPMUL	7
 #define LUA_GCISRUNNING		9
+#define LUA_GCCACHED		10  /* bytes held in free-block caches */
+#define LUA_GCTRIM		11  /* release them; returns the bytes freed */
 
 LUA_API int (lua_gc)(lua_State *L, int what, int data);
 
@@ -339,6 +346,42 @@ LUA_API void (lua_concat)(lua_State *L, int n);
 LUA_API void (lua_len)(lua_State *L, int idx);
 
 LUA_API size_t (lua_stringtonumber)(lua_State *L, const char *s);
+LUA_API int (lua_numbertobuff)(char *buff, size_t sz, lua_Number n, int prec);
+LUA_API int (lua_integertobuff)(char *buff, size_t sz, lua_Integer n);
+
+/*
+ ** collation of strings in order comparisons: bytewise when LC_COLLATE
+ ** is "C", "POSIX" or "C.UTF-8" (the default), always bytewise, or always
+ ** with 'strcoll'. A negative mode keeps the current one; every call checks
+ ** the locale again.
+ */
+#define LUA_COLLAUTO	0
+#define LUA_COLLBYTES	1
+#define LUA_COLLLOCALE	2
+
+LUA_API int (lua_collate)(lua_State *L, int mode);
+
+/*
+ ** the baseline compiler of hot functions (where it is built in; off by
+ ** default): ON and OFF switch it and return the previous state, STATUS
+ ** returns the current one and COUNT the number of functions with native
+ ** code
+ */
+#define LUA_JITOFF	0
+#define LUA_JITON	1
+#define LUA_JITSTATUS	2
+#define LUA_JITCOUNT	3
+
+LUA_API int (lua_jit)(lua_State *L, int what);
+
+/*
+ ** blocks for string buffers, which 'lua_pushstrbuf' turns into a string
+ ** without copying: 'lua_resizestrbuf' moves the block at 'b' (NULL for
+ ** a new one) with room for '*size' bytes to one with room for at least
+ ** 'n' (updating '*size'), or frees it when 'n' is 0
+ */
+LUA_API char *(lua_resizestrbuf)(lua_State *L, char *b, size_t *size,
+		size_t n);
 
 LUA_API lua_Alloc (lua_getallocf)(lua_State *L, void **ud);
 LUA_API void (lua_setallocf)(lua_State *L, lua_Alloc f, void *ud);
@@ -422,6 +422,7 @@
 ** by prefixing it with one of FLT/DBL/LDBL.
 @@ LUA_NUMBER_FRMLEN is the length modifier for writing floats.
 @@ LUA_NUMBER_FMT is the format for writing floats.
+@@ LUA_NUMBER_DIGITS is the precision used in LUA_NUMBER_FMT.
 @@ lua_number2str converts a float to a string.
 @@ l_mathop allows the addition of an 'l' or 'f' to all math operations.
 @@ l_floor takes the floor of a float.
@@ -462,6 +463,7 @@
 
 #define LUA_NUMBER_FRMLEN	""
 #define LUA_NUMBER_FMT		"%.7g"
+#define LUA_NUMBER_DIGITS	7
 
 #define l_mathop(op)		op##f
 
@@ -478,6 +480,7 @@
 
 #define LUA_NUMBER_FRMLEN	"L"
 #define LUA_NUMBER_FMT		"%.19Lg"
+#define LUA_NUMBER_DIGITS	19
 
 #define l_mathop(op)		op##l
 
@@ -493,6 +496,7 @@
 
 #define LUA_NUMBER_FRMLEN	""
 #define LUA_NUMBER_FMT		"%.14g"
+#define LUA_NUMBER_DIGITS	14
 
 #define l_mathop(op)		op
 
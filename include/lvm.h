@@ -48,6 +48,21 @@
 #define luaV_rawequalobj(t1,t2)		luaV_equalobj(NULL,t1,t2)
 
 
+/*
+** Indices of numeric 'for' loops. A box that only its register refers
+** to is updated in place; a new one (see 'luaC_newobjNotGC') is made
+** only when something else kept the old value, so a loop that just
+** reads its variable does not allocate.
+*/
+#define luaV_setforidx(L,r,t,f,x) { TValue *io_ = *(r); \
+  if (io_ != NULL && checktag(io_, t) && getRef(io_) == 1) val_(io_).f = (x); \
+  else { io_ = luaC_newobjNotGC(L, t, sizeof(TValue)); val_(io_).f = (x); \
+         setobj2s(L, r, io_); } }
+
+#define luaV_setforint(L,r,x)	luaV_setforidx(L,r,LUA_TNUMINT,i,x)
+#define luaV_setforflt(L,r,x)	luaV_setforidx(L,r,LUA_TNUMFLT,n,x)
+
+
 /*
 ** fast track for 'gettable': if 't' is a table and 't[k]' is not nil,
 ** return 1 with 'slot' pointing to 't[k]' (final result).  Otherwise,
@@ -58,7 +73,7 @@
 #define luaV_fastget(L,t,k,slot,f) \
   (!ttistable(t)  \
    ? (slot = NULL, 0)  /* not a table; 'slot' is NULL and result is 0 */  \
-   : (slot = f(hvalue(t), k),  /* else, do raw access */  \
+   : (slot = f(L, hvalue(t), k),  /* else, do raw access */  \
       !ttisnil(slot)))  /* result not nil? */
 
 /*
@@ -99,11 +114,13 @@ LUAI_FUNC void luaV_finishget (lua_State *L, const TValue *t, TValue *key,
 LUAI_FUNC void luaV_finishset (lua_State *L, const TValue *t, TValue *key,
 															TValue *val, const TValue *slot);
 LUAI_FUNC void luaV_finishOp (lua_State *L);
+LUAI_FUNC void luaV_forprep (lua_State *L, StkId ra);
 LUAI_FUNC void luaV_execute (lua_State *L);
 LUAI_FUNC void luaV_concat (lua_State *L, int total);
 LUAI_FUNC lua_Integer luaV_div (lua_State *L, lua_Integer x, lua_Integer y);
 LUAI_FUNC lua_Integer luaV_mod (lua_State *L, lua_Integer x, lua_Integer y);
 LUAI_FUNC lua_Integer luaV_shiftl (lua_Integer x, lua_Integer y);
 LUAI_FUNC void luaV_objlen (lua_State *L, StkId ra, const TValue *rb);
+LUAI_FUNC void luaV_setcollate (global_State *g, int mode);
 void printcode(Instruction i, int pc);
 #endif
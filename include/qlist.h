@@ -30,31 +30,33 @@ typedef struct linklist {
 
 struct apiList {
 	//创建链表
-	qlist (*create)();
-	lNode (*newnode)(qlist l, listType data);
+	qlist (*create)(lua_State *L);
+	lNode (*newnode)(lua_State *L, qlist l, listType data);
 	//把data的内容插入到链表list的末尾
-	lNode (*append)(qlist linklist, listType data);
+	lNode (*append)(lua_State *L, qlist linklist, listType data);
 
 	//把data的内容插入到链表的迭代器it_before的前面
 	//assign指定数据data间的赋值方法
-	lNode (*insert)(qlist linklist, listType data);
+	lNode (*insert)(lua_State *L, qlist linklist, listType data);
 	void (*linkNodeToPrev)(qlist linklist, lNode data, lNode lnode);
 
-	//删除链表list中node指向的结点
-	bool (*remove)(qlist linklist, lNode node, bool del);
-	bool (*del)(qlist list, listType data);
+	//从链表list中分离node指向的结点，并不free
+	bool (*remove)(qlist linklist, lNode node);
+	//删除链表list中node指向的结点，并free
+	bool (*delnode)(lua_State *L, qlist linklist, lNode node);
+	bool (*del)(lua_State *L, qlist list, listType data);
 	//返回list中第index个数据的指针
 	lNode (*at)(qlist linklist, int index);
 
 	//销毁list
-	void (*destroy)(qlist *list_ptr, void (*destructor)(listType));
+	void (*destroy)(lua_State *L, qlist *list_ptr, void (*destructor)(listType));
 
-	lNode (*push_back)(qlist l, listType data);
+	lNode (*push_back)(lua_State *L, qlist l, listType data);
 
-	lNode (*push_front)(qlist l, listType data);
-	listType (*pop_back)(qlist l);
-	listType (*pop_front)(qlist l);
-	qlist (*addArray)(qlist l, intptr_t *data, int n);
+	lNode (*push_front)(lua_State *L, qlist l, listType data);
+	listType (*pop_back)(lua_State *L, qlist l);
+	listType (*pop_front)(lua_State *L, qlist l);
+	qlist (*addArray)(lua_State *L, qlist l, intptr_t *data, int n);
 	bool (*exist_node)(qlist list, lNode node);
 	bool (*exist)(qlist list, listType data);
 	void (*merge)(qlist to, qlist from);
@@ -63,26 +65,27 @@ struct apiList {
 extern struct apiList List;
 
 #define LIST_API inline
-LIST_API qlist list_create();
+LIST_API qlist list_create(lua_State *L);
 
 //把data的内容插入到链表list的末尾
 //assign指定数据data间的赋值方法
-LIST_API lNode list_append(qlist list, void *data);
+LIST_API lNode list_append(lua_State *L, qlist list, void *data);
 
 //把data的内容插入到链表的迭代器it_before的前面
 //assign指定数据data间的赋值方法
-LIST_API lNode list_insert(qlist list, void *data);
+LIST_API lNode list_insert(lua_State *L, qlist list, void *data);
 LIST_API void linkNodeToPrev(qlist list, lNode data, lNode node);
-LIST_API bool list_remove(qlist list, lNode node, bool del);
+LIST_API bool list_remove(qlist list, lNode node);
+LIST_API bool list_delnode(lua_State *L, qlist list, lNode node);
 LIST_API bool list_existnode(qlist list, lNode node);
 LIST_API bool list_exist(qlist list, listType data);
-LIST_API bool list_del(qlist list, listType data);
+LIST_API bool list_del(lua_State *L, qlist list, listType data);
 LIST_API lNode list_at(qlist list, int index);
-LIST_API lNode list_newnode(qlist list, void* data);
+LIST_API lNode list_newnode(lua_State *L, qlist list, void* data);
 LIST_API void list_merge(qlist to, qlist from);
-LIST_API void list_destroy(qlist *list_ptr, void (*destructor)(void*));
-LIST_API listType list_pop_back(qlist l);
-LIST_API listType list_pop_front(qlist l);
-LIST_API qlist list_addArray(qlist l, intptr_t *data, int n);
-LIST_API void list_cache_clear();
+LIST_API void list_destroy(lua_State *L, qlist *list_ptr,
+		void (*destructor)(void*));
+LIST_API listType list_pop_back(lua_State *L, qlist l);
+LIST_API listType list_pop_front(lua_State *L, qlist l);
+LIST_API qlist list_addArray(lua_State *L, qlist l, intptr_t *data, int n);
 #endif // LIST_H_INCLUDED
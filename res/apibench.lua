@@ -0,0 +1,28 @@
+-- C API 以 C 字符串为键的访问：os.time/os.date 的字段读写、tostring 查找元方法
+local function bench(name, f)
+  local start = os.clock()
+  local res = f()
+  print(string.format("%-10s: %.4f  %s", name, os.clock() - start, tostring(res)))
+end
+
+local N = 200000
+local date = {year = 2020, month = 5, day = 17, hour = 12, min = 30, sec = 15}
+local obj = setmetatable({}, {__name = "Point"})
+
+bench("ostime", function()
+  local n = 0
+  for i = 1, N do n = n + os.time(date) % 7 end
+  return n
+end)
+
+bench("osdate", function()
+  local n = 0
+  for i = 1, N do n = n + os.date("*t", 86400 * (i % 365)).yday end
+  return n
+end)
+
+bench("tostring", function()
+  local n = 0
+  for i = 1, N do n = n + #tostring(obj) end
+  return n
+end)
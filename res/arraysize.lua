@@ -0,0 +1,76 @@
+-- 数组部分的滞回：增长、在 2 的幂附近反复 push/pop 不重新分配、稀疏后收缩、再次增长；用内存计数观察大小；键超过 256 时增长数组不泄漏（以退出码检查）
+local function kb() return collectgarbage("count") end
+
+local N = 1024
+local m0 = kb()
+local t = {}
+for i = 1, N do t[i] = true end
+local slot = (kb() - m0) / N -- about the size of one slot, in KB
+
+-- grow: a key right past a full array doubles it
+local m1 = kb()
+t[N + 1] = true
+local grown = kb() - m1
+assert(grown > 0.9 * N * slot and grown < 1.2 * N * slot, grown)
+assert(#t == N + 1)
+
+-- churn around the old size: the array keeps its size through every
+-- step, so memory moves by far less than one reallocation (N slots)
+local lo, hi = math.huge, 0
+local function sample()
+  local m = kb()
+  if m < lo then lo = m end
+  if m > hi then hi = m end
+end
+for r = 1, 1000 do
+  t[N + 1] = nil; sample()
+  t[N] = nil; sample()
+  t[N] = true; sample()
+  t[N + 1] = true; sample()
+  if r % 50 == 0 then
+    for i = N + 1, N - 99, -1 do t[i] = nil end
+    assert(#t == N - 100); sample()
+    for i = N - 99, N + 1 do t[i] = true end
+    sample()
+  end
+end
+assert(hi - lo < N * slot / 8, hi - lo)
+local m2 = kb()
+assert(#t == N + 1)
+
+-- deleting never shrinks (a traversal may be clearing fields)
+for i = 101, N + 1 do t[i] = nil end
+assert(math.abs(kb() - m2) < N * slot / 8, kb() - m2)
+assert(#t == 100)
+
+-- a sparse array shrinks once the hash part has to grow
+local m3 = kb()
+local shrunk = false
+for i = 1, 64 do
+  t[-i] = true
+  if kb() < m3 - N * slot then shrunk = true; break end
+end
+assert(shrunk, kb() - m3)
+for i = 1, 100 do assert(t[i]) end
+assert(#t == 100 and t[101] == nil)
+
+-- and regrows on appends, without thrashing afterwards
+for i = 101, 2 * N do t[i] = true end
+assert(#t == 2 * N)
+lo, hi = math.huge, 0
+for r = 1, 100 do
+  t[2 * N] = nil; sample()
+  t[2 * N] = true; sample()
+end
+assert(hi - lo < N * slot / 8, hi - lo)
+
+-- keys past the pooled integers (above 256) while the array grows:
+-- a leaked key box aborts lua_close, so the exit status checks this
+local u = {}
+for i = 1, 257 do u[i] = true end
+assert(#u == 257)
+local v = {}
+for i = 1, 300 do v[#v + 1] = true end
+assert(#v == 300 and v[300])
+
+print("ok",string.format("slot %.1f bytes", slot * 1024))
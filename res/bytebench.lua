@@ -0,0 +1,23 @@
+-- 字节类字符串函数的吞吐量：大小写转换、逆序、重复、纯文本查找，输入从 1KB 到 64MB
+local function bench(name, size, f)
+  local rounds = math.max(1, (64 << 20) // size)
+  local start = os.clock()
+  local res
+  for r = 1, rounds do res = f() end
+  local t = os.clock() - start
+  print(string.format("%-8s %9d: %8.1f MB/s  %s", name, size,
+    rounds * size / (1 << 20) / math.max(t, 1e-9), tostring(res)))
+end
+
+local seed = "The Quick Brown Fox Jumps Over The Lazy Dog 0123456789 "
+for _, size in ipairs({1 << 10, 1 << 14, 1 << 18, 1 << 22, 1 << 26}) do
+  local s = seed:rep(size // #seed + 1):sub(1, size)
+  local hay = s:sub(1, size - 8) .. "NEEDLE!!"
+  local near = s:sub(1, size - 12) .. "The Lazy Cow"
+  bench("lower", size, function() return #s:lower() end)
+  bench("upper", size, function() return #s:upper() end)
+  bench("reverse", size, function() return #s:reverse() end)
+  bench("rep", size, function() return #("ab"):rep(size // 2) end)
+  bench("find", size, function() return hay:find("NEEDLE!!", 1, true) end)
+  bench("findnear", size, function() return near:find("The Lazy Cow", 1, true) end)
+end
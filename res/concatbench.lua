@@ -0,0 +1,40 @@
+-- 字符串拼接的微基准：循环追加 s = s .. x 与 table.concat 对比
+local function bench(name, f)
+  local start = os.clock()
+  local res = f()
+  print(string.format("%-10s: %.4f  %s", name, os.clock() - start, tostring(res)))
+end
+
+local N = 100000
+
+bench("append", function()
+  local s = ""
+  for i = 1, N do s = s .. "ab" end
+  return #s
+end)
+
+bench("append3", function()
+  local s = ""
+  for i = 1, N do s = s .. "<" .. "x" .. ">" end
+  return #s
+end)
+
+bench("lines", function()
+  local n = 0
+  for r = 1, 100 do
+    local s = ""
+    for i = 1, 200 do s = s .. "line " .. "\n" end
+    n = n + #s
+  end
+  return n
+end)
+
+bench("tconcat", function()
+  local n = 0
+  for r = 1, 100 do
+    local t = {}
+    for i = 1, 200 do t[#t + 1] = "line " .. "\n" end
+    n = n + #table.concat(t)
+  end
+  return n
+end)
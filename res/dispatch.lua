@@ -0,0 +1,66 @@
+-- 解释器分派：无钩子与带钩子两个循环之间的切换（在函数运行中设置/清除钩子、计数钩子、行钩子、协程）
+local function sum(n) local s = 0 for i = 1, n do s = s + i end return s end
+
+-- a count hook set from inside a running loop takes effect there
+local ticks = 0
+local s = 0
+for i = 1, 1000 do
+  if i == 500 then debug.sethook(function() ticks = ticks + 1 end, "", 1) end
+  s = s + i
+end
+debug.sethook()
+assert(s == 500500 and ticks > 500, ticks)
+
+-- and clearing it from the hook lets the loop go on without hooks
+ticks = 0
+debug.sethook(function() ticks = ticks + 1; if ticks == 10 then debug.sethook() end end, "", 1)
+assert(sum(1000) == 500500)
+assert(ticks == 10, ticks)
+
+-- line hooks see every line, also after a call returns to the caller
+local lines = {}
+local function f()
+  local a = 1
+  local b = sum(10)
+  return a + b
+end
+debug.sethook(function(e, l) lines[#lines + 1] = l end, "l")
+assert(f() == 56)
+debug.sethook()
+assert(#lines >= 4, #lines)
+
+-- a hook that raises an error stops an endless loop
+local ok, err = pcall(function()
+  debug.sethook(function() error("stop") end, "", 1000)
+  while true do end
+end)
+debug.sethook()
+assert(not ok and err:find("stop"))
+
+-- call and return hooks balance
+local depth, maxdepth = 0, 0
+local function deep(n) if n == 0 then return 0 end return 1 + deep(n - 1) end
+debug.sethook(function(e)
+  if e == "call" then depth = depth + 1; if depth > maxdepth then maxdepth = depth end
+  elseif e == "return" then depth = depth - 1 end
+end, "cr")
+assert(deep(20) == 20)
+debug.sethook()
+assert(maxdepth >= 20, maxdepth)
+
+-- hooks are per thread: a coroutine gets its own
+local co = coroutine.create(function(n)
+  local c = 0
+  debug.sethook(function() c = c + 1 end, "", 1)
+  coroutine.yield(sum(n))
+  debug.sethook()
+  return c
+end)
+local _, r = coroutine.resume(co, 100)
+assert(r == 5050)
+assert(debug.gethook() == nil and debug.gethook(co) ~= nil)
+assert(sum(100) == 5050)
+local _, c = coroutine.resume(co)
+assert(c > 100, c)
+
+print("ok")
@@ -0,0 +1,71 @@
+-- 数值 for 循环原地更新下标：被保存、被闭包捕获或被改写的循环变量不能跟着变；边界、步长与浮点循环
+local function run()
+  -- values kept from the loop variable keep their value
+  local kept, fs, keys = {}, {}, {}
+  for i = 1, 10 do
+    kept[i] = i
+    fs[i] = function() return i end
+    keys[i * 1000] = true
+  end
+  for i = 1, 10 do
+    assert(kept[i] == i and fs[i]() == i and keys[i * 1000])
+  end
+  local last
+  for i = 1, 5 do last = i end
+  assert(last == 5)
+  local v = {}
+  for i = 1, 3 do local j = i; v[#v + 1] = j; j = j + 100 end
+  assert(v[1] == 1 and v[2] == 2 and v[3] == 3)
+
+  -- assigning to the loop variable does not change the iteration
+  local n = 0
+  for i = 1, 5 do i = i * 10; n = n + 1; assert(i % 10 == 0) end
+  assert(n == 5)
+
+  -- counts, steps and limits
+  local function count(a, b, c)
+    local k = 0
+    for i = a, b, c do k = k + 1 end
+    return k
+  end
+  assert(count(1, 10, 1) == 10 and count(10, 1, -3) == 4 and count(1, 0, 1) == 0)
+  assert(count(math.maxinteger - 2, math.maxinteger - 1, 1) == 2)
+  assert(count(math.mininteger + 2, math.mininteger + 1, -1) == 2)
+  assert(count(1, 3.5, 1) == 3)
+  local s = 0
+  for x = 0.5, 3, 0.5 do s = s + x end
+  assert(s == 10.5)
+  for x = 1.0, 3 do assert(math.type(x) == "float") end
+  for x = 1, 3 do assert(math.type(x) == "integer") end
+
+  -- nested loops and large indices
+  local t = {}
+  for i = 1, 3 do for j = 400, 402 do t[#t + 1] = i * j end end
+  assert(#t == 9 and t[1] == 400 and t[9] == 1206)
+  local sum = 0
+  for i = 1, 100000 do sum = sum + i end
+  assert(sum == 5000050000)
+end
+
+run()
+if jit.on() then
+  for rep = 1, 50 do run() end
+  jit.off()
+end
+
+-- the loop variable seen by a hook
+local seen = {}
+debug.sethook(function()
+  for k = 1, 20 do
+    local name, val = debug.getlocal(2, k)
+    if not name then break end
+    if name == "i" then seen[val] = true end
+  end
+end, "l")
+for i = 1, 3 do
+  local _ = i
+end
+debug.sethook()
+assert(seen[1] and seen[2] and seen[3])
+
+print("ok")
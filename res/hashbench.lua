@@ -0,0 +1,30 @@
+-- 哈希部分的微基准：跨步整数键、对齐的大整数、浮点键、表作为键
+local function bench(name, f)
+  local start = os.clock()
+  local res = f()
+  print(string.format("%-10s: %.4f  %s", name, os.clock() - start, tostring(res)))
+end
+
+local N = 20000
+
+-- fill a table with keys 'key(i)' and read them all back a few times
+local function fillread(key)
+  local t, sum = {}, 0
+  for i = 1, N do t[key(i)] = i end
+  for r = 1, 10 do
+    for i = 1, N do sum = sum + t[key(i)] end
+  end
+  return sum
+end
+
+bench("stride1k", function() return fillread(function(i) return -i * 1024 end) end)
+bench("stride64k", function() return fillread(function(i) return i << 16 end) end)
+bench("highbits", function() return fillread(function(i) return i << 40 end) end)
+bench("floats", function() return fillread(function(i) return i + 0.5 end) end)
+bench("dense", function() return fillread(function(i) return -i end) end)
+
+bench("tablekeys", function()
+  local keys = {}
+  for i = 1, N do keys[i] = {} end
+  return fillread(function(i) return keys[i] end)
+end)
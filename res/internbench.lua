@@ -0,0 +1,14 @@
+-- 字符串驻留的延迟：逐个驻留新字符串，记录总时间与单次最坏耗时
+local N = 1000000
+local keep = table.new(N)  -- keep array growth out of the measurement
+local clock = os.clock
+local worst, worsti = 0, 0
+local start = clock()
+for i = 1, N do
+  local t0 = clock()
+  keep[i] = "key" .. i
+  local dt = clock() - t0
+  if dt > worst then worst, worsti = dt, i end
+end
+print(string.format("intern    : %.4f  %d strings", clock() - start, #keep))
+print(string.format("worst     : %.6f  at #%d", worst, worsti))
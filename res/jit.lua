@@ -0,0 +1,138 @@
+-- 基线编译器：热点函数编译前后结果一致（算术、比较、表、闭包、泛型 for、可变参数、元方法、钩子、错误、协程）
+local kernels = {}
+
+function kernels.arith(n)
+  local i, f = 0, 0.0
+  for k = 1, n do
+    i = i + k * 3 - k // 2 + k % 7
+    f = f + k / 3 - 2 ^ (k % 4)
+    i = i ~ (k << 3) & 0xffff | (k >> 1)
+  end
+  return i, f, math.maxinteger + n, -(-n), ~n
+end
+
+function kernels.compare(n)
+  local c = 0
+  for k = 1, n do
+    if k < n / 2 then c = c + 1 end
+    if k <= 10 or k == n then c = c + 10 end
+    if not (k % 3 == 0) then c = c - 1 end
+    local b = k > 5 and "big" or "small"
+    if b == "big" then c = c + 2 end
+  end
+  return c
+end
+
+function kernels.tables(n)
+  local t = {1, 2, 3, n, x = "x"}
+  local s = 0
+  for k = 1, n do t[#t + 1] = k end
+  for _, v in ipairs(t) do s = s + v end
+  for k, v in pairs(t) do if type(k) == "string" then s = s + #v end end
+  t.x = nil
+  return s, #t, t.x
+end
+
+function kernels.closures(n)
+  local acc = 0
+  local function add(v) acc = acc + v return acc end
+  local fs = {}
+  for k = 1, 10 do fs[k] = function() return k + n end end
+  for k = 1, n do add(fs[k % 10 + 1]()) end
+  return acc
+end
+
+function kernels.varargs(n)
+  local function pack(...) return {...}, select("#", ...) end
+  local function first(a, ...) return a, ... end
+  local s = 0
+  for k = 1, n do
+    local t, c = pack(k, nil, first(k, k))
+    s = s + c + t[1] + t[4]
+  end
+  return s, select(2, first(1, 2, 3))
+end
+
+local vmt = {__add = function(a, b) return setmetatable({v = a.v + b.v}, getmetatable(a)) end,
+             __lt = function(a, b) return a.v < b.v end,
+             __index = function(t, k) return k end}
+function kernels.meta(n)
+  local a = setmetatable({v = 0}, vmt)
+  local one = setmetatable({v = 1}, vmt)
+  local c = 0
+  for k = 1, n do
+    a = a + one
+    if one < a then c = c + 1 end
+  end
+  return a.v, c, a.missing
+end
+
+function kernels.strings(n)
+  local parts = {}
+  for k = 1, n do parts[#parts + 1] = "k" .. k .. ":" .. #tostring(k) end
+  return #table.concat(parts, ","), parts[n]
+end
+
+local function run(name)
+  return table.pack(kernels[name](200))
+end
+
+local names = {}
+for name in pairs(kernels) do names[#names + 1] = name end
+table.sort(names)
+
+-- results from the interpreter
+local want = {}
+for _, name in ipairs(names) do want[name] = run(name) end
+
+local function same(a, b)
+  if a.n ~= b.n then return false end
+  for k = 1, a.n do
+    if a[k] ~= b[k] and not (a[k] ~= a[k] and b[k] ~= b[k]) then return false end
+  end
+  return true
+end
+
+if not jit.on() then
+  print("ok", "(no compiler in this build)")
+  return
+end
+
+-- hot functions run compiled and give the same results
+for rep = 1, 50 do
+  for _, name in ipairs(names) do
+    assert(same(run(name), want[name]), name)
+  end
+end
+local on, count = jit.status()
+assert(on and count > 0, count)
+
+-- a hook set while compiled code runs is still called
+local ticks = 0
+debug.sethook(function() ticks = ticks + 1 end, "", 100)
+assert(same(run("arith"), want.arith))
+debug.sethook()
+assert(ticks > 0)
+
+-- errors raised in compiled code
+local function div(a, b) return a // b end
+for k = 1, 100 do assert(div(k, 1) == k) end
+local ok, err = pcall(div, 1, 0)
+assert(not ok and err:find("zero"), err)
+ok, err = pcall(div, {}, 1)
+assert(not ok and err:find("arithmetic"), err)
+
+-- yields across compiled code
+local function gen(n) for k = 1, n do coroutine.yield(k) end return "end" end
+for rep = 1, 20 do
+  local co = coroutine.wrap(gen)
+  local s = 0
+  for k = 1, 10 do s = s + co(10) end
+  assert(s == 55 and co() == "end")
+end
+
+-- and back to the interpreter
+jit.off()
+for _, name in ipairs(names) do assert(same(run(name), want[name]), name) end
+
+print("ok", count)
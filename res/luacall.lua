@@ -0,0 +1,67 @@
+-- Lua 函数之间的直接调用：参数与返回值个数调整、可变参数、深递归与栈重分配、栈溢出后恢复、尾调用、__call、钩子、协程
+local function f(a, b, c) return a, b, c end
+local function pack(...) return select("#", ...), ... end
+
+-- missing and extra arguments, truncated and expanded results
+local a, b, c = f(1)
+assert(a == 1 and b == nil and c == nil)
+a, b, c = f(1, 2, 3, 4)
+assert(a == 1 and b == 2 and c == 3)
+assert(pack(f()) == 3 and pack(f(1, 2)) == 3)
+assert(pack((f(1, 2))) == 1)
+local t = {f(1, 2, 3), f(4, 5, 6)}
+assert(#t == 4 and t[1] == 1 and t[2] == 4 and t[4] == 6)
+assert(select("#", pack()) == 1 and select("#", pack(nil, nil)) == 3)
+
+-- recursion deep enough to move the stack, with locals live across calls
+local function deep(n, x, y, z)
+  if n == 0 then return 0 end
+  local l1, l2, l3 = n, n * 2, {n}
+  local r = 1 + deep(n - 1, l1, l2, l3)
+  assert(l1 == n and l2 == n * 2 and l3[1] == n)
+  return r
+end
+assert(deep(10000) == 10000)
+
+-- stack overflow is an error, and calls work again afterwards
+local function inf(n) return 1 + inf(n + 1) end
+local ok, err = pcall(inf, 1)
+assert(not ok and err:find("stack overflow"), err)
+assert(deep(100) == 100)
+
+-- tail calls do not grow the stack
+local function loop(n) if n == 0 then return "done" end return loop(n - 1) end
+assert(loop(1000000) == "done")
+
+-- callable tables and methods
+local obj = setmetatable({v = 3}, {__call = function(self, k) return self.v + k end})
+assert(obj(4) == 7)
+function obj:get(k) return self.v + (k or 0) end
+local s = 0
+for i = 1, 100 do s = s + obj:get() + obj:get(1) end
+assert(s == 700)
+
+-- call and return hooks see every Lua call
+local calls, rets = 0, 0
+debug.sethook(function(e) if e == "call" then calls = calls + 1 else rets = rets + 1 end end, "cr")
+deep(10)
+debug.sethook()
+assert(calls >= 11 and rets >= 11)
+
+-- the traceback shows the Lua frames
+local function tb() return debug.traceback("x", 1) end
+local function outer() return (tb()) end
+assert(select(2, outer():gsub("\n", "")) >= 2)
+
+-- calls inside coroutines, also across yields
+local co = coroutine.wrap(function(x)
+  local function g(y) return coroutine.yield(y + 1) end
+  for i = 1, 3 do x = g(x) end
+  return x
+end)
+assert(co(1) == 2 and co(10) == 11 and co(20) == 21 and co(30) == 30)
+local ths = {}
+for i = 1, 200 do ths[i] = coroutine.create(function() return deep(30) end) end
+for i = 1, 200 do assert(select(2, coroutine.resume(ths[i])) == 30) end
+
+print("ok")
@@ -0,0 +1,86 @@
+-- 元方法缓存：元表的 "__" 键增删改、rawset、清空表或换元表后，查到的元方法必须随之变化；普通键的写入不影响
+local function run()
+  -- a method added after a failed lookup is found
+  local V = {}
+  V.__index = V
+  local o = setmetatable({}, V)
+  assert(o.m == nil)
+  function V.m() return "m" end
+  assert(o.m and o.m() == "m")
+
+  -- metamethods set, replaced and removed
+  V.__add = function() return "add" end
+  assert(o + o == "add")
+  V.__add = function() return "add2" end
+  assert(o + 1 == "add2")
+  V.__add = nil
+  assert(not pcall(function() return o + o end))
+  rawset(V, "__len", function() return 42 end)
+  assert(#o == 42)
+  V.foo = 1 -- an ordinary key keeps the cache
+  assert(#o == 42 and o.foo == 1)
+  rawset(V, "__len", nil)
+  assert(#o == 0)
+
+  -- __index, __newindex and __call on a metatable of their own
+  local W = setmetatable({}, {__index = function(_, k) return k .. "!" end})
+  assert(W.q == "q!")
+  getmetatable(W).__index = nil
+  assert(W.q == nil)
+  local N = setmetatable({}, {__newindex = function(t, k, v) rawset(t, k, v * 10) end})
+  N.a = 1
+  getmetatable(N).__newindex = nil
+  N.b = 1
+  assert(N.a == 10 and N.b == 1)
+  local mt = {__call = function(_, a) return a * 2 end}
+  local c = setmetatable({}, mt)
+  assert(c(21) == 42)
+  mt.__call = function(_, a) return a * 3 end
+  assert(c(21) == 63)
+
+  -- comparisons
+  local cnt = 0
+  local E = {__eq = function() cnt = cnt + 1 return true end}
+  local x, y = setmetatable({}, E), setmetatable({}, E)
+  for i = 1, 100 do assert(x == y) end
+  assert(cnt == 100)
+  E.__eq = nil
+  assert(x ~= y)
+  local L = {__lt = function() return true end, __le = function() return false end}
+  local p, q = setmetatable({}, L), setmetatable({}, L)
+  assert(p < q and not (p <= q))
+  L.__lt = function() return false end
+  assert(not (p < q))
+
+  -- a cleared metatable, and another metatable for the same object
+  local C = {__index = function() return "c" end, __tostring = function() return "TS" end}
+  local z = setmetatable({}, C)
+  assert(z.k == "c" and tostring(z) == "TS")
+  table.clear(C)
+  assert(z.k == nil and tostring(z):find("^table"))
+  setmetatable(z, {__index = function() return "d" end})
+  assert(z.k == "d")
+
+  -- many objects sharing one class, and a method changed in between
+  local A = {}
+  A.__index = A
+  function A:get() return self.v end
+  local objs = {}
+  for i = 1, 100 do objs[i] = setmetatable({v = i}, A) end
+  local s = 0
+  for i = 1, 100 do s = s + objs[i]:get() end
+  function A:get() return -self.v end
+  for i = 1, 100 do s = s + objs[i]:get() end
+  assert(s == 0)
+end
+
+for rep = 1, 3 do run() end
+if jit.on() then
+  for rep = 1, 50 do run() end
+  jit.off()
+end
+
+-- strings keep their own metatable
+assert(("x"):upper() == "X" and #"abc" == 3)
+
+print("ok")
@@ -0,0 +1,50 @@
+-- 数字与字符串互转的微基准：tostring、字符串拼接、string.format、tonumber
+local function bench(name, f)
+  local start = os.clock()
+  local res = f()
+  print(string.format("%-10s: %.4f  %s", name, os.clock() - start, tostring(res)))
+end
+
+local N = 300000
+local floats, ints, numerals = {}, {}, {}
+for i = 1, 1000 do
+  floats[i] = (i * 7919 % 100003) / 977 * 10 ^ (i % 9 - 4)
+  ints[i] = i * 104729 - 50000000
+  numerals[i] = tostring(floats[i])
+end
+
+bench("tostrflt", function()
+  local n = 0
+  for i = 1, N do n = n + #tostring(floats[i % 1000 + 1]) end
+  return n
+end)
+
+bench("tostrint", function()
+  local n = 0
+  for i = 1, N do n = n + #tostring(ints[i % 1000 + 1]) end
+  return n
+end)
+
+bench("concat", function()
+  local n = 0
+  for i = 1, N do n = n + #("x=" .. floats[i % 1000 + 1]) end
+  return n
+end)
+
+bench("formatg", function()
+  local n = 0
+  for i = 1, N do n = n + #string.format("%g %.3g", floats[i % 1000 + 1], floats[i % 999 + 1]) end
+  return n
+end)
+
+bench("formatd", function()
+  local n = 0
+  for i = 1, N do n = n + #string.format("%d", ints[i % 1000 + 1]) end
+  return n
+end)
+
+bench("tonumber", function()
+  local n = 0
+  for i = 1, N do n = n + tonumber(numerals[i % 1000 + 1]) end
+  return n
+end)
@@ -0,0 +1,57 @@
+-- 模式匹配的微基准：字面前缀查找、字符类扫描、gmatch 分词、gsub 替换
+local function bench(name, f)
+  local start = os.clock()
+  local res = f()
+  print(string.format("%-10s: %.4f  %s", name, os.clock() - start, tostring(res)))
+end
+
+local words = {}
+for i = 1, 2000 do words[i] = "word" .. i .. " " .. string.rep("z", i % 7) end
+local text = table.concat(words, " ")
+local log = {}
+for i = 1, 2000 do log[i] = string.format("[%05d] level=%s msg=%q", i, i % 3 == 0 and "warn" or "info", "m" .. i) end
+log = table.concat(log, "\n")
+
+bench("prefix", function()
+  local n, init = 0, 1
+  for r = 1, 50 do
+    init = 1
+    while true do
+      local s, e = log:find("level=warn", init)
+      if not s then break end
+      n, init = n + 1, e + 1
+    end
+  end
+  return n
+end)
+
+bench("class", function()
+  local n = 0
+  for r = 1, 50 do
+    for d in log:gmatch("%d+") do n = n + 1 end
+  end
+  return n
+end)
+
+bench("tokens", function()
+  local n = 0
+  for r = 1, 50 do
+    for k, v in log:gmatch("(%a+)=(%w+)") do n = n + #v end
+  end
+  return n
+end)
+
+bench("gsub", function()
+  local s, n
+  for r = 1, 50 do s, n = text:gsub("%s+", "_") end
+  return n
+end)
+
+bench("match", function()
+  local n = 0
+  for r = 1, 200000 do
+    local a, b = ("key = value"):match("^(%w+)%s*=%s*(%w+)$")
+    if a then n = n + 1 end
+  end
+  return n
+end)
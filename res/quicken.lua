@@ -0,0 +1,56 @@
+-- 类型反馈加速：同一条指令先后遇到不同类型的操作数（数字/字符串/元方法比较，数组/字符串键/元表读取），结果必须不变
+local function lt(a, b) return a < b end
+local function le(a, b) if a <= b then return true end return false end
+local function get(t, k) return t[k] end
+
+-- comparisons go numeric, then meet other types, then numbers again
+for r = 1, 3 do
+  for i = 1, 50 do
+    assert(lt(i, 50) == (i < 50) and le(i, 25) == (i <= 25))
+    assert(lt(i + 0.5, i) == false and le(i, i + 0.0) == true)
+  end
+  assert(lt(1, 2^53) and le(-math.huge, math.mininteger))
+  assert(not lt(0/0, 1) and not le(0/0, 0/0))
+  assert(lt("a", "b") and le("b", "b") and not lt("b", "a"))
+  local mt = {__lt = function(x, y) return x.v < y.v end,
+              __le = function(x, y) return x.v <= y.v end}
+  local x, y = setmetatable({v = 1}, mt), setmetatable({v = 2}, mt)
+  assert(lt(x, y) and not lt(y, x) and le(x, x))
+  assert(not pcall(lt, 1, "2") and not pcall(le, {}, 1))
+end
+
+-- table reads: array part, short strings, other keys and non-tables
+local arr = {10, 20, 30}
+local rec = {a = 1, b = 2}
+local deflt = setmetatable({1}, {__index = function(_, k) return "d" .. tostring(k) end})
+for r = 1, 3 do
+  for i = 1, 3 do assert(get(arr, i) == i * 10) end
+  assert(get(arr, 4) == nil and get(arr, 0) == nil and get(arr, -1) == nil)
+  assert(get(rec, "a") == 1 and get(rec, "b") == 2 and get(rec, "c") == nil)
+  assert(get(deflt, 1) == 1 and get(deflt, 2) == "d2" and get(deflt, "x") == "dx")
+  assert(get("abc", "len") == string.len)
+  assert(get(arr, string.rep("k", 50)) == nil) -- a long string key
+  assert(not pcall(get, nil, 1) and not pcall(get, 1, "a"))
+end
+
+-- the array part under a quickened read moves and shrinks
+local t = {}
+for i = 1, 64 do t[i] = i end
+local function sum(t) local s = 0 for i = 1, 64 do s = s + (t[i] or 0) end return s end
+assert(sum(t) == 64 * 65 / 2)
+for i = 64, 2, -1 do t[i] = nil end
+for i = 1, 40 do t[-i] = i end -- the hash part grows, the sparse array shrinks
+assert(sum(t) == 1)
+for i = 1, 64 do t[i] = i end
+assert(sum(t) == 64 * 65 / 2)
+
+-- dumps carry plain opcodes, also after quickening
+local f = load("local t, k = ... return t[k], t[k] < 10", "=f")
+assert(f({5}, 1) == 5)
+local g = load(string.dump(f), "g", "b")
+local v, c = g({5}, 1)
+assert(v == 5 and c == true)
+v, c = g({a = 50}, "a")
+assert(v == 50 and c == false)
+
+print("ok")
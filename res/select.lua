@@ -0,0 +1,82 @@
+-- select('#', ...) 与 select(n, ...) 的快速路径：个数、正负下标、越界与错误、尾调用、重新定义的 select、钩子与大量参数
+local function cnt(...) return select("#", ...) end
+local function at(i, ...) return select(i, ...) end
+local function pack(...) return {n = select("#", ...), ...} end
+
+local function check()
+  -- counts, nils included
+  assert(cnt() == 0 and cnt(nil) == 1 and cnt(1, nil, nil) == 3)
+
+  -- positive and negative indices, and past the end
+  local r = pack(at(2, "a", "b", "c"))
+  assert(r.n == 2 and r[1] == "b" and r[2] == "c")
+  assert(pack(at(4, "a", "b", "c")).n == 0 and pack(at(9, "a")).n == 0)
+  assert(at(-1, "a", "b", "c") == "c" and pack(at(-3, "a", "b", "c")).n == 3)
+  assert(at(2.0, "a", "b") == "b" and at("2", "a", "b") == "b")
+
+  -- bad selectors raise the same errors as the library function
+  local ok, err = pcall(at, -4, "a", "b", "c")
+  assert(not ok and err:find("out of range"), err)
+  ok, err = pcall(at, 0, "a")
+  assert(not ok and err:find("out of range"), err)
+  ok, err = pcall(at, "x", "a")
+  assert(not ok and err:find("number expected"), err)
+
+  -- results adjusted to the number wanted
+  local function one(i, ...) local v = select(i, ...) return v end
+  assert(one(2, 10, 20, 30) == 20 and one(5, 10) == nil and one(-1, 7, 8) == 8)
+  local function three(i, ...) local a, b, c = select(i, ...) return a, b, c end
+  local a, b, c = three(3, 1, 2, 3, 4)
+  assert(a == 3 and b == 4 and c == nil)
+  local function stmt(...) select("#", ...) select(2, ...) return "st" end
+  assert(stmt(1, 2, 3) == "st")
+  local function tbl(...) return {select(2, ...)} end
+  assert(#tbl(1, 2, 3, 4) == 3 and #tbl(1) == 0)
+
+  -- fixed parameters before the varargs
+  local function fix(x, y, ...) return x, y, select("#", ...), ... end
+  r = pack(fix(1, 2, 3, 4))
+  assert(r.n == 5 and r[1] == 1 and r[2] == 2 and r[3] == 2 and r[5] == 4)
+  r = pack(fix(1))
+  assert(r.n == 3 and r[2] == nil and r[3] == 0)
+
+  -- many arguments
+  local big = {}
+  for i = 1, 300 do big[i] = i end
+  local function many(...) return select("#", ...), select(250, ...) end
+  r = pack(many(table.unpack(big)))
+  assert(r.n == 52 and r[1] == 300 and r[2] == 250 and r[52] == 300)
+
+  -- f(x, ...) with another function
+  local function wrap(f, ...) return f(0, ...) end
+  assert(wrap(math.max, 3, 9, 4) == 9 and select("#", wrap(pack, 1, nil)) == 1)
+
+  local function sumall(...)
+    local s = 0
+    for i = 1, select("#", ...) do s = s + select(i, ...) end
+    return s
+  end
+  assert(sumall(1, 2, 3, 4, 5) == 15)
+end
+
+check()
+if jit.on() then
+  for rep = 1, 50 do check() end
+  jit.off()
+end
+
+-- a redefined 'select' is called
+local oldselect = select
+select = function() return "mine" end
+assert(cnt(1, 2) == "mine" and at(1, "a") == "mine")
+select = oldselect
+assert(cnt(1, 2) == 2)
+
+-- a call hook still sees the call
+local calls = 0
+debug.sethook(function() calls = calls + 1 end, "c")
+assert(cnt(1, 2, 3) == 3)
+debug.sethook()
+assert(calls >= 2)
+
+print("ok")
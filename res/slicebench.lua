@@ -0,0 +1,38 @@
+-- 子串的微基准：逐行消费缓冲区、切大块、捕获长字段
+local function bench(name, f)
+  local start = os.clock()
+  local res = f()
+  print(string.format("%-10s: %.4f  %s", name, os.clock() - start, tostring(res)))
+end
+
+local lines = {}
+for i = 1, 20000 do lines[i] = string.format("%06d %s", i, string.rep("x", i % 50)) end
+local buf = table.concat(lines, "\n") .. "\n"
+
+bench("consume", function()
+  local b, n = buf, 0
+  while #b > 0 do
+    local e = b:find("\n", 1, true)
+    n = n + e
+    b = b:sub(e + 1)
+  end
+  return n
+end)
+
+bench("chunks", function()
+  local n = 0
+  for r = 1, 200 do
+    for i = 1, #buf, 65536 do n = n + #buf:sub(i, i + 65535) end
+  end
+  return n
+end)
+
+local rec = string.rep("h", 4000) .. "\r\n\r\n" .. string.rep("b", 60000)
+bench("captures", function()
+  local n = 0
+  for r = 1, 2000 do
+    local head, body = rec:match("^([^\r]*)\r\n\r\n(.*)$")
+    n = n + #head + #body
+  end
+  return n
+end)
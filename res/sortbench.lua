@@ -0,0 +1,38 @@
+-- 字符串比较：对 100 万个字符串排序，以及有公共前缀的字符串两两比较
+local function bench(name, f)
+  local start = os.clock()
+  local res = f()
+  print(string.format("%-10s: %.4f  %s", name, os.clock() - start, tostring(res)))
+end
+
+local N = 1000000
+local words = {}
+local seed = 42
+for i = 1, N do
+  seed = (seed * 1103515245 + 12345) % 2147483648
+  local a, b, c = seed % 26, seed // 26 % 26, seed // 676 % N
+  words[i] = string.format("%s%07d", string.char(97 + a, 97 + b), c)
+end
+
+bench("sort", function()
+  local t = table.move(words, 1, N, 1, {})
+  table.sort(t)
+  return t[1] .. " " .. t[N]
+end)
+
+bench("sortdesc", function()
+  local t = table.move(words, 1, N, 1, {})
+  table.sort(t, function(a, b) return a > b end)
+  return t[1] .. " " .. t[N]
+end)
+
+local prefix = string.rep("/usr/local/share/lua/5.3/", 4)
+local paths = {}
+for i = 1, 1000 do paths[i] = prefix .. i end
+bench("prefixlt", function()
+  local n = 0
+  for r = 1, 1000 do
+    for i = 2, 1000 do if paths[i - 1] < paths[i] then n = n + 1 end end
+  end
+  return n
+end)
@@ -0,0 +1,57 @@
+-- 拼接响应文本的微基准：table.concat、string.format 与 strbuf 的追加、格式化、重用和直接写出
+local function bench(name, f)
+  local start = os.clock()
+  local res = f()
+  print(string.format("%-10s: %.4f  %s", name, os.clock() - start, tostring(res)))
+end
+
+local N = 200000
+
+bench("tconcat", function()
+  local t = {}
+  for i = 1, N do
+    t[#t + 1] = "<li id="
+    t[#t + 1] = i
+    t[#t + 1] = ">"
+    t[#t + 1] = i * 0.5
+    t[#t + 1] = "</li>\n"
+  end
+  return #table.concat(t)
+end)
+
+bench("append", function()
+  local b = strbuf.new()
+  for i = 1, N do b:append("<li id=", i, ">", i * 0.5, "</li>\n") end
+  return #b:tostring()
+end)
+
+bench("tformat", function()
+  local t = {}
+  for i = 1, N do t[i] = string.format("<li id=%d>%.2f</li>\n", i, i * 0.5) end
+  return #table.concat(t)
+end)
+
+bench("format", function()
+  local b = strbuf.new()
+  for i = 1, N do b:format("<li id=%d>%.2f</li>\n", i, i * 0.5) end
+  return #b:tostring()
+end)
+
+bench("reuse", function()
+  local b, n = strbuf.new(4096), 0
+  for r = 1, N // 100 do
+    b:reset()
+    for i = 1, 100 do b:append("<li>", i, "</li>\n") end
+    n = n + b:len()
+  end
+  return n
+end)
+
+bench("write", function()
+  local f = io.open("/dev/null", "w")
+  local b = strbuf.new()
+  for i = 1, N do b:append("<li id=", i, ">", i * 0.5, "</li>\n") end
+  f:write(b)
+  f:close()
+  return b:len()
+end)
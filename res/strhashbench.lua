@@ -0,0 +1,59 @@
+-- 字符串哈希：只在未采样字节上不同的键（碰撞）以及整串哈希的吞吐量
+local function bench(name, f)
+  local start = os.clock()
+  local res = f()
+  print(string.format("%-10s: %.4f  %s", name, os.clock() - start, tostring(res)))
+end
+
+local N = 20000
+
+-- keys of length 'len' that differ only in bytes the old sampling
+-- hash skipped (it read every ((len >> 5) + 1)-th byte from the end)
+local function skeletonkeys(len)
+  local step = (len >> 5) + 1
+  local free = {}
+  for pos = len - 1, 0, -1 do
+    if (len - 1 - pos) % step ~= 0 then free[#free + 1] = pos + 1 end
+  end
+  local keys = {}
+  for i = 1, N do
+    local b, n = {}, i
+    for p = 1, len do b[p] = "a" end
+    for j = 1, #free do
+      if n == 0 then break end
+      b[free[j]] = string.char(97 + n % 26)
+      n = n // 26
+    end
+    keys[i] = table.concat(b)
+  end
+  return keys
+end
+
+local function fillread(keys)
+  local t, sum = {}, 0
+  for i = 1, #keys do t[keys[i]] = i end
+  for r = 1, 5 do
+    for i = 1, #keys do sum = sum + t[keys[i]] end
+  end
+  return sum
+end
+
+local short, long = skeletonkeys(40), skeletonkeys(200)
+bench("skel40", function() return fillread(short) end)
+bench("skel200", function() return fillread(long) end)
+
+bench("intern", function()
+  local n = 0
+  for i = 1, 10 * N do n = n + #("item:" .. i .. ":name") end
+  return n
+end)
+
+bench("longkeys", function()
+  local chunk = string.rep("0123456789abcdef", 256)
+  local t, n = {}, 0
+  for i = 1, 2000 do
+    t[chunk .. i] = i  -- fresh 4KB string, hashed once as a key
+    n = n + 1
+  end
+  return n
+end)
@@ -0,0 +1,68 @@
+-- 超级指令：全局函数调用、方法调用、f(x, ...)、比较结果赋值；含元方法、协程中让出、错误信息和 dump/load
+local function cmp(a, b) local lt, le, eq = a < b, a <= b, a == b return lt, le, eq end
+
+-- comparisons whose result is stored (EQBOOL, LTBOOL, LEBOOL)
+for _, c in ipairs{{1, 2}, {2, 2}, {3, 2}, {1.5, 2}, {"a", "b"}, {"b", "a"}} do
+  local a, b = c[1], c[2]
+  local lt, le, eq = cmp(a, b)
+  assert(lt == (a < b) and le == (a <= b) and eq == (a == b))
+  local nlt, nle, neq = not (a < b), not (a <= b), a ~= b
+  assert(nlt ~= lt and nle ~= le and neq ~= eq)
+end
+
+-- ... with metamethods, also when they yield
+local mt = {}
+mt.__lt = function(x, y) return x.v < y.v end
+mt.__le = function(x, y) return coroutine.isyieldable() and coroutine.yield("le") or x.v <= y.v end
+mt.__eq = function(x, y) return x.v == y.v end
+local function V(v) return setmetatable({v = v}, mt) end
+local lt, le, eq = cmp(V(1), V(2))
+assert(lt == true and le == true and eq == false)
+lt, le, eq = cmp(V(2), V(2))
+assert(lt == false and le == true and eq == true)
+local co = coroutine.wrap(function() local r = V(3) <= V(2) return "done", r end)
+assert(co() == "le")
+local d, r = co(false)
+assert(d == "done" and r == false)
+
+-- calls of globals and methods (GETTABUPCALL, SELFCALL)
+function gadd(a, b) return a + b end
+local obj = {n = 10}
+function obj:add(k) return self.n + k end
+local s = 0
+for i = 1, 100 do s = s + gadd(i, 1) + obj:add(i) end
+assert(s == 100 * 101 / 2 * 2 + 100 + 1000)
+local ok, err = pcall(function() return nosuchglobal(1) end)
+assert(not ok and err:find("attempt to call"), err)
+ok, err = pcall(function() return obj:nosuchmethod() end)
+assert(not ok and err:find("attempt to call"), err)
+gadd = nil
+
+-- a line hook sees the call of a fused pair on its own line
+local lines = {}
+local function f()
+  local x = print ~= nil
+  local y = tostring(x)
+  return y
+end
+debug.sethook(function(_, l) lines[l] = true end, "l")
+assert(f() == "true")
+debug.sethook()
+local info = debug.getinfo(f, "S")
+assert(lines[info.linedefined + 1] and lines[info.linedefined + 2])
+
+-- f(x, ...) that is not 'select'
+local function pass(f, ...) return f(0, ...) end
+assert(pass(math.max, 3, 9, 4) == 9)
+assert(select("#", pass(function(...) return ... end, 1, nil)) == 3)
+
+-- dumps carry plain opcodes and the loaded code runs the same
+local g = load("local a, b = ... local x, y, z = a < b, a == b, a <= b return x, y, z", "=g")
+local h = load(string.dump(g), "h", "b")
+for _, c in ipairs{{1, 2}, {2, 2}, {3, 2}} do
+  local x1, y1, z1 = g(c[1], c[2])
+  local x2, y2, z2 = h(c[1], c[2])
+  assert(x1 == x2 and y1 == y2 and z1 == z2)
+end
+
+print("ok")
@@ -0,0 +1,85 @@
+-- 表操作的微基准：追加、栈、队列、逆序填充、稀疏数组
+local function bench(name, f)
+  local start = os.clock()
+  local res = f()
+  print(string.format("%-10s: %.4f  %s", name, os.clock() - start, tostring(res)))
+end
+
+local N = 200000
+
+bench("append", function()
+  local t = {}
+  for i = 1, N do t[#t + 1] = i end
+  return #t
+end)
+
+bench("stack", function()
+  local t = {}
+  for r = 1, N do
+    t[#t + 1] = r
+    t[#t + 1] = r
+    t[#t] = nil
+    if r % 3 == 0 then t[#t] = nil end
+  end
+  return #t
+end)
+
+bench("pushpop", function()
+  local t = {}
+  for i = 1, 1024 do t[i] = i end
+  for r = 1, N do
+    t[#t + 1] = r
+    t[#t] = nil
+  end
+  return #t
+end)
+
+bench("queue", function()
+  local q, head, tail = {}, 1, 0
+  for i = 1, N do
+    tail = tail + 1
+    q[tail] = i
+    if i % 2 == 0 then q[head] = nil; head = head + 1 end
+  end
+  return tail - head + 1
+end)
+
+bench("reverse", function()
+  local t = {}
+  for i = N, 1, -1 do t[i] = i end
+  return #t
+end)
+
+bench("sparse", function()
+  local t = {}
+  for i = 1, N do t[i * 16] = i end
+  return #t
+end)
+
+bench("length", function()
+  local t, n = {}, 0
+  for i = 1, 1000 do t[i] = i end
+  for r = 1, N do n = n + #t end
+  return n
+end)
+
+local key = {}
+for i = 1, 64 do key[i] = "k" .. i end
+
+bench("fresh", function()
+  local b
+  for i = 1, N // 16 do
+    b = {}
+    for j = 1, #key do b[key[j]] = i + j end
+  end
+  return b.k64
+end)
+
+bench("clear", function()
+  local b = table.new(0, #key)
+  for i = 1, N // 16 do
+    table.clear(b)
+    for j = 1, #key do b[key[j]] = i + j end
+  end
+  return b.k64
+end)
@@ -0,0 +1,46 @@
+-- UTF-8 的微基准：纯 ASCII 与中英混排文本的长度统计、逐字符遍历、批量解码
+local function bench(name, f)
+  local start = os.clock()
+  local res = f()
+  print(string.format("%-10s: %.4f  %s", name, os.clock() - start, tostring(res)))
+end
+
+local ascii = string.rep("The quick brown fox jumps over the lazy dog. ", 20000)
+local unit = "Lua 是一种轻量小巧的脚本语言，用标准C语言编写。"
+local mixed = string.rep(unit, 10000)
+
+bench("lenascii", function()
+  local n = 0
+  for r = 1, 100 do n = n + utf8.len(ascii) end
+  return n
+end)
+
+bench("lenmixed", function()
+  local n = 0
+  for r = 1, 100 do n = n + utf8.len(mixed) end
+  return n
+end)
+
+bench("codes", function()
+  local n = 0
+  for p, c in utf8.codes(mixed) do n = n + c end
+  return n
+end)
+
+bench("codepoint", function()
+  local n = 0
+  for i = 1, #mixed, #unit do
+    local t = {utf8.codepoint(mixed, i, i + #unit - 1)}
+    n = n + #t
+  end
+  return n
+end)
+
+bench("decode", function()
+  local n = 0
+  for i = 1, #mixed, #unit do
+    local t = utf8.decode(mixed, i, i + #unit - 1)
+    n = n + #t
+  end
+  return n
+end)
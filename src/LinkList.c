@@ -1,31 +1,19 @@
 #include <qlist.h>
 #include "lmem.h"
+#include "lstate.h"
 #include <assert.h>
 #define LinkNodeToTail(list, data, node) LinkNodeToPrev(list, data, node->next)
-#define MAXFREELIST 64
-#define MAXFREENODE MAXFREELIST*4
-#define list_freeNode(node)  \
-		if (numfreenode < MAXFREENODE) { \
-			free_node[numfreenode++] = node; \
-			} else	\
-			luaM_realloc_(_S, node, sizeof(*node), 0);
-static qlist free_list[MAXFREELIST];
-static lNode free_node[MAXFREENODE];
-static int numfreelist = 0;
-static int numfreenode = 0;
+#define list_freeNode(L,node)  luaM_cacheput(L, gcache(L, CACHE_LNODE), node)
 
 
 /***
  函数功能：初始化链表,数据域所占内存的大小由data_size给出
  ***/
-LIST_API qlist list_create() {
+LIST_API qlist list_create(lua_State *L) {
 	qlist l;
-	if (numfreelist > 0) {
-		numfreelist--;
-		l = free_list[numfreelist];
-	} else {
-		l = (qlist) luaM_realloc_(_S, NULL, 0, sizeof(struct linklist));
-	}
+	l = (qlist) luaM_cacheget(L, gcache(L, CACHE_LIST));
+	if (l == NULL)
+		l = (qlist) luaM_realloc_(L, NULL, 0, sizeof(struct linklist));
 	l->length = 0;
 	l->head = list_iter(l);
 	l->tail = list_iter(l);
@@ -35,8 +23,8 @@ LIST_API qlist list_create() {
  * 函数功能：把data的内容插入到链表list的末尾
  * LinkNodeToPrev(list, node, list->head);
  */
-LIST_API lNode list_append(qlist list, void *data) {
-	lNode node = list_newnode(list, data);
+LIST_API lNode list_append(lua_State *L, qlist list, void *data) {
+	lNode node = list_newnode(L, list, data);
 	lNode tail = list_tail(list);
 	tail->next = node;
 	node->prev = tail;
@@ -48,8 +36,8 @@ LIST_API lNode list_append(qlist list, void *data) {
 /*
  * 函数功能：把data的内容插入到链表list的迭代器it_before的前面
  */
-LIST_API lNode list_insert(qlist list, void *data) {
-	lNode node = list_newnode(list, data);
+LIST_API lNode list_insert(lua_State *L, qlist list, void *data) {
+	lNode node = list_newnode(L, list, data);
 	linkNodeToPrev(list, node, list_head(list));
 //	node->prev = NULL;
 	return node;
@@ -69,7 +57,7 @@ LIST_API void linkNodeToPrev(qlist list, lNode data, lNode node) {
  函数功能：从list中，移除node结点，但并不free
  注意，并不free结点，只是把结点从链中分离
  ***/
-LIST_API bool list_remove(qlist list, lNode node, bool del) {
+LIST_API bool list_remove(qlist list, lNode node) {
 	if (node == list_iter(list))
 		return false;    //不移除头结点
 	lNode next_node = node->next;
@@ -77,13 +65,19 @@ LIST_API bool list_remove(qlist list, lNode node, bool del) {
 	//使结点node从list中分离
 	next_node->prev = prev_node;
 	prev_node->next = next_node;
-	if (del) {
-		list_freeNode(node);
-	}
 	//分享后，list的长度减1
 	--list->length;
 	return true;
 }
+/***
+ 函数功能：从list中移除node结点，并free
+ ***/
+LIST_API bool list_delnode(lua_State *L, qlist list, lNode node) {
+	if (!list_remove(list, node))
+		return false;
+	list_freeNode(L, node);
+	return true;
+}
 LIST_API bool list_existnode(qlist list, lNode node) {
 	lNode iter = list_iter(list);
 	while (list_next(list, iter)) {
@@ -100,11 +94,11 @@ LIST_API bool list_exist(qlist list, listType data) {
 	}
 	return false;
 }
-LIST_API bool list_del(qlist list, listType data) {
+LIST_API bool list_del(lua_State *L, qlist list, listType data) {
 	lNode iter = list_iter(list);
 	while (list_next(list, iter)) {
 		if (iter->data == data) {
-			return list_remove(list, iter,1);
+			return list_delnode(L, list, iter);
 		}
 	}
 	return false;
@@ -137,13 +131,11 @@ LIST_API lNode list_at(qlist list, int index) {
 	return node;
 }
 
-LIST_API lNode list_newnode(qlist l, void* data) {
+LIST_API lNode list_newnode(lua_State *L, qlist l, void* data) {
 	lNode node;
-	if (numfreenode > 0) {
-		node = free_node[--numfreenode];
-	} else {
-		node = (lNode) luaM_realloc_(_S, NULL, 0, sizeof(struct lnode));
-	}
+	node = (lNode) luaM_cacheget(L, gcache(L, CACHE_LNODE));
+	if (node == NULL)
+		node = (lNode) luaM_realloc_(L, NULL, 0, sizeof(struct lnode));
 	node->data = data;
 	return node;
 }
@@ -165,7 +157,8 @@ LIST_API void list_merge(qlist to, qlist from) {
 /**
  * 函数功能：销毁链表list
  */
-LIST_API void list_destroy(qlist *list_ptr, void (*destructor)(void*)) {
+LIST_API void list_destroy(lua_State *L, qlist *list_ptr,
+		void (*destructor)(void*)) {
 	qlist l = *list_ptr;
 	if (l == NULL)
 		return;
@@ -181,53 +174,39 @@ LIST_API void list_destroy(qlist *list_ptr, void (*destructor)(void*)) {
 				else
 					destructor(node->data);
 			}
-			list_freeNode(node);
+			list_freeNode(L, node);
 			node = tmp;
 		}
 	}
-	if (numfreelist < MAXFREELIST) {
-		free_list[numfreelist] = l;
-		numfreelist++;
-	} else {
-		luaM_realloc_(_S, l, sizeof(*l), 0);
-	}
+	luaM_cacheput(L, gcache(L, CACHE_LIST), l);
 	*list_ptr = NULL;
 }
 
-LIST_API listType list_pop_back(qlist l) {
+LIST_API listType list_pop_back(lua_State *L, qlist l) {
 	lNode n = list_tail(l);
 	listType data=n->data;
-	if (list_remove(l, n,1)) {
+	if (list_delnode(L, l, n)) {
 		return data;
 	}
 	return NULL;
 }
-LIST_API listType list_pop_front(qlist l) {
+LIST_API listType list_pop_front(lua_State *L, qlist l) {
 	lNode n = list_head(l);
-	if (list_remove(l, n,0)) {
+	if (list_remove(l, n)) {
 		listType data=n->data;
-		list_freeNode(n);
+		list_freeNode(L, n);
 		return data;
 	}
 	return NULL;
 }
-LIST_API qlist list_addArray(qlist l, intptr_t *data, int n) {
+LIST_API qlist list_addArray(lua_State *L, qlist l, intptr_t *data, int n) {
 	for (int i = 0; i < n; i++) {
-		list_append(l, cast(void*, data[i]));
+		list_append(L, l, cast(void*, data[i]));
 	}
 	return l;
 }
-LIST_API void list_cache_clear() {
-	for (int i = 0; i < numfreelist; i++) {
-		luaM_realloc_(_S, free_list[i], sizeof(struct linklist), 0);
-	}
-	numfreelist = 0;
-	for (int i = 0; i < numfreenode; i++) {
-		luaM_realloc_(_S, free_node[i], sizeof(lnode), 0);
-	}
-	numfreenode = 0;
-}
 struct apiList List = { list_create, list_newnode, list_append, list_insert,
-		linkNodeToPrev, list_remove, list_del, list_at, list_destroy, list_append,
+		linkNodeToPrev, list_remove, list_delnode, list_del, list_at, list_destroy,
+		list_append,
 		list_insert, list_pop_back, list_pop_front, list_addArray, list_existnode,
 		list_exist, list_merge }; //链表
@@ -19,7 +19,9 @@
 #include "ldo.h"
 #include "lfunc.h"
 #include "lgc.h"
+#include "ljit.h"
 #include "lmem.h"
+#include "lnumber.h"
 #include "lobject.h"
 #include "lstate.h"
 #include "lstring.h"
@@ -73,7 +75,7 @@ TValue *index2addr(lua_State *L, int idx) {
 			return NONVALIDVALUE; /* it has no upvalues */
 		else {
 			CClosure *func = clCvalue(*ci->func);
-			return (idx <= func->nupvalues) ? &func->upvalue[idx - 1] : NONVALIDVALUE;
+			return (idx <= func->nupvalues) ? func->upvalue[idx - 1] : NONVALIDVALUE;
 		}
 	}
 }
@@ -200,8 +202,9 @@ LUA_API void lua_settop(lua_State *L, int idx) {
 			}
 		} else if (L->top > newtop) {
 			while (newtop <= --L->top) {
-				refDec(L, *(L->top));
-				*(L->top) = NULL;
+				TValue *o = *(L->top);
+				*(L->top) = NULL; /* a '__gc' may push onto this slot */
+				refDec(L, o);
 			}
 			L->top = newtop;
 		}
@@ -356,12 +359,81 @@ LUA_API int lua_compare(lua_State *L, int index1, int index2, int op) {
 }
 
 LUA_API size_t lua_stringtonumber(lua_State *L, const char *s) {
-	size_t sz = luaO_str2num(s, L->top);
-	if (sz != 0)
-		api_incr_top(L);
+	TValue v; /* the stack holds boxed values: convert into a temporary */
+	size_t sz = luaO_str2num(s, &v);
+	if (sz != 0) {
+		if (ttisinteger(&v))
+			lua_pushinteger(L, ivalue(&v));
+		else
+			lua_pushnumber(L, fltvalue(&v));
+	}
 	return sz;
 }
 
+/*
+ ** Format 'n' as "%.<prec>g" (or an integer as LUA_INTEGER_FMT) into
+ ** 'buff', like 'snprintf' but without going through the C library
+ ** in the common cases.
+ */
+LUA_API int lua_numbertobuff(char *buff, size_t sz, lua_Number n, int prec) {
+	return luaN_num2str(buff, sz, n, prec);
+}
+
+LUA_API int lua_integertobuff(char *buff, size_t sz, lua_Integer n) {
+	return luaN_int2str(buff, sz, n);
+}
+
+LUA_API int lua_collate(lua_State *L, int mode) {
+	global_State *g = G(L);
+	int old;
+	api_check(L, mode <= LUA_COLLLOCALE, "invalid collation mode");
+	lua_lock(L);
+	old = g->collate;
+	luaV_setcollate(g, mode);
+	lua_unlock(L);
+	return old;
+}
+
+LUA_API int lua_jit(lua_State *L, int what) {
+	global_State *g = G(L);
+	int res = 0;
+	lua_lock(L);
+	switch (what) {
+	case LUA_JITOFF:
+	case LUA_JITON:
+		res = g->jiton;
+		g->jiton = (what == LUA_JITON) ? LUAJ_ENABLED : 0;
+		break;
+	case LUA_JITSTATUS:
+		res = g->jiton;
+		break;
+	case LUA_JITCOUNT:
+		res = g->njit;
+		break;
+	default:
+		res = -1; /* invalid option */
+	}
+	lua_unlock(L);
+	return res;
+}
+
+LUA_API char *lua_resizestrbuf(lua_State *L, char *b, size_t *size,
+		size_t n) {
+	size_t cap = 0;
+	lua_lock(L);
+	if (n > 0) {
+		if (n >= MAX_SIZE / 2)
+			luaM_toobig(L);
+		cap = luaS_capacity(n);
+	}
+	if (cap != *size) {
+		b = luaS_resizebuff(L, b, *size, cap);
+		*size = cap;
+	}
+	lua_unlock(L);
+	return b;
+}
+
 LUA_API lua_Number lua_tonumberx(lua_State *L, int idx, int *pisnum) {
 	lua_Number n;
 	const TValue *o = index2addr(L, idx);
@@ -405,6 +477,19 @@ LUA_API const char *lua_tolstring(lua_State *L, int idx, size_t *len) {
 		lua_unlock(L);
 	}
 	o = *ob;
+	if (len != NULL)
+		*len = vslen(o);
+	return luaS_cstr(L, tsvalue(o));
+}
+
+/*
+ ** Like 'lua_tolstring', but the result may not be followed by a '\0';
+ ** saves a slice (see 'lua_pushsubstring') from making a terminated copy
+ */
+LUA_API const char *lua_tolstringview(lua_State *L, int idx, size_t *len) {
+	TValue *o = index2addr(L, idx);
+	if (!ttisstring(o))
+		return lua_tolstring(L, idx, len);
 	if (len != NULL)
 		*len = vslen(o);
 	return svalue(o);
@@ -516,6 +601,40 @@ LUA_API const char *lua_pushlstring(lua_State *L, const char *s, size_t len) {
 	return getstr(ts);
 }
 
+/*
+ ** Pushes the 'len' bytes starting at byte 'i' of the string at 'idx'.
+ ** A large piece of a long string shares its bytes instead of copying
+ ** them; read it with 'lua_tolstringview' to keep it that way.
+ */
+LUA_API const char *lua_pushsubstring(lua_State *L, int idx, size_t i,
+		size_t len) {
+	TString *ts;
+	lua_lock(L);
+	ts = tsvalue(index2addr(L, idx));
+	api_check(L, i + len <= tsslen(ts), "substring out of range");
+	ts = luaS_sub(L, ts, i, len);
+	stack_push(L, ts);
+	luaC_checkGC(L);
+	lua_unlock(L);
+	return getstr(ts);
+}
+
+/*
+ ** Pushes the first 'len' bytes of the string buffer block 'b' (see
+ ** 'lua_resizestrbuf'), which the new string takes over.
+ */
+LUA_API const char *lua_pushstrbuf(lua_State *L, char *b, size_t size,
+		size_t len) {
+	TString *ts;
+	lua_lock(L);
+	api_check(L, len < size || (b == NULL && len == 0), "invalid length");
+	ts = luaS_adoptbuff(L, b, size, len);
+	stack_push(L, ts);
+	luaC_checkGC(L);
+	lua_unlock(L);
+	return getstr(ts);
+}
+
 LUA_API const char *lua_pushstring(lua_State *L, const char *s) {
 	lua_lock(L);
 	if (s == NULL) {
@@ -626,7 +745,7 @@ LUA_API int lua_gettable(lua_State *L, int idx) {
 	TValue *t;
 	lua_lock(L);
 	t = index2addr(L, idx);
-	luaV_gettable(L, t, *(L->top - 1), *(L->top - 1));
+	luaV_gettable(L, t, *(L->top - 1), L->top - 1);
 	lua_unlock(L);
 	return ttnov(*(L->top - 1));
 }
@@ -647,8 +766,10 @@ LUA_API int lua_geti(lua_State *L, int idx, lua_Integer n) {
 	} else {
 		TValue *v = int_get(L, n);
 //		setivalue(L->top, n);
+		refInc(v); /* a new key box is freed below */
 		api_incr_top(L);
 		luaV_finishget(L, t, v, (L->top - 1), slot);
+		refDec(L, v);
 	}
 	lua_unlock(L);
 	return ttnov(*(L->top - 1));
@@ -659,7 +780,7 @@ LUA_API int lua_rawget(lua_State *L, int idx) {
 	lua_lock(L);
 	t = index2addr(L, idx);
 	api_check(L, ttistable(t), "table expected");
-	setobj2s(L, L->top - 1, luaH_get(hvalue(t), *(L->top - 1)));
+	setobj2s(L, L->top - 1, luaH_get(L, hvalue(t), *(L->top - 1)));
 	lua_unlock(L);
 	return ttnov(*(L->top - 1));
 }
@@ -674,12 +795,12 @@ LUA_API int lua_rawgeti(lua_State *L, int idx, lua_Integer n) {
 			stack_push(L, (TValue*)G(L)->mainthread);
 		} else {
 			NodeMap res;
-			stack_push(L, luaH_getint(G(L)->l_registry.value_.t, n));
+			stack_push(L, luaH_getint(L, G(L)->l_registry.value_.t, n));
 		}
 	} else {
 		t = index2addr(L, idx);
 		api_check(L, ttistable(t), "table expected");
-		setobj2s(L, L->top, luaH_getint(hvalue(t), n));
+		setobj2s(L, L->top, luaH_getint(L, hvalue(t), n));
 		api_incr_top(L);
 		lua_unlock(L);
 	}
@@ -693,7 +814,9 @@ LUA_API int lua_rawgetp(lua_State *L, int idx, const void *p) {
 	t = index2addr(L, idx);
 	api_check(L, ttistable(t), "table expected");
 	k = new_pvalue(L, p);
-	stack_push(L, luaH_get(hvalue(t), k));
+	refInc(k); /* the key box is only needed for the lookup */
+	stack_push(L, luaH_get(L, hvalue(t), k));
+	refDec(L, k);
 	lua_unlock(L);
 	return ttnov(*(L->top - 1));
 }
@@ -802,12 +925,14 @@ LUA_API void lua_seti(lua_State *L, int idx, lua_Integer n) {
 	lua_lock(L);
 	api_checknelems(L, 1);
 	t = index2addr(L, idx);
+	refInc(key); /* a new key box is freed below unless the table keeps it */
 	if (luaV_fastset(L, t, key, slot, luaH_setifexist, *(L->top - 1)))
 		stack_pop(L); /* pop value */
 	else {
 		luaV_finishset(L, t, key, *(L->top - 1), slot);
 		stack_pop(L);/* pop value */
 	}
+	refDec(L, key);
 	lua_unlock(L);
 }
 
@@ -846,13 +971,15 @@ LUA_API void lua_rawsetp(lua_State *L, int idx, const void *p) {
 	o = index2addr(L, idx);
 	api_check(L, ttistable(o), "table expected");
 	k = new_pvalue(L, p);
+	refInc(k); /* freed below unless a new node keeps it */
 	Node res;
-	if (luaH_gset(L, o, k, (lua_Integer) p, 1, &res)) {
+	if (luaH_gset(L, o, k, gethash(k), 1, &res)) {
 		refDec(L, res.map->i_val);
 	}
 	lua_assert(slot->tt);
 	refInc(slot);
 	res.map->i_val = slot;
+	refDec(L, k);
 	luaC_barrierback(L, hvalue(o), *(L->top - 1));
 	stack_pop(L);
 	lua_unlock(L);
@@ -1105,6 +1232,14 @@ LUA_API int lua_gc(lua_State *L, int what, int data) {
 		res = g->gcrunning;
 		break;
 	}
+	case LUA_GCCACHED: {
+		res = cast_int(luaM_cachedbytes(L));
+		break;
+	}
+	case LUA_GCTRIM: {
+		res = cast_int(luaM_trimcaches(L));
+		break;
+	}
 	default:
 		res = -1; /* invalid option */
 	}
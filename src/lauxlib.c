@@ -517,7 +517,7 @@ LUALIB_API void luaL_pushresultsize(luaL_Buffer *B, size_t sz) {
 LUALIB_API void luaL_addvalue(luaL_Buffer *B) {
 	lua_State *L = B->L;
 	size_t l;
-	const char *s = lua_tolstring(L, -1, &l);
+	const char *s = lua_tolstringview(L, -1, &l); /* no final '\0' needed */
 	if (buffonstack(B))
 		lua_insert(L, -2); /* put value below buffer */
 	luaL_addlstring(B, s, l);
@@ -756,13 +756,10 @@ LUALIB_API const char *luaL_tolstring(lua_State *L, int idx, size_t *len) {
 			luaL_error(L, "'__tostring' must return a string");
 	} else {
 		switch (lua_type(L, idx)) {
-		case LUA_TNUMBER: {
-			if (lua_isinteger(L, idx))
-				lua_pushfstring(L, "%I", (LUAI_UACINT) lua_tointeger(L, idx));
-			else
-				lua_pushfstring(L, "%f", (LUAI_UACNUMBER) lua_tonumber(L, idx));
+		case LUA_TNUMBER:
+			lua_pushvalue(L, idx);
+			lua_tolstring(L, -1, NULL); /* convert the copy in place */
 			break;
-		}
 		case LUA_TSTRING:
 			lua_pushvalue(L, idx);
 			break;
@@ -898,6 +895,7 @@ LUALIB_API int luaL_getsubtable(lua_State *L, int idx, const char *fname) {
 				stack_push(L, v);
 				return 1;
 			} else if (insert) {
+				invalidateTMcache(t);
 				refDec(L, v);
 				v = (TValue*) luaH_new(L);
 				refInc(v);
@@ -907,6 +905,7 @@ LUALIB_API int luaL_getsubtable(lua_State *L, int idx, const char *fname) {
 			}
 		}
 		if (insert) {
+			invalidateTMcache(t);
 			v = (TValue*) luaH_new(L);
 			res.map->i_val = v;
 			refInc(v);
@@ -103,7 +103,6 @@ static int getjump(FuncState *fs, int pc) {
 static void fixjump(FuncState *fs, int pc, int dest) {
 	Instruction *jmp = &fs->f->code[pc];
 	int offset = dest - (pc + 1);
-	printf("fixjump %d %d\n", pc, dest);
 	lua_assert(dest != NO_JUMP);
 	if (abs(offset) > MAXARG_sBx)
 		luaX_syntaxerror(fs->ls, "control structure too long");
@@ -410,23 +409,26 @@ static int addk(FuncState *fs, TValue *key) {
 	Module *m = f->module;
 	TValue *idx; //= luaH_set(L, fs->ls->h, key); /* index scanner table */
 	int k;
-	if (luaH_gset(L, ls->h, key, gethash(key), 1, &res)) {
+	/* nil cannot index the scanner table; each use gets its own entry */
+	if (!ttisnil(key) && luaH_gset(L, ls->h, key, gethash(key), 1, &res)) {
 		k = res.map->i_val->value_.i;
 		lua_assert(k < m->nconst);
 		return k; /* reuse index */
 	}
 	/* constant not found; create a new entry */
 	k = m->nconst;
-	/* numerical value does not need GC barrier;
-	 table has no metatable, so it does not need to invalidate cache */
-	idx = int_get(L, k);
-	res.map->i_val = idx;
+	if (!ttisnil(key)) {
+		/* numerical value does not need GC barrier;
+		 table has no metatable, so it does not need to invalidate cache */
+		idx = int_get(L, k);
+		res.map->i_val = idx;
+		refInc(idx);
+	}
 	luaM_growvector(L, m->k, k, ls->sizek, TValue*, MAXARG_Ax, "constants");
 //	while (oldsize < f->sizek)
 //		setnilvalue(&f->k[oldsize++]);
 	m->k[k] = key;
 	refInc(key);
-	refInc(idx);
 	m->nconst++;
 //	luaC_barrier(L, f, v);
 	return k;
@@ -448,15 +450,26 @@ int luaK_stringK(FuncState *fs, TString *s) {
  ** are no "precision" problems.
  */
 int luaK_intK(FuncState *fs, lua_Integer n) {
-	return addk(fs, int_get(fs->ls->L, n));
+	lua_State *L = fs->ls->L;
+	TValue *o = int_get(L, n);
+	int k;
+	refInc(o); /* a new box is freed below if the constant exists already */
+	k = addk(fs, o);
+	refDec(L, o);
+	return k;
 }
 
 /*
  ** Add a float to list of constants and return its index.
  */
 static int luaK_numberK(FuncState *fs, lua_Number r) {
-	TValue *o = flt_new(fs->ls->L, r);
-	return addk(fs, o); /* use number itself as key */
+	lua_State *L = fs->ls->L;
+	TValue *o = flt_new(L, r);
+	int k;
+	refInc(o); /* as in 'luaK_intK' */
+	k = addk(fs, o); /* use number itself as key */
+	refDec(L, o);
+	return k;
 }
 
 /*
@@ -471,7 +484,6 @@ static int boolK(FuncState *fs, int b) {
  */
 static int nilK(FuncState *fs) {
 //	setnilvalue(&v);
-	/* cannot use nil as key; instead use table itself to represent nil */
 	return addk(fs, luaO_nilobject);
 }
 
@@ -969,11 +981,14 @@ static int constfolding(FuncState *fs, int op, expdesc *e1, const expdesc *e2) {
 		e1->u.ival = ivalue(res);
 	} else { /* folds neither NaN nor 0.0 (to avoid problems with -0.0) */
 		lua_Number n = fltvalue(res);
-		if (luai_numisnan(n) || n == 0)
+		if (luai_numisnan(n) || n == 0) {
+			refDec(fs->ls->L, res);
 			return 0;
+		}
 		e1->k = VKFLT;
 		e1->u.nval = n;
 	}
+	refDec(fs->ls->L, res); /* 'luaO_arith' anchored it in 'res' */
 	return 1;
 }
 
@@ -1199,3 +1214,55 @@ void luaK_setlist(FuncState *fs, int base, int nelems, int tostore) {
 	fs->freereg = base + 1; /* free registers with list values */
 }
 
+
+/*
+ ** Check whether the instruction at 'pc' is a LOADBOOL
+ */
+static int isloadbool(const Proto *f, int pc) {
+	return (pc >= 0 && pc < f->ncode && GET_OPCODE(f->code[pc]) == OP_LOADBOOL);
+}
+
+/*
+ ** Peephole pass over a finished function, parsed or loaded (dumps carry
+ ** plain opcodes): turn the first instruction of the pairs below into a
+ ** superinstruction, whose handler runs the next instruction without a
+ ** dispatch (see OP_GETTABUPCALL and on), or does both itself
+ ** (OP_VARARGCALL on 'select').
+ ** Only opcodes change, so jumps to any instruction of a pair, line
+ ** information and the debug interface stay as they were. Comparisons
+ ** already run their jump inline; they are fused when both ways out
+ ** (the skip and the jump target) are a LOADBOOL, as in 'x = a < b'.
+ */
+void luaK_fuse(Proto *f) {
+	Instruction *code = f->code;
+	int pc;
+	for (pc = 0; pc + 1 < f->ncode; pc++) {
+		OpCode next = GET_OPCODE(code[pc + 1]);
+		switch (GET_OPCODE(code[pc])) {
+		case OP_GETTABUP:
+			if (next == OP_CALL)
+				SET_OPCODE(code[pc], OP_GETTABUPCALL);
+			break;
+		case OP_SELF:
+			if (next == OP_CALL)
+				SET_OPCODE(code[pc], OP_SELFCALL);
+			break;
+		case OP_VARARG: /* 'f(x, ...)', which may be a 'select' */
+			if ((next == OP_CALL || next == OP_TAILCALL) && GETARG_B(code[pc]) == 0
+					&& GETARG_A(code[pc + 1]) + 2 == GETARG_A(code[pc]))
+				SET_OPCODE(code[pc], OP_VARARGCALL);
+			break;
+		case OP_EQ:
+		case OP_LT:
+		case OP_LE: { /* ORDER OP */
+			if (next == OP_JMP && isloadbool(f, pc + 2)
+					&& isloadbool(f, pc + 2 + GETARG_sBx(code[pc + 1])))
+				SET_OPCODE(code[pc],
+						GET_OPCODE(code[pc]) - OP_EQ + OP_EQBOOL);
+			break;
+		}
+		default:
+			break;
+		}
+	}
+}
@@ -362,10 +362,10 @@ static int db_sethook (lua_State *L) {
     lua_createtable(L, 0, 2);  /* create a hook table */
     lua_pushvalue(L, -1);
     lua_rawsetp(L, LUA_REGISTRYINDEX, &HOOKKEY);  /* set it in position */
+    lua_createtable(L, 0, 1);  /* not the table itself: no reference cycle */
     lua_pushstring(L, "k");
-    lua_setfield(L, -2, "__mode");  /** hooktable.__mode = "k" */
-    lua_pushvalue(L, -1);
-    lua_setmetatable(L, -2);  /* setmetatable(hooktable) = hooktable */
+    lua_setfield(L, -2, "__mode");  /** metatable.__mode = "k" */
+    lua_setmetatable(L, -2);  /* setmetatable(hooktable) = metatable */
   }
   checkstack(L, L1, 1);
   lua_pushthread(L1); lua_xmove(L1, L, 1);  /* key (thread) */
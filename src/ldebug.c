@@ -167,9 +167,13 @@ LUA_API const char *lua_getlocal(lua_State *L, const lua_Debug *ar, int n) {
 		StkId pos = NULL; /* to avoid warnings */
 		name = findlocal(L, ar->i_ci, n, &pos);
 		if (name) {
-			setobj(L, L->top, pos);
-//			setobj2s(L, L->top, pos);
-			api_incr_top(L);
+			if (*pos == NULL) /* a register not written yet */
+				stack_push_nil(L);
+			else {
+				setobj(L, L->top, pos);
+//				setobj2s(L, L->top, pos);
+				api_incr_top(L);
+			}
 		}
 	}
 	swapextra(L);
@@ -287,21 +291,20 @@ LUA_API int lua_getinfo(lua_State *L, const char *what, lua_Debug *ar) {
 	int status;
 	Closure *cl;
 	CallInfo *ci;
-	StkId func;
+	TValue *fn;
 	lua_lock(L);
 	swapextra(L);
 	if (*what == '>') {
 		ci = NULL;
-		func = L->top - 1;
-		api_check(L, ttisfunction(*func), "function expected");
+		fn = *--L->top; /* pop function, keeping its reference until the end */
+		*L->top = NULL;
+		api_check(L, ttisfunction(fn), "function expected");
 		what++; /* skip the '>' */
-		stack_pop(L);/* pop function */
 	} else {
 		ci = ar->i_ci;
-		func = ci->func;
-		lua_assert(ttisfunction(*ci->func));
+		fn = *ci->func;
+		lua_assert(ttisfunction(fn));
 	}
-	TValue *fn = *func;
 	cl = ttisclosure(fn) ? clvalue(fn) : NULL;
 	status = auxgetinfo(L, what, ar, cl, ci);
 	if (strchr(what, 'f')) {
@@ -310,6 +313,8 @@ LUA_API int lua_getinfo(lua_State *L, const char *what, lua_Debug *ar) {
 	swapextra(L); /* correct before option 'L', which can raise a mem. error */
 	if (strchr(what, 'L'))
 		collectvalidlines(L, cl);
+	if (ci == NULL)
+		refDec(L, fn);
 	lua_unlock(L);
 	return status;
 }
@@ -359,7 +364,7 @@ static int findsetreg(Proto *p, int lastpc, int reg) {
 	int jmptarget = 0; /* any code before this address is conditional */
 	for (pc = 0; pc < lastpc; pc++) {
 		Instruction i = p->code[pc];
-		OpCode op = GET_OPCODE(i);
+		OpCode op = plainop(GET_OPCODE(i));
 		int a = GETARG_A(i);
 		switch (op) {
 		case OP_LOADNIL: {
@@ -407,7 +412,7 @@ static const char *getobjname(Proto *p, int lastpc, int reg, const char **name)
 	pc = findsetreg(p, lastpc, reg);
 	if (pc != -1) { /* could find instruction? */
 		Instruction i = p->code[pc];
-		OpCode op = GET_OPCODE(i);
+		OpCode op = plainop(GET_OPCODE(i));
 		switch (op) {
 		case OP_MOVE: {
 			int b = GETARG_B(i); /* move from 'b' to 'a' */
@@ -465,7 +470,7 @@ static const char *funcnamefromcode(lua_State *L, CallInfo *ci,
 		*name = "?";
 		return "hook";
 	}
-	switch (GET_OPCODE(i)) {
+	switch (plainop(GET_OPCODE(i))) {
 	case OP_CALL:
 	case OP_TAILCALL:
 		return getobjname(p, pc, GETARG_A(i), name); /* get function name */
@@ -82,6 +82,7 @@ struct lua_longjmp {
 };
 
 static void seterrorobj(lua_State *L, int errcode, StkId oldtop) {
+	StkId top = L->top;
 	switch (errcode) {
 	case LUA_ERRMEM: { /* memory error? */
 		setsvalue2s(L, oldtop, G(L)->memerrmsg); /* reuse preregistered msg. */
@@ -96,6 +97,11 @@ static void seterrorobj(lua_State *L, int errcode, StkId oldtop) {
 		break;
 	}
 	}
+	while (top > oldtop + 1) { /* release what the aborted calls left */
+		TValue *o = *--top;
+		*top = NULL;
+		refDec(L, o);
+	}
 	L->top = oldtop + 1;
 }
 
@@ -167,7 +173,7 @@ void luaD_reallocstack(lua_State *L, int newsize) {
 	lua_assert(L->stack_last - L->stack == L->stacksize - EXTRA_STACK);
 	luaM_reallocvector(L, L->stack, L->stacksize, newsize, TValue*);
 	for (; lim < newsize; lim++)
-		setnilvalue(L->stack + lim); /* erase new segment */
+		L->stack[lim] = NULL; /* erase new segment */
 	L->stacksize = newsize;
 	L->stack_last = L->stack + newsize - EXTRA_STACK;
 	correctstack(L, oldstack);
@@ -204,8 +210,7 @@ static int stackinuse(lua_State *L) {
 }
 
 void luaD_shrinkstack(lua_State *L) {
-	int inuse = L->ci->top > L->top ? L->ci->top : L->top - L->stack;
-//  int inuse = stackinuse(L);
+	int inuse = stackinuse(L); /* every frame, not only the current one */
 //  int goodsize = inuse + (inuse / 8) + 2*EXTRA_STACK;
 //  if (goodsize > LUAI_MAXSTACK)
 //    goodsize = LUAI_MAXSTACK;  /* respect stack limit */
@@ -255,7 +260,12 @@ void luaD_hook(lua_State *L, int event, int line) {
 		lua_assert(!L->allowhook);
 		L->allowhook = 1;
 		ci->top = restorestack(L, ci_top);
-		L->top = restorestack(L, top);
+		while (L->top > restorestack(L, top)) { /* release what the hook left */
+			TValue *o = *--L->top;
+			*L->top = NULL;
+			if (o != NULL)
+				refDec(L, o);
+		}
 		ci->callstatus &= ~CIST_HOOKED;
 	}
 }
@@ -279,12 +289,12 @@ static StkId adjust_varargs(lua_State *L, Proto *p, int actual) {
 	/* move fixed parameters to final position */
 	fixed = L->top - actual; /* first fixed argument */
 	base = L->top; /* final position of first argument */
-	for (i = 0; i < nfixargs && i < actual; i++) {
-		setobjs2s(L, L->top++, fixed + i);
-		setnilvalue(fixed + i); /* erase original copy (for GC) */
+	for (i = 0; i < nfixargs && i < actual; i++) { /* moved, not copied */
+		*L->top++ = fixed[i];
+		fixed[i] = luaO_nilobject; /* erase original slot (for GC) */
 	}
 	for (; i < nfixargs; i++)
-		stack_push_nil(L); /* complete missing arguments */
+		*L->top++ = luaO_nilobject; /* complete missing arguments */
 	return base;
 }
 
@@ -348,22 +358,24 @@ static int moveresults(lua_State *L, const StkId firstResult, StkId res,
 		break;
 	}
 	}
+	/* each slot is cleared before its release and 'L->top' lowered only
+	 * after all of them: a '__gc' run by 'refDec' pushes onto 'L->top' */
 	while (resIter < L->top) {
-		if (*resIter) {
-			refDec(L, *resIter);
-			*resIter = NULL;
-		} else
+		TValue *o = *resIter;
+		if (o == NULL)
 			break;
+		*resIter = NULL;
+		refDec(L, o);
 		resIter++;
 	}
-	L->top = res; /* top points after the last result */
-	while (res < firstResult) {
-		if (!ttisnil(*res)) {
-			refDec(L, *res);
-			*res = NULL;
+	for (resIter = res; resIter < firstResult; resIter++) {
+		TValue *o = *resIter;
+		if (!ttisnil(o)) {
+			*resIter = NULL;
+			refDec(L, o);
 		}
-		res++;
 	}
+	L->top = res; /* top points after the last result */
 	return wanted != LUA_MULTRET;
 }
 
@@ -444,7 +456,12 @@ int luaD_precall(lua_State *L, StkId fn, int nresults) {
 			base = adjust_varargs(L, p, n);
 		else { /* non vararg function */
 			for (; n < p->numparams; n++)
-				stack_push_nil(L); /* complete missing arguments */
+				fn[n + 1] = luaO_nilobject; /* complete missing arguments */
+			for (; n > p->numparams; n--) { /* drop extra ones, from the top */
+				TValue *o = fn[n];
+				fn[n] = NULL;
+				refDec(L, o);
+			}
 			base = fn + 1;
 		}
 		ci = next_ci(L); /* now 'enter' new function */
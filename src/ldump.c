@@ -15,6 +15,7 @@
 #include "lua.h"
 
 #include "lobject.h"
+#include "lopcodes.h"
 #include "lstate.h"
 #include "lundump.h"
 
@@ -88,8 +89,15 @@ static void DumpString (const TString *s, DumpState *D) {
 
 
 static void DumpCode (const Proto *f, DumpState *D) {
+  int i;
   DumpInt(f->ncode, D);
-  DumpVector(f->code, f->ncode, D);
+  for (i = 0; i < f->ncode; i++) {
+    Instruction inst = f->code[i];
+    /* undo superinstructions and run-time quickening: the format stays
+       the official one, and 'luaK_fuse' redoes the former at load */
+    SET_OPCODE(inst, plainop(GET_OPCODE(inst)));
+    DumpVar(inst, D);
+  }
 }
 
 
@@ -15,6 +15,7 @@
 
 #include "lfunc.h"
 #include "lgc.h"
+#include "ljit.h"
 #include "lmem.h"
 #include "lobject.h"
 #include "lstate.h"
@@ -44,6 +45,7 @@ void luaF_initupvals(lua_State *L, LClosure *cl) {
 	for (i = 0; i < cl->nupvalues; i++) {
 		UpVal *uv = luaM_new(L, UpVal);
 		uv->refcount = 1;
+		uv->gcpass = 0;
 		uv->v = &uv->u.value; /* make it closed */
 		uv->u.value = luaO_nilobject;
 		cl->upvals[i] = uv;
@@ -64,6 +66,7 @@ UpVal *luaF_findupval(lua_State *L, StkId level) {
 	/* not found: create a new upvalue */
 	uv = luaM_new(L, UpVal);
 	uv->refcount = 0;
+	uv->gcpass = 0;
 	uv->u.open.next = *pp; /* link it to list of open upvalues */
 	uv->u.open.touched = 1;
 	*pp = uv;
@@ -83,8 +86,8 @@ void luaF_close(lua_State *L, StkId base) {
 		if (uv->refcount == 0) {/* no references? */
 			luaM_free(L, uv); /* free upvalue */
 		} else {
-			uv->u.value = uv->v[0];
-//			setobj(L, &uv->u.value, uv->v); /* move value to upvalue slot */
+			uv->u.value = uv->v[0]; /* the stack slot keeps its own reference */
+			refInc(uv->u.value);
 			uv->v = &uv->u.value; /* now current value lives here */
 		}
 	}
@@ -103,6 +106,8 @@ Proto *luaF_newproto(lua_State *L) {
 	f->np = 0;
 	f->code = NULL;
 	f->cache = NULL;
+	f->jit = NULL;
+	f->hotcount = 0;
 	f->ncode = 0;
 	f->lineinfo = NULL;
 	f->sizelineinfo = 0;
@@ -120,6 +125,7 @@ Proto *luaF_newproto(lua_State *L) {
 }
 
 void luaF_freeproto(lua_State *L, Proto *f) {
+	luaJ_free(L, f);
 	luaM_freearray(L, f->code, f->ncode);
 	luaM_freearray(L, f->p, f->np);
 	luaM_freearray(L, f->k, f->sizek);
@@ -17,6 +17,7 @@
 #include "ldo.h"
 #include "lfunc.h"
 #include "lgc.h"
+#include "ljit.h"
 #include "lmem.h"
 #include "lobject.h"
 #include "lstate.h"
@@ -216,7 +217,7 @@ void clean_const(lua_State *L) {
 	while (iter != recyle) {
 		next = iter->next;
 		if (iter->v->nref > 0) {
-			List.remove((qlist) recyle, (lNode) iter, 1);
+			List.delnode(L, (qlist) recyle, (lNode) iter);
 		} else {
 			Object *o = iter->v;
 			TValue *v = &o->ob;
@@ -225,7 +226,7 @@ void clean_const(lua_State *L) {
 				v->collectable = 2;
 			} else {
 				lua_assert(v->collectable & 2);
-				List.remove((qlist) recyle, (lNode) iter, 1);
+				List.delnode(L, (qlist) recyle, (lNode) iter);
 #ifdef USE_INT_POOL
 				if (v->tt == LUA_TNUMINT) {
 					lua_assert(luaH_del_set(L, G(L)->intt, v, v->value_.i));
@@ -248,7 +249,7 @@ static inline void recycle_add(lua_State *L, TValue *o, void *ob) {
 			recycle->count += recycle->length;
 			recycle->length = 0;
 		}
-		List.append(cast(qlist, recycle), ob);
+		List.append(L, cast(qlist, recycle), ob);
 		o->collectable = 1;
 	}
 }
@@ -272,6 +273,7 @@ void obj_destroy(lua_State *L, TValue *o) {
 	case LUA_TPROTO: {
 		ObjPrefix *ob = refObj(o);
 		Proto* p = (Proto*) o;
+		luaJ_free(L, p);
 		refDec(L, p->source);
 		register int i;
 		if (p->sizeupvalues) {
@@ -293,10 +295,10 @@ void obj_destroy(lua_State *L, TValue *o) {
 			}
 			luaM_realloc_(L, p->locvars, sizeof(LocVar) * p->nlocvars, 0);
 		}
-		if (p->ncode) {
+		if (p->ncode)
 			luaM_realloc_(L, p->code, sizeof(Instruction) * p->ncode, 0);
-			luaM_realloc_(L, p->lineinfo, sizeof(int) * p->ncode, 0);
-		}
+		if (p->sizelineinfo) /* none in a stripped dump */
+			luaM_realloc_(L, p->lineinfo, sizeof(int) * p->sizelineinfo, 0);
 
 		refDec(L, p->module);
 		obj_remove(L, ob);
@@ -308,13 +310,16 @@ void obj_destroy(lua_State *L, TValue *o) {
 		lua_assert(bp->nref >= 0);
 		LClosure *lc = (LClosure*) o;
 		int nup = lc->nupvalues;
+		if (lc->p != NULL && lc->p->cache == lc)
+			lc->p->cache = NULL; /* the cache holds no reference */
 		refDec(L, lc->p);
 		bp->nref++;
 		for (int i = 0; i < nup; i++) {
 			UpVal *up = lc->upvals[i];
 			up->refcount--;
-			refDec(L, up->v[0]);
-			if (up->refcount == 0) {
+			/* an open upvalue stays in the thread's list until 'luaF_close' */
+			if (up->refcount == 0 && !upisopen(up)) {
+				refDec(L, up->u.value);
 				luaM_realloc_(L, up, sizeof(UpVal), 0);
 			}
 		}
@@ -384,8 +389,10 @@ void obj_destroy(lua_State *L, TValue *o) {
 	case LUA_TLNGSTR: {
 		ObjPrefix *ob = refObj(o);
 		lua_assert(ob->nref == 0);
+		if (isslice(o->value_.s))
+			luaS_freeslice(L, o->value_.s);
 		obj_remove(L, ob);
-		luaM_realloc_(L, ob, sizelstring(o->value_.s->length), 0);
+		luaM_realloc_(L, ob, sizelngstr(o->value_.s), 0);
 		break;
 	}
 	case LUA_TSHRSTR: {
@@ -544,7 +551,7 @@ void reachable_func(TValue *v, GCPrefix **arr) {
 	GCPrefix *unreachable = arr[1];
 	GCPrefix *bp = O2B(v);
 	if (bp->gcref == UNREACHABLE) {
-		List.remove((qlist) unreachable, (lNode) bp, 0);
+		List.remove((qlist) unreachable, (lNode) bp);
 		List.linkNodeToPrev((qlist) reachable, (lNode) bp, list_iter(reachable));
 		bp->gcref = 1;
 	} else if (bp->gcref == 0) {
@@ -556,11 +563,36 @@ void reachable_func(TValue *v, GCPrefix **arr) {
 void sub_ref_func(TValue *v, void *arg) {
 	O2B(v)->gcref--;
 }
+/*
+ ** a closed upvalue holds one reference to its value, however many
+ ** closures share it: take it off when the last of them is seen. If
+ ** some are outside the generation, the value stays referenced.
+ */
+static void subtract_upvals(LClosure *lc, unsigned int pass) {
+	int i;
+	for (i = 0; i < lc->nupvalues; i++) {
+		UpVal *uv = lc->upvals[i];
+		if (uv && !upisopen(uv) && IS_GC(uv->v[0])) {
+			if (uv->gcpass != pass) {
+				uv->gcpass = pass;
+				uv->gcseen = 0;
+			}
+			if (++uv->gcseen == uv->refcount)
+				sub_ref_func(uv->v[0], NULL);
+		}
+	}
+}
 static inline void subtract_refs(GCPrefix *generation) {
+	static unsigned int pass = 0;
 	GCPrefix *iter = (GCPrefix*) generation->next;
+	if (++pass == 0) /* 0 is the mark of a new upvalue */
+		pass = 1;
 	for (; iter != generation; iter = (GCPrefix*) iter->next) {
 		GCObj *ob = iter->ob;
-		traverse(ob, sub_ref_func, NULL);
+		if (ttype(ob) == LUA_TLCL)
+			subtract_upvals((LClosure *) ob, pass);
+		else
+			traverse(ob, sub_ref_func, NULL);
 	}
 }
 
@@ -573,7 +605,7 @@ void move_unreachable(GCPrefix* young, GCPrefix *unreachable) {
 			lua_assert(iter->gcref == 0);
 			iter->gcref = UNREACHABLE;
 			next = iter->next;
-			List.remove((qlist) young, (lNode) iter, 0);
+			List.remove((qlist) young, (lNode) iter);
 			List.linkNodeToPrev((qlist) unreachable, (lNode) iter,
 					list_head(unreachable));
 		} else {
@@ -589,7 +621,7 @@ void move_finalizer(GCPrefix* unreachable, GCPrefix *finalizers) {
 	for (; iter != (GCNode *) unreachable;) {
 		next = iter->next;
 		if (iter->ob.collectable & 2) {
-			List.remove((qlist) unreachable, (lNode) iter, 0);
+			List.remove((qlist) unreachable, (lNode) iter);
 			List.linkNodeToPrev((qlist) finalizers, (lNode) iter,
 					list_head(finalizers));
 		}
@@ -602,11 +634,23 @@ static inline void handle_finalizers(GCPrefix *finalizers) {
 		call_gc(_S, &iter->ob, 0);
 	}
 }
+/*
+ ** every object is held while the list is cleared, as clearing one of
+ ** them releases the others; the emptied objects are freed at the end
+ */
 static inline void clean_unreachable(GCPrefix *unreachable) {
 	if (unreachable->gcref) {
-		GCNode *iter = unreachable->next;
-		for (; iter != (GCNode *) unreachable; iter = iter->next) {
+		GCNode *iter, *next;
+		for (iter = unreachable->next; iter != (GCNode *) unreachable;
+				iter = iter->next)
+			refInc(&iter->ob);
+		for (iter = unreachable->next; iter != (GCNode *) unreachable;
+				iter = iter->next)
 			obj_destroy(_S, &iter->ob);
+		for (iter = unreachable->next; iter != (GCNode *) unreachable;
+				iter = next) {
+			next = iter->next;
+			refDec(_S, &iter->ob);
 		}
 		generation0->length += unreachable->gcref;
 	}
@@ -676,7 +720,7 @@ TValue *luaC_newobjNotGC(lua_State *L, VarType tt, size_t sz) {
 	o->collectable = 0;
 	o->value_.p = o;
 #ifdef LUA_OBJ_DEBUG
-	List.append(cast(qlist, G(L)->objs), (listType) head);
+	List.append(L, cast(qlist, G(L)->objs), (listType) head);
 #endif
 	return (TValue*) o;
 }
@@ -706,7 +750,7 @@ static void reallymarkobject(global_State *g, GCObj *o) {
 	}
 	case LUA_TLNGSTR: {
 		gray2black(o);
-		g->GCmemtrav += sizelstring(gco2ts(o)->length);
+		g->GCmemtrav += sizelngstr(gco2ts(o));
 		break;
 	}
 	case LUA_TUSERDATA: {
@@ -1023,7 +1067,7 @@ static lu_mem traversethread(global_State *g, lua_State *th) {
 	} else if (g->gckind != KGC_EMERGENCY)
 		luaD_shrinkstack(th); /* do not change stack in emergency cycle */
 	return (sizeof(lua_State) + sizeof(TValue) * th->stacksize
-			+ sizeof(CallInfo) * th->nci);
+			+ sizeof(CallInfo) * (th->nci + BASIC_CI_SIZE));
 }
 
 /*
@@ -1155,14 +1199,17 @@ static void clearvalues(global_State *g, GCObj *l, GCObj *f) {
 				}
 			}
 		}
+		invalidateTMcache(h); /* a metamethod may be gone */
 	}
 }
 
 void luaC_upvdeccount(lua_State *L, UpVal *uv) {
 	lua_assert(uv->refcount > 0);
 	uv->refcount--;
-	if (uv->refcount == 0 && !upisopen(uv))
+	if (uv->refcount == 0 && !upisopen(uv)) {
+		refDec(L, uv->u.value);
 		luaM_free(L, uv);
+	}
 }
 
 static void freeLclosure(lua_State *L, LClosure *cl) {
@@ -1202,7 +1249,9 @@ static void freeobj(lua_State *L, GCObj *o) {
 		luaM_freemem(L, o, sizelstring(gco2ts(o)->length));
 		break;
 	case LUA_TLNGSTR: {
-		luaM_freemem(L, o, sizelstring(gco2ts(o)->length));
+		if (isslice(gco2ts(o)))
+			luaS_freeslice(L, gco2ts(o));
+		luaM_freemem(L, o, sizelngstr(gco2ts(o)));
 		break;
 	}
 	default:
@@ -1465,6 +1514,42 @@ static void entersweep(lua_State *L) {
 	g->sweepgc = sweeplist(L, &g->allgc, 1);
 }
 
+/*
+ ** call the finalizers of all objects that have one while the state is
+ ** still complete ('lua_close' then releases the registry). Each object
+ ** is referenced first, so that no finalizer frees one still waiting.
+ */
+void luaC_callallgc(lua_State *L) {
+	TValue **objs;
+	size_t n = 0, k, size = 0;
+	GCNode *iter;
+	int i;
+	for (i = 0; i < NUM_GENERATIONS; i++)
+		for (iter = generations[i].head; iter != (GCNode*) &generations[i];
+				iter = iter->next)
+			if (iter->ob.collectable & 2)
+				size++;
+	if (size == 0)
+		return;
+	objs = luaM_newvector(L, size, TValue*);
+	for (i = 0; i < NUM_GENERATIONS; i++)
+		for (iter = generations[i].head; iter != (GCNode*) &generations[i];
+				iter = iter->next)
+			if (iter->ob.collectable & 2) {
+				objs[n++] = &iter->ob;
+				refInc(&iter->ob);
+			}
+	for (k = 0; k < n; k++) {
+		if (objs[k]->collectable & 2) {
+			objs[k]->collectable &= 1; /* called once */
+			call_gc(L, objs[k], 0);
+		}
+	}
+	for (k = 0; k < n; k++)
+		refDec(L, objs[k]);
+	luaM_freearray(L, objs, size);
+}
+
 void luaC_freeallobjects(lua_State *L) {
 	global_State *g = G(L);
 	separatetobefnz(g, 1); /* separate all objects with finalizers */
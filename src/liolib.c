@@ -617,22 +617,33 @@ static int io_readline (lua_State *L) {
 /* }====================================================== */
 
 
+/* maximum length of a number written by 'g_write' */
+#define MAXNUMBER2STR	50
+
 static int g_write (lua_State *L, FILE *f, int arg) {
   int nargs = lua_gettop(L) - arg;
   int status = 1;
   for (; nargs--; arg++) {
     if (lua_type(L, arg) == LUA_TNUMBER) {
       /* optimization: could be done exactly as for strings */
+      char buff[MAXNUMBER2STR];
       int len = lua_isinteger(L, arg)
-                ? fprintf(f, LUA_INTEGER_FMT,
-                             (LUAI_UACINT)lua_tointeger(L, arg))
-                : fprintf(f, LUA_NUMBER_FMT,
-                             (LUAI_UACNUMBER)lua_tonumber(L, arg));
-      status = status && (len > 0);
+                ? lua_integertobuff(buff, sizeof(buff), lua_tointeger(L, arg))
+                : lua_numbertobuff(buff, sizeof(buff), lua_tonumber(L, arg),
+                                   LUA_NUMBER_DIGITS);
+      status = status && (len > 0) &&
+               (fwrite(buff, sizeof(char), len, f) == (size_t)len);
     }
     else {
       size_t l;
-      const char *s = luaL_checklstring(L, arg, &l);
+      const char *s;
+      luaL_StrBuf *sb = (luaL_StrBuf *)luaL_testudata(L, arg, LUA_STRBUFHANDLE);
+      if (sb != NULL) {  /* string buffer? write its contents in place */
+        s = sb->b;
+        l = sb->n;
+      }
+      else
+        s = luaL_checklstring(L, arg, &l);
       status = status && (fwrite(s, sizeof(char), l, f) == l);
     }
   }
@@ -0,0 +1,897 @@
+/*
+ ** Baseline compiler: hot Lua functions as x86-64 machine code
+ ** See Copyright Notice in lua.h
+ */
+
+#define ljit_c
+#define LUA_CORE
+
+#define _DEFAULT_SOURCE /* for MAP_ANONYMOUS, hidden by _XOPEN_SOURCE */
+
+#include "lprefix.h"
+
+#include "lua.h"
+
+#include "ljit.h"
+
+#if defined(LUA_USE_JIT)
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "ldebug.h"
+#include "ldo.h"
+#include "lfunc.h"
+#include "lgc.h"
+#include "lmem.h"
+#include "lopcodes.h"
+#include "ltable.h"
+#include "ltm.h"
+#include "lvm.h"
+#include "lvmops.h"
+
+/*
+ ** The code of a function is a sequence of templates, one per
+ ** instruction. A template calls a helper below with the thread, the
+ ** frame, the address of its instruction and the constants of the
+ ** function (which do not move once it is loaded). The helper does the
+ ** work of the interpreter, with the same slow paths ('luaV_finishget',
+ ** 'luaT_trybinTM', 'luaD_precall'...), and leaves 'savedpc' after the
+ ** instruction, so errors, metamethods and the debug library see the
+ ** frame as the interpreter leaves it. Jumps and loops are native jumps
+ ** between templates, and integer comparisons and tests branch without
+ ** a call. Returns (which may free the function, and so its code), tail
+ ** calls, closures and concatenations go back to the interpreter, as do
+ ** calls to Lua functions (which start a new frame there) and backward
+ ** jumps once a hook is set; the interpreter enters the code again at
+ ** any instruction (see 'jitenter' in lvmexec.h).
+ ** Since every value is boxed and counted, a helper call costs about what
+ ** a threaded dispatch does; the code wins in loops dominated by jumps
+ ** and integer tests and loses a little elsewhere, so the compiler stays
+ ** off until 'lua_jit' (or 'jit.on') switches it on.
+ */
+
+/* what the native code returns to 'luaJ_run' */
+#define JIT_NEWFRAME	1 /* a Lua function was called: go on with its frame */
+#define JIT_INTERP	2 /* go on with the interpreter at 'savedpc' */
+
+#define HOOKMASK	(LUA_MASKLINE | LUA_MASKCOUNT)
+
+typedef struct JitCode {
+	lu_byte *mcode; /* mmap'd pages with the code */
+	size_t size; /* size of 'mcode' */
+	unsigned int *pcoff; /* offset in 'mcode' of each instruction */
+	int ncode; /* size of 'pcoff' */
+} JitCode;
+
+/* the entry of the code, at the start of 'mcode' */
+typedef int (*JitEntry)(lua_State *L, CallInfo *ci, const lu_byte *target);
+
+/*
+ ** {======================================================
+ ** Helpers
+ ** =======================================================
+ */
+
+#define jbase(ci)	((ci)->u.l.base)
+#define JRA(i)	(jbase(ci) + GETARG_A(i))
+#define JRB(i)	(jbase(ci) + GETARG_B(i))
+#define JRK(x)	(ISK(x) ? k + INDEXK(x) : jbase(ci) + (x))
+
+/* start a helper: read the instruction and step 'savedpc' over it */
+#define jfetch(ci,pc)	((ci)->u.l.savedpc = (pc) + 1, *(pc))
+
+static int jit_move(lua_State *L, CallInfo *ci, const Instruction *pc,
+		StkId k) {
+	Instruction i = jfetch(ci, pc);
+	setobj(L, JRA(i), JRB(i));
+	return 0;
+}
+
+static int jit_loadk(lua_State *L, CallInfo *ci, const Instruction *pc,
+		StkId k) {
+	Instruction i = jfetch(ci, pc);
+	setobj(L, JRA(i), k + GETARG_Bx(i));
+	return 0;
+}
+
+static int jit_loadkx(lua_State *L, CallInfo *ci, const Instruction *pc,
+		StkId k) {
+	Instruction i = jfetch(ci, pc);
+	lua_assert(GET_OPCODE(pc[1]) == OP_EXTRAARG);
+	ci->u.l.savedpc++;
+	setobj(L, JRA(i), k + GETARG_Ax(pc[1]));
+	return 0;
+}
+
+static int jit_loadbool(lua_State *L, CallInfo *ci, const Instruction *pc,
+		StkId k) {
+	Instruction i = jfetch(ci, pc);
+	StkId ra = JRA(i);
+	setbvalue(L, ra, GETARG_B(i));
+	return 0;
+}
+
+static int jit_loadnil(lua_State *L, CallInfo *ci, const Instruction *pc,
+		StkId k) {
+	Instruction i = jfetch(ci, pc);
+	StkId ra = JRA(i);
+	int b = GETARG_B(i);
+	do {
+		setnilvalue(ra);
+		ra++;
+	} while (b--);
+	return 0;
+}
+
+static int jit_getupval(lua_State *L, CallInfo *ci, const Instruction *pc,
+		StkId k) {
+	Instruction i = jfetch(ci, pc);
+	LClosure *cl = clLvalue(*ci->func);
+	setobj2s(L, JRA(i), *(cl->upvals[GETARG_B(i)]->v));
+	return 0;
+}
+
+/* R(a) = 't[key]', as 'gettableProtected' in lvm.c */
+static void jgettable(lua_State *L, CallInfo *ci, const TValue *t,
+		TValue *key, int a) {
+	const TValue *slot;
+	if (luaV_fastget(L, t, key, slot, luaH_get)) {
+		setobj2s(L, jbase(ci) + a, slot);
+	} else
+		luaV_finishget(L, t, key, jbase(ci) + a, slot);
+}
+
+/* 't[key]' = 'v', as 'settableProtected' in lvm.c */
+static void jsettable(lua_State *L, const TValue *t, TValue *key,
+		TValue *v) {
+	const TValue *slot;
+	if (!luaV_fastset(L, t, key, slot, luaH_setifexist, v))
+		luaV_finishset(L, t, key, v, slot);
+}
+
+static int jit_gettabup(lua_State *L, CallInfo *ci, const Instruction *pc,
+		StkId k) {
+	Instruction i = jfetch(ci, pc);
+	LClosure *cl = clLvalue(*ci->func);
+	jgettable(L, ci, cl->upvals[GETARG_B(i)]->v[0], *JRK(GETARG_C(i)),
+			GETARG_A(i));
+	return 0;
+}
+
+static int jit_gettable(lua_State *L, CallInfo *ci, const Instruction *pc,
+		StkId k) {
+	Instruction i = jfetch(ci, pc);
+	jgettable(L, ci, *JRB(i), *JRK(GETARG_C(i)), GETARG_A(i));
+	return 0;
+}
+
+static int jit_settabup(lua_State *L, CallInfo *ci, const Instruction *pc,
+		StkId k) {
+	Instruction i = jfetch(ci, pc);
+	LClosure *cl = clLvalue(*ci->func);
+	jsettable(L, cl->upvals[GETARG_A(i)]->v[0], *JRK(GETARG_B(i)),
+			*JRK(GETARG_C(i)));
+	return 0;
+}
+
+static int jit_setupval(lua_State *L, CallInfo *ci, const Instruction *pc,
+		StkId k) {
+	Instruction i = jfetch(ci, pc);
+	UpVal *uv = clLvalue(*ci->func)->upvals[GETARG_B(i)];
+	setobj(L, uv->v, JRA(i));
+	luaC_upvalbarrier(L, uv);
+	return 0;
+}
+
+static int jit_settable(lua_State *L, CallInfo *ci, const Instruction *pc,
+		StkId k) {
+	Instruction i = jfetch(ci, pc);
+	jsettable(L, *JRA(i), *JRK(GETARG_B(i)), *JRK(GETARG_C(i)));
+	return 0;
+}
+
+static int jit_newtable(lua_State *L, CallInfo *ci, const Instruction *pc,
+		StkId k) {
+	Instruction i = jfetch(ci, pc);
+	int b = GETARG_B(i);
+	int c = GETARG_C(i);
+	Table *t = luaH_new(L);
+	setobj2s(L, JRA(i), (TValue*) t);
+	if (b != 0 || c != 0)
+		luaH_resize(L, t, luaO_fb2int(b), luaO_fb2int(c));
+	return 0;
+}
+
+static int jit_self(lua_State *L, CallInfo *ci, const Instruction *pc,
+		StkId k) {
+	Instruction i = jfetch(ci, pc);
+	const TValue *aux;
+	StkId ra = JRA(i);
+	TValue *rc = *JRK(GETARG_C(i));
+	TString *key = tsvalue(rc); /* key must be a string */
+	setobj(L, ra + 1, JRB(i));
+	if (luaV_fastget(L, ra[1], key, aux, luaH_getstr)) {
+		setobj2s(L, ra, aux);
+	} else
+		luaV_finishget(L, ra[1], rc, ra, aux);
+	return 0;
+}
+
+/*
+ ** arithmetic helpers: 'iop' on two integers, 'fop' on two numbers,
+ ** else the metamethod 'tm'
+ */
+#define jitarith(name,iop,fop,tm) \
+static int name(lua_State *L, CallInfo *ci, const Instruction *pc, \
+		StkId k) { \
+	Instruction i = jfetch(ci, pc); \
+	TValue *vb = *JRK(GETARG_B(i)); \
+	TValue *vc = *JRK(GETARG_C(i)); \
+	lua_Number nb, nc; \
+	if (ttisinteger(vb) && ttisinteger(vc)) { \
+		lua_Integer ib = ivalue(vb); \
+		lua_Integer ic = ivalue(vc); \
+		setobj2s(L, JRA(i), int_get(L, iop)); \
+	} else if (tonumber(vb, &nb) && tonumber(vc, &nc)) { \
+		setobj2s(L, JRA(i), flt_new(L, fop)); \
+	} else \
+		luaT_trybinTM(L, vb, vc, JRA(i), tm); \
+	return 0; \
+}
+
+/* float-only arithmetic */
+#define jitfarith(name,fop,tm) \
+static int name(lua_State *L, CallInfo *ci, const Instruction *pc, \
+		StkId k) { \
+	Instruction i = jfetch(ci, pc); \
+	TValue *vb = *JRK(GETARG_B(i)); \
+	TValue *vc = *JRK(GETARG_C(i)); \
+	lua_Number nb, nc; \
+	if (tonumber(vb, &nb) && tonumber(vc, &nc)) { \
+		setobj2s(L, JRA(i), flt_new(L, fop)); \
+	} else \
+		luaT_trybinTM(L, vb, vc, JRA(i), tm); \
+	return 0; \
+}
+
+/* bitwise operations */
+#define jitbitop(name,iop,tm) \
+static int name(lua_State *L, CallInfo *ci, const Instruction *pc, \
+		StkId k) { \
+	Instruction i = jfetch(ci, pc); \
+	TValue *vb = *JRK(GETARG_B(i)); \
+	TValue *vc = *JRK(GETARG_C(i)); \
+	lua_Integer ib, ic; \
+	if (tointeger(vb, &ib) && tointeger(vc, &ic)) { \
+		setobj2s(L, JRA(i), int_get(L, iop)); \
+	} else \
+		luaT_trybinTM(L, vb, vc, JRA(i), tm); \
+	return 0; \
+}
+
+jitarith(jit_add, intop(+, ib, ic), luai_numadd(L, nb, nc), TM_ADD)
+jitarith(jit_sub, intop(-, ib, ic), luai_numsub(L, nb, nc), TM_SUB)
+jitarith(jit_mul, intop(*, ib, ic), luai_nummul(L, nb, nc), TM_MUL)
+jitarith(jit_idiv, luaV_div(L, ib, ic), luai_numidiv(L, nb, nc), TM_IDIV)
+jitfarith(jit_div, luai_numdiv(L, nb, nc), TM_DIV)
+jitfarith(jit_pow, luai_numpow(L, nb, nc), TM_POW)
+jitbitop(jit_band, intop(&, ib, ic), TM_BAND)
+jitbitop(jit_bor, intop(|, ib, ic), TM_BOR)
+jitbitop(jit_bxor, intop(^, ib, ic), TM_BXOR)
+jitbitop(jit_shl, luaV_shiftl(ib, ic), TM_SHL)
+jitbitop(jit_shr, luaV_shiftl(ib, ic), TM_SHR)
+
+static int jit_mod(lua_State *L, CallInfo *ci, const Instruction *pc,
+		StkId k) {
+	Instruction i = jfetch(ci, pc);
+	TValue *vb = *JRK(GETARG_B(i));
+	TValue *vc = *JRK(GETARG_C(i));
+	lua_Number nb, nc;
+	if (ttisinteger(vb) && ttisinteger(vc)) {
+		setobj2s(L, JRA(i), int_get(L, luaV_mod(L, ivalue(vb), ivalue(vc))));
+	} else if (tonumber(vb, &nb) && tonumber(vc, &nc)) {
+		lua_Number m;
+		luai_nummod(L, nb, nc, m);
+		setobj2s(L, JRA(i), flt_new(L, m));
+	} else
+		luaT_trybinTM(L, vb, vc, JRA(i), TM_MOD);
+	return 0;
+}
+
+static int jit_unm(lua_State *L, CallInfo *ci, const Instruction *pc,
+		StkId k) {
+	Instruction i = jfetch(ci, pc);
+	TValue *vb = *JRB(i);
+	lua_Number nb;
+	if (ttisinteger(vb)) {
+		setobj2s(L, JRA(i), int_get(L, intop(-, 0, ivalue(vb))));
+	} else if (tonumber(vb, &nb)) {
+		setobj2s(L, JRA(i), flt_new(L, luai_numunm(L, nb)));
+	} else
+		luaT_trybinTM(L, vb, vb, JRA(i), TM_UNM);
+	return 0;
+}
+
+static int jit_bnot(lua_State *L, CallInfo *ci, const Instruction *pc,
+		StkId k) {
+	Instruction i = jfetch(ci, pc);
+	TValue *vb = *JRB(i);
+	lua_Integer ib;
+	if (tointeger(vb, &ib)) {
+		setobj2s(L, JRA(i), int_get(L, intop(^, ~l_castS2U(0), ib)));
+	} else
+		luaT_trybinTM(L, vb, vb, JRA(i), TM_BNOT);
+	return 0;
+}
+
+static int jit_not(lua_State *L, CallInfo *ci, const Instruction *pc,
+		StkId k) {
+	Instruction i = jfetch(ci, pc);
+	StkId ra = JRA(i);
+	int res = l_isfalse(*JRB(i)); /* next assignment may change this value */
+	setbvalue(L, ra, res);
+	return 0;
+}
+
+static int jit_len(lua_State *L, CallInfo *ci, const Instruction *pc,
+		StkId k) {
+	Instruction i = jfetch(ci, pc);
+	luaV_objlen(L, JRA(i), *JRB(i));
+	return 0;
+}
+
+/* the jump of 'JMP' closes upvalues; the jump itself is native */
+static int jit_close(lua_State *L, CallInfo *ci, const Instruction *pc,
+		StkId k) {
+	Instruction i = jfetch(ci, pc);
+	luaF_close(L, jbase(ci) + GETARG_A(i) - 1);
+	return 0;
+}
+
+/*
+ ** tests return whether the 'JMP' that follows them is taken; otherwise
+ ** the code goes on after it
+ */
+static int jit_eq(lua_State *L, CallInfo *ci, const Instruction *pc,
+		StkId k) {
+	Instruction i = jfetch(ci, pc);
+	TValue *rb = *JRK(GETARG_B(i));
+	return luaV_equalobj(L, rb, *JRK(GETARG_C(i))) == GETARG_A(i);
+}
+
+static int jit_lt(lua_State *L, CallInfo *ci, const Instruction *pc,
+		StkId k) {
+	Instruction i = jfetch(ci, pc);
+	TValue *rb = *JRK(GETARG_B(i));
+	return luaV_lessthan(L, rb, *JRK(GETARG_C(i))) == GETARG_A(i);
+}
+
+static int jit_le(lua_State *L, CallInfo *ci, const Instruction *pc,
+		StkId k) {
+	Instruction i = jfetch(ci, pc);
+	TValue *rb = *JRK(GETARG_B(i));
+	return luaV_lessequal(L, rb, *JRK(GETARG_C(i))) == GETARG_A(i);
+}
+
+static int jit_testset(lua_State *L, CallInfo *ci, const Instruction *pc,
+		StkId k) {
+	Instruction i = jfetch(ci, pc);
+	StkId rb = JRB(i);
+	if (GETARG_C(i) ? l_isfalse(*rb) : !l_isfalse(*rb))
+		return 0;
+	setobjs2s(L, JRA(i), rb);
+	return 1;
+}
+
+/*
+ ** a call to a C function runs here; a Lua function gets its frame from
+ ** 'luaD_precall' and runs in the interpreter
+ */
+static int jit_call(lua_State *L, CallInfo *ci, const Instruction *pc,
+		StkId k) {
+	Instruction i = jfetch(ci, pc);
+	StkId ra = JRA(i);
+	int b = GETARG_B(i);
+	int nresults = GETARG_C(i) - 1;
+	if (b != 0) {
+		StkId rb = ra + b;
+		lua_assert(L->top >= rb);
+		while (L->top > rb) {
+			--L->top;
+			refDec(L, *(L->top));
+			*L->top = NULL;
+		}
+	}
+	if (luaD_precall(L, ra, nresults)) { /* C function? */
+		if (nresults >= 0)
+			L->top = ci->top; /* adjust results */
+		return (L->hookmask & HOOKMASK) ? JIT_INTERP : 0;
+	}
+	return JIT_NEWFRAME;
+}
+
+static int jit_forloop(lua_State *L, CallInfo *ci, const Instruction *pc,
+		StkId k) {
+	Instruction i = jfetch(ci, pc);
+	StkId ra = JRA(i);
+	if (ttisinteger(*ra)) { /* integer loop? */
+		lua_Integer step = ivalue(ra[2]);
+		lua_Integer idx = intop(+, ivalue(*ra), step); /* increment index */
+		lua_Integer limit = ivalue(ra[1]);
+		if (!((0 < step) ? (idx <= limit) : (limit <= idx)))
+			return 0;
+		luaV_setforint(L, ra, idx); /* update internal index... */
+		luaV_setforint(L, ra + 3, idx); /* ...and external index */
+	} else { /* floating loop */
+		lua_Number step = fltvalue(ra[2]);
+		lua_Number idx = luai_numadd(L, fltvalue(*ra), step); /* inc. index */
+		lua_Number limit = fltvalue(ra[1]);
+		if (!(luai_numlt(0, step) ?
+				luai_numle(idx, limit) : luai_numle(limit, idx)))
+			return 0;
+		luaV_setforflt(L, ra, idx); /* update internal index... */
+		luaV_setforflt(L, ra + 3, idx); /* ...and external index */
+	}
+	return 1; /* jump back */
+}
+
+static int jit_forprep(lua_State *L, CallInfo *ci, const Instruction *pc,
+		StkId k) {
+	Instruction i = jfetch(ci, pc);
+	luaV_forprep(L, JRA(i));
+	return 0;
+}
+
+/* 'savedpc' stays at the 'TFORLOOP' when it returns JIT_INTERP */
+static int jit_tforcall(lua_State *L, CallInfo *ci, const Instruction *pc,
+		StkId k) {
+	Instruction i = jfetch(ci, pc);
+	if (luaV_tforcall(L, ci, JRA(i), GETARG_C(i)) && (L->hookmask & HOOKMASK))
+		return JIT_INTERP;
+	return 0;
+}
+
+static int jit_tforloop(lua_State *L, CallInfo *ci, const Instruction *pc,
+		StkId k) {
+	Instruction i = jfetch(ci, pc);
+	StkId ra = JRA(i);
+	if (ttisnil(ra[2]))
+		return 0;
+	setobjs2s(L, ra, ra + 2); /* save control variable */
+	return 1; /* jump back */
+}
+
+static int jit_setlist(lua_State *L, CallInfo *ci, const Instruction *pc,
+		StkId k) {
+	Instruction i = jfetch(ci, pc);
+	luaV_setlist(L, ci, JRA(i), i);
+	return 0;
+}
+
+static int jit_vararg(lua_State *L, CallInfo *ci, const Instruction *pc,
+		StkId k) {
+	luaV_vararg(L, ci, jfetch(ci, pc));
+	return 0;
+}
+
+/* }====================================================== */
+
+/*
+ ** {======================================================
+ ** Code generation
+ ** =======================================================
+ */
+
+/* largest template (a comparison with its fast path) */
+#define MAXTEMPLATE	160
+
+/* most jumps to other templates from one template (a 'TEST') */
+#define MAXFIXUPS	4
+
+typedef struct Fixup {
+	size_t at; /* position of a 'rel32' */
+	int pc; /* instruction it jumps to */
+} Fixup;
+
+typedef struct JitState {
+	lu_byte *mc; /* code being generated */
+	size_t pos; /* current position in 'mc' */
+	size_t epilogue; /* position of the shared exit */
+	const Instruction *code;
+	StkId k; /* constants, baked into the code */
+	unsigned int *pcoff;
+	Fixup *fix;
+	int nfix;
+} JitState;
+
+#define emitb(J,b)	((J)->mc[(J)->pos++] = cast(lu_byte, (b)))
+
+static void emit32(JitState *J, uint32_t x) {
+	memcpy(J->mc + J->pos, &x, 4);
+	J->pos += 4;
+}
+
+static void emit64(JitState *J, uint64_t x) {
+	memcpy(J->mc + J->pos, &x, 8);
+	J->pos += 8;
+}
+
+static void patch32(JitState *J, size_t at, size_t target) {
+	int32_t rel = cast(int32_t, cast(ptrdiff_t, target) - cast(ptrdiff_t, at + 4));
+	memcpy(J->mc + at, &rel, 4);
+}
+
+/* jcc/jmp rel32 to the template of instruction 'pc' (patched later) */
+static void emitjcc(JitState *J, int cc, int pc) {
+	if (cc < 0)
+		emitb(J, 0xE9); /* jmp */
+	else {
+		emitb(J, 0x0F);
+		emitb(J, 0x80 | cc); /* jz, jnz... */
+	}
+	J->fix[J->nfix].at = J->pos;
+	J->fix[J->nfix++].pc = pc;
+	emit32(J, 0);
+}
+
+#define CC_Z	0x4
+#define CC_NZ	0x5
+#define CC_L	0xC
+#define CC_GE	0xD
+#define CC_LE	0xE
+#define CC_G	0xF
+#define JMP	(-1)
+
+#define RCX	1
+#define RDX	2
+
+/* jnz to the shared exit, which returns 'eax' */
+static void emitexitnz(JitState *J) {
+	emitb(J, 0x0F);
+	emitb(J, 0x80 | CC_NZ);
+	emit32(J, 0);
+	patch32(J, J->pos - 4, J->epilogue);
+}
+
+/* call 'f'(L, ci, &code[pc], k) */
+static void emitcall(JitState *J, lua_CFunction f, int pc) {
+	emitb(J, 0x48); emitb(J, 0x89); emitb(J, 0xDF); /* mov rdi, rbx */
+	emitb(J, 0x4C); emitb(J, 0x89); emitb(J, 0xE6); /* mov rsi, r12 */
+	emitb(J, 0x48); emitb(J, 0xBA); /* mov rdx, imm64 */
+	emit64(J, cast(uint64_t, cast(uintptr_t, J->code + pc)));
+	emitb(J, 0x48); emitb(J, 0xB9); /* mov rcx, imm64 */
+	emit64(J, cast(uint64_t, cast(uintptr_t, J->k)));
+	emitb(J, 0x48); emitb(J, 0xB8); /* mov rax, imm64 */
+	emit64(J, cast(uint64_t, cast(uintptr_t, f)));
+	emitb(J, 0xFF); emitb(J, 0xD0); /* call rax */
+}
+
+/* test eax, eax */
+#define emittest(J)	(emitb(J, 0x85), emitb(J, 0xC0))
+
+/* leave to the interpreter at instruction 'pc' */
+static void emitexit(JitState *J, int pc) {
+	emitb(J, 0x48); emitb(J, 0xB8); /* mov rax, imm64 */
+	emit64(J, cast(uint64_t, cast(uintptr_t, J->code + pc)));
+	emitb(J, 0x49); emitb(J, 0x89); emitb(J, 0x84); emitb(J, 0x24);
+	emit32(J, cast(uint32_t, offsetof(CallInfo, u.l.savedpc))); /* mov [r12+savedpc], rax */
+	emitb(J, 0xB8); /* mov eax, JIT_INTERP */
+	emit32(J, JIT_INTERP);
+	emitb(J, 0xE9); /* jmp epilogue */
+	emit32(J, 0);
+	patch32(J, J->pos - 4, J->epilogue);
+}
+
+/*
+ ** jump from instruction 'pc' to 'target'; a backward jump leaves to
+ ** the interpreter when a line or count hook is set
+ */
+static void emitjump(JitState *J, int pc, int target) {
+	if (target <= pc) {
+		size_t skip;
+		emitb(J, 0xF7); emitb(J, 0x83); /* test dword [rbx+hookmask], imm32 */
+		emit32(J, cast(uint32_t, offsetof(lua_State, hookmask)));
+		emit32(J, HOOKMASK);
+		emitb(J, 0x74); /* jz rel8 */
+		skip = J->pos;
+		emitb(J, 0);
+		emitexit(J, target);
+		J->mc[skip] = cast(lu_byte, J->pos - (skip + 1));
+	}
+	emitjcc(J, JMP, target);
+}
+
+/*
+ ** The fast paths read a value in the first 8 bytes of a TValue and its
+ ** tag in the low 6 bits of the next one (see 'ttype'); 'tagsfit'
+ ** checks that layout before compiling.
+ */
+#define TAGOFF	8
+
+static int tagsfit(void) {
+	TValue v;
+	memset(&v, 0, sizeof(v));
+	v.tt = LUA_TNUMINT | 0xC0;
+	return offsetof(TValue, value_) == 0 && sizeof(Value) == TAGOFF
+			&& cast(lu_byte *, &v)[TAGOFF] == (LUA_TNUMINT | 0xC0);
+}
+
+/* mov rax, [r12+base] */
+static void emitbase(JitState *J) {
+	emitb(J, 0x49); emitb(J, 0x8B); emitb(J, 0x84); emitb(J, 0x24);
+	emit32(J, cast(uint32_t, offsetof(CallInfo, u.l.base)));
+}
+
+/* rcx or rdx ('r') = RK(x), with the base in rax */
+static void emitrk(JitState *J, int x, int r) {
+	if (ISK(x)) { /* mov r, imm64 */
+		emitb(J, 0x48); emitb(J, 0xB8 + r);
+		emit64(J, cast(uint64_t, cast(uintptr_t, J->k[INDEXK(x)])));
+	} else { /* mov r, [rax+8*x] */
+		emitb(J, 0x48); emitb(J, 0x8B); emitb(J, 0x80 | (r << 3));
+		emit32(J, cast(uint32_t, x * sizeof(TValue *)));
+	}
+}
+
+/* eax (d = 0) or edx (d = RDX) = tag of the value that 'r' points to */
+static void emittag(JitState *J, int r, int d) {
+	emitb(J, 0x0F); emitb(J, 0xB6); /* movzx d, byte [r+8] */
+	emitb(J, 0x40 | (d << 3) | r); emitb(J, TAGOFF);
+	emitb(J, 0x83); emitb(J, 0xE0 | d); emitb(J, 0x3F); /* and d, 0x3f */
+}
+
+/* jcc rel8 to the slow path of the template (see 'toslow') */
+static size_t emitshort(JitState *J, int cc) {
+	emitb(J, 0x70 | cc);
+	emitb(J, 0);
+	return J->pos - 1;
+}
+
+static void toslow(JitState *J, const size_t *jumps, int n) {
+	while (n--) {
+		lua_assert(J->pos - (jumps[n] + 1) < 128);
+		J->mc[jumps[n]] = cast(lu_byte, J->pos - (jumps[n] + 1));
+	}
+}
+
+/* can RK(x) be an integer? */
+#define maybeint(J,x)	(!ISK(x) || ttisinteger((J)->k[INDEXK(x)]))
+
+/*
+ ** EQ, LT and LE over two integers: compare them and branch to the jump
+ ** that follows or over it; other values go on with the helper
+ */
+static void emitcompare(JitState *J, int pc, OpCode op) {
+	Instruction i = J->code[pc];
+	int b = GETARG_B(i);
+	int c = GETARG_C(i);
+	size_t slow[4];
+	int ns = 0;
+	int r;
+	int skip; /* condition that skips the jump */
+	if (!(maybeint(J, b) && maybeint(J, c)))
+		return;
+	emitbase(J);
+	emitrk(J, b, RCX);
+	emitrk(J, c, RDX);
+	for (r = RCX; r <= RDX; r++) {
+		if (!ISK(r == RCX ? b : c)) {
+			emitb(J, 0x48); emitb(J, 0x85); emitb(J, 0xC0 | (r << 3) | r); /* test r, r */
+			slow[ns++] = emitshort(J, CC_Z);
+			emittag(J, r, 0);
+			emitb(J, 0x83); emitb(J, 0xF8); emitb(J, LUA_TNUMINT); /* cmp eax, int */
+			slow[ns++] = emitshort(J, CC_NZ);
+		}
+	}
+	emitb(J, 0x48); emitb(J, 0x8B); emitb(J, 0x09); /* mov rcx, [rcx] */
+	emitb(J, 0x48); emitb(J, 0x3B); emitb(J, 0x0A); /* cmp rcx, [rdx] */
+	if (op == OP_EQ)
+		skip = GETARG_A(i) ? CC_NZ : CC_Z;
+	else if (op == OP_LT)
+		skip = GETARG_A(i) ? CC_GE : CC_L;
+	else
+		skip = GETARG_A(i) ? CC_G : CC_LE;
+	emitjcc(J, skip, pc + 2);
+	emitjcc(J, JMP, pc + 1);
+	toslow(J, slow, ns);
+}
+
+/* TEST: branch on the value of R(A), which needs no helper */
+static void emittestins(JitState *J, int pc) {
+	Instruction i = J->code[pc];
+	int onfalse = GETARG_C(i) ? pc + 2 : pc + 1; /* C: jump if true */
+	int ontrue = GETARG_C(i) ? pc + 1 : pc + 2;
+	emitbase(J);
+	emitb(J, 0x48); emitb(J, 0x8B); emitb(J, 0x80); /* mov rax, [rax+8*a] */
+	emit32(J, cast(uint32_t, GETARG_A(i) * sizeof(TValue *)));
+	emitb(J, 0x48); emitb(J, 0x85); emitb(J, 0xC0); /* test rax, rax */
+	emitjcc(J, CC_Z, onfalse);
+	emittag(J, 0, RDX);
+	emitb(J, 0x83); emitb(J, 0xFA); emitb(J, LUA_TNIL); /* cmp edx, nil */
+	emitjcc(J, CC_Z, onfalse);
+	emitb(J, 0x83); emitb(J, 0xFA); emitb(J, LUA_TBOOLEAN); /* cmp edx, bool */
+	emitjcc(J, CC_NZ, ontrue);
+	emitb(J, 0x48); emitb(J, 0x83); emitb(J, 0x38); emitb(J, 0); /* cmp qword [rax], 0 */
+	emitjcc(J, CC_Z, onfalse);
+	emitjcc(J, JMP, ontrue);
+}
+
+#define helper(f)	cast(lua_CFunction, f)
+
+/* emit the template of instruction 'pc' */
+static void emitins(JitState *J, int pc) {
+	Instruction i = J->code[pc];
+	OpCode op = plainop(GET_OPCODE(i));
+	static const lua_CFunction simple[NUM_OPCODES] = {
+		[OP_MOVE] = helper(jit_move), [OP_LOADK] = helper(jit_loadk),
+		[OP_LOADNIL] = helper(jit_loadnil), [OP_GETUPVAL] = helper(jit_getupval),
+		[OP_GETTABUP] = helper(jit_gettabup), [OP_GETTABLE] = helper(jit_gettable),
+		[OP_SETTABUP] = helper(jit_settabup), [OP_SETUPVAL] = helper(jit_setupval),
+		[OP_SETTABLE] = helper(jit_settable), [OP_NEWTABLE] = helper(jit_newtable),
+		[OP_SELF] = helper(jit_self), [OP_ADD] = helper(jit_add),
+		[OP_SUB] = helper(jit_sub), [OP_MUL] = helper(jit_mul),
+		[OP_MOD] = helper(jit_mod), [OP_POW] = helper(jit_pow),
+		[OP_DIV] = helper(jit_div), [OP_IDIV] = helper(jit_idiv),
+		[OP_BAND] = helper(jit_band), [OP_BOR] = helper(jit_bor),
+		[OP_BXOR] = helper(jit_bxor), [OP_SHL] = helper(jit_shl),
+		[OP_SHR] = helper(jit_shr), [OP_UNM] = helper(jit_unm),
+		[OP_BNOT] = helper(jit_bnot), [OP_NOT] = helper(jit_not),
+		[OP_LEN] = helper(jit_len), [OP_VARARG] = helper(jit_vararg),
+	};
+	J->pcoff[pc] = cast(unsigned int, J->pos);
+	switch (op) {
+	case OP_LOADKX: /* skip the EXTRAARG */
+		emitcall(J, helper(jit_loadkx), pc);
+		emitjcc(J, JMP, pc + 2);
+		break;
+	case OP_LOADBOOL:
+		emitcall(J, helper(jit_loadbool), pc);
+		if (GETARG_C(i))
+			emitjcc(J, JMP, pc + 2);
+		break;
+	case OP_JMP:
+		if (GETARG_A(i) != 0)
+			emitcall(J, helper(jit_close), pc);
+		emitjump(J, pc, pc + 1 + GETARG_sBx(i));
+		break;
+	case OP_EQ: case OP_LT: case OP_LE:
+		emitcompare(J, pc, op);
+		emitcall(J, op == OP_EQ ? helper(jit_eq) : op == OP_LT ? helper(jit_lt) :
+				helper(jit_le), pc);
+		emittest(J);
+		emitjcc(J, CC_Z, pc + 2); /* skip the jump */
+		break;
+	case OP_TEST:
+		emittestins(J, pc);
+		break;
+	case OP_TESTSET:
+		emitcall(J, helper(jit_testset), pc);
+		emittest(J);
+		emitjcc(J, CC_Z, pc + 2);
+		break;
+	case OP_CALL:
+		emitcall(J, helper(jit_call), pc);
+		emittest(J);
+		emitexitnz(J);
+		break;
+	case OP_FORPREP:
+		emitcall(J, helper(jit_forprep), pc);
+		emitjcc(J, JMP, pc + 1 + GETARG_sBx(i));
+		break;
+	case OP_FORLOOP:
+		emitcall(J, helper(jit_forloop), pc);
+		goto loop;
+	case OP_TFORCALL:
+		emitcall(J, helper(jit_tforcall), pc);
+		emittest(J);
+		emitexitnz(J);
+		break;
+	case OP_TFORLOOP:
+		emitcall(J, helper(jit_tforloop), pc);
+		loop: emittest(J);
+		emitjcc(J, CC_Z, pc + 1); /* loop is over */
+		emitjump(J, pc, pc + 1 + GETARG_sBx(i));
+		break;
+	case OP_SETLIST:
+		emitcall(J, helper(jit_setlist), pc);
+		if (GETARG_C(i) == 0)
+			emitjcc(J, JMP, pc + 2);
+		break;
+	default:
+		if (simple[op] != NULL)
+			emitcall(J, simple[op], pc);
+		else /* RETURN, TAILCALL, CLOSURE, CONCAT, EXTRAARG */
+			emitexit(J, pc);
+		break;
+	}
+	lua_assert(J->pos - J->pcoff[pc] <= MAXTEMPLATE);
+}
+
+/*
+ ** compile 'p' into fresh pages; they are writable only while the code
+ ** is generated. Returns 0 (and leaves 'p' to the interpreter) when
+ ** there is no memory for them.
+ */
+int luaJ_compile(lua_State *L, Proto *p) {
+	JitState J;
+	JitCode *jc;
+	int ncode = p->ncode;
+	int pc;
+	size_t size = 64 + cast(size_t, ncode) * MAXTEMPLATE;
+	size_t page = 4096;
+	size = (size + page - 1) & ~(page - 1);
+	if (!tagsfit())
+		return 0;
+	J.mc = cast(lu_byte *, mmap(NULL, size, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+	if (J.mc == MAP_FAILED)
+		return 0;
+	J.pos = 0;
+	J.code = p->code;
+	J.k = p->k;
+	J.pcoff = luaM_newvector(L, ncode, unsigned int);
+	J.fix = luaM_newvector(L, MAXFIXUPS * ncode, Fixup);
+	J.nfix = 0;
+	/* entry: keep 'L' in rbx and 'ci' in r12, then jump to the target */
+	emitb(&J, 0x53); /* push rbx */
+	emitb(&J, 0x41); emitb(&J, 0x54); /* push r12 */
+	emitb(&J, 0x41); emitb(&J, 0x55); /* push r13 (aligns the stack) */
+	emitb(&J, 0x48); emitb(&J, 0x89); emitb(&J, 0xFB); /* mov rbx, rdi */
+	emitb(&J, 0x49); emitb(&J, 0x89); emitb(&J, 0xF4); /* mov r12, rsi */
+	emitb(&J, 0xFF); emitb(&J, 0xE2); /* jmp rdx */
+	J.epilogue = J.pos;
+	emitb(&J, 0x41); emitb(&J, 0x5D); /* pop r13 */
+	emitb(&J, 0x41); emitb(&J, 0x5C); /* pop r12 */
+	emitb(&J, 0x5B); /* pop rbx */
+	emitb(&J, 0xC3); /* ret */
+	for (pc = 0; pc < ncode; pc++)
+		emitins(&J, pc);
+	for (pc = 0; pc < J.nfix; pc++) {
+		lua_assert(J.fix[pc].pc < ncode);
+		patch32(&J, J.fix[pc].at, J.pcoff[J.fix[pc].pc]);
+	}
+	luaM_freearray(L, J.fix, MAXFIXUPS * ncode);
+	if (mprotect(J.mc, size, PROT_READ | PROT_EXEC) != 0) {
+		munmap(J.mc, size);
+		luaM_freearray(L, J.pcoff, ncode);
+		return 0;
+	}
+	jc = luaM_new(L, JitCode);
+	jc->mcode = J.mc;
+	jc->size = size;
+	jc->pcoff = J.pcoff;
+	jc->ncode = ncode;
+	p->jit = jc;
+	G(L)->njit++;
+	return 1;
+}
+
+/* }====================================================== */
+
+/*
+ ** run the frame 'ci' as native code from its 'savedpc'. Returns 1 when
+ ** it called a Lua function (whose frame is now 'L->ci'), 0 when the
+ ** interpreter must go on at 'savedpc'.
+ */
+int luaJ_run(lua_State *L, CallInfo *ci) {
+	Proto *p = clLvalue(*ci->func)->p;
+	JitCode *jc = p->jit;
+	const lu_byte *target = jc->mcode + jc->pcoff[ci->u.l.savedpc - p->code];
+	return cast(JitEntry, jc->mcode)(L, ci, target) == JIT_NEWFRAME;
+}
+
+void luaJ_free(lua_State *L, Proto *p) {
+	JitCode *jc = p->jit;
+	if (jc != NULL) {
+		munmap(jc->mcode, jc->size);
+		luaM_freearray(L, jc->pcoff, jc->ncode);
+		luaM_free(L, jc);
+		p->jit = NULL;
+		G(L)->njit--;
+	}
+}
+
+#endif
@@ -0,0 +1,52 @@
+/*
+** Control of the baseline compiler
+** See Copyright Notice in lua.h
+*/
+
+#define ljitlib_c
+#define LUA_LIB
+
+#include "lprefix.h"
+
+
+#include "lua.h"
+
+#include "lauxlib.h"
+#include "lualib.h"
+
+
+/* returns whether the compiler is on, i.e., whether it is built in */
+static int jit_on (lua_State *L) {
+  lua_jit(L, LUA_JITON);
+  lua_pushboolean(L, lua_jit(L, LUA_JITSTATUS));
+  return 1;
+}
+
+
+/* functions already compiled go back to the interpreter */
+static int jit_off (lua_State *L) {
+  lua_jit(L, LUA_JITOFF);
+  return 0;
+}
+
+
+static int jit_status (lua_State *L) {
+  lua_pushboolean(L, lua_jit(L, LUA_JITSTATUS));
+  lua_pushinteger(L, lua_jit(L, LUA_JITCOUNT));
+  return 2;
+}
+
+
+static const luaL_Reg jit_funcs[] = {
+  {"on", jit_on},
+  {"off", jit_off},
+  {"status", jit_status},
+  {NULL, NULL}
+};
+
+
+LUAMOD_API int luaopen_jit (lua_State *L) {
+  luaL_newlib(L, jit_funcs);
+  return 1;
+}
+
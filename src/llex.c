@@ -56,8 +56,8 @@ static void save(LexState *ls, int c) {
 
 void luaX_init(lua_State *L) {
 	register int i;
-//	TString *e = luaS_newliteral(L, LUA_ENV); /* create env name */
-//	refInc(e); /* never collect this name */
+	TString *e = luaS_newliteral(L, LUA_ENV); /* create env name */
+	refInc(e); /* never collect this name */
 	for (i = 0; i < NUM_RESERVED; i++) {
 		TString *ts = luaS_new(L, luaX_tokens[i]);
 		refInc(ts); /* reserved words are never collected */
@@ -163,7 +163,6 @@ void luaX_setinput(lua_State *L, LexState *ls, ZIO *z, TString *source,
 	ls->lastline = 1;
 	ls->source = source;
 	ls->envn = luaS_newliteral(L, LUA_ENV); /* get env name */
-	refInc(ls->envn);
 	luaZ_resizebuffer(ls->L, ls->buff, LUA_MINBUFFER); /* initialize buffer */
 }
 
@@ -149,9 +149,108 @@ void *luaM_realloc_(lua_State *L, void *ptr, size_t osize, size_t nsize) {
 }
 #endif
 
+/*
+ ** {======================================================
+ ** Free-block caches
+ ** =======================================================
+ */
+
+void luaM_cacheinit(FreeCache *c, size_t blocksize) {
+	c->items = NULL;
+	c->n = c->limit = c->low = c->overflow = c->ops = 0;
+	c->target = CACHE_MINLIMIT; /* vector allocated by the first miss */
+	c->blocksize = blocksize;
+}
+
+/* free the cached blocks above the first 'n' */
+static void cachedrop(lua_State *L, FreeCache *c, int n) {
+	while (c->n > n)
+		luaM_realloc_(L, c->items[--c->n], c->blocksize, 0);
+}
+
+/*
+ ** end of an epoch: grow if bursts overflowed the cache, otherwise give
+ ** back half of the blocks that nobody took during the whole epoch. Only
+ ** blocks are freed here; the vector gets its new size at the next miss.
+ */
+static void cacheadapt(lua_State *L, FreeCache *c) {
+	if (c->overflow > (c->limit >> 2) && c->limit < CACHE_MAXLIMIT)
+		c->target = c->limit << 1;
+	else if (c->low > 0) {
+		cachedrop(L, c, c->n - ((c->low + 1) >> 1));
+		if (c->limit > CACHE_MINLIMIT && c->n < (c->limit >> 2))
+			c->target = c->limit >> 1;
+	}
+	c->low = c->n;
+	c->overflow = c->ops = 0;
+}
+
+/* slow path of 'luaM_cacheput': must not allocate */
+void luaM_cacherelease(lua_State *L, FreeCache *c, void *block) {
+	if (c->ops >= CACHE_EPOCH)
+		cacheadapt(L, c);
+	if (c->n < c->limit)
+		c->items[c->n++] = block;
+	else {
+		c->overflow++;
+		luaM_realloc_(L, block, c->blocksize, 0);
+	}
+}
+
+/*
+ ** slow path of 'luaM_cacheget': the cache is empty, and the caller is
+ ** about to allocate anyway, so this is where the vector is resized
+ */
+void *luaM_cachemiss(lua_State *L, FreeCache *c) {
+	if (c->target != c->limit) {
+		luaM_reallocvector(L, c->items, c->limit, c->target, void *);
+		c->limit = c->target;
+	}
+	return NULL;
+}
+
+/* release every block of 'c' and its vector; returns the bytes freed */
+size_t luaM_cachetrim(lua_State *L, FreeCache *c) {
+	size_t freed = luaM_cachebytes(c);
+	cachedrop(L, c, 0);
+	luaM_freearray(L, c->items, c->limit);
+	luaM_cacheinit(c, c->blocksize);
+	return freed;
+}
+
+size_t luaM_cachebytes(const FreeCache *c) {
+	return c->n * c->blocksize + c->limit * sizeof(void *);
+}
+
+void luaM_initcaches(lua_State *L) {
+	global_State *g = G(L);
+	luaM_cacheinit(&g->cache[CACHE_TABLE], sizeof(GCPrefix) + sizeof(Table));
+	luaM_cacheinit(&g->cache[CACHE_MAP], sizeof(NodeMap));
+	luaM_cacheinit(&g->cache[CACHE_SET], sizeof(NodeSet));
+	luaM_cacheinit(&g->cache[CACHE_LIST], sizeof(struct linklist));
+	luaM_cacheinit(&g->cache[CACHE_LNODE], sizeof(struct lnode));
+}
+
+size_t luaM_trimcaches(lua_State *L) {
+	size_t freed = 0;
+	int i;
+	for (i = 0; i < CACHE_N; i++)
+		freed += luaM_cachetrim(L, &G(L)->cache[i]);
+	return freed;
+}
+
+size_t luaM_cachedbytes(lua_State *L) {
+	size_t bytes = 0;
+	int i;
+	for (i = 0; i < CACHE_N; i++)
+		bytes += luaM_cachebytes(&G(L)->cache[i]);
+	return bytes;
+}
+
+/* }====================================================== */
+
 void luaM_destroy() {
-	list_cache_clear();
-	table_clear_cache();
+	luaM_trimcaches(_S);
 #ifdef USE_POOL
 	if (arenas)
 		free(arenas);
@@ -22,6 +22,7 @@
 #include "ldebug.h"
 #include "ldo.h"
 #include "lmem.h"
+#include "lnumber.h"
 #include "lobject.h"
 #include "lstate.h"
 #include "lstring.h"
@@ -295,6 +296,8 @@ static const char *l_str2dloc(const char *s, lua_Number *result, int mode) {
  ** - 'x'/'X' means an hexadecimal numeral
  ** - 'n'/'N' means 'inf' or 'nan' (which should be rejected)
  ** - '.' just optimizes the search for the common case (nothing special)
+ ** Plain decimal numerals are first given to 'luaN_str2d', which
+ ** converts most of them without the C library.
  ** This function accepts both the current locale or a dot as the radix
  ** mark. If the convertion fails, it may mean number has a dot but
  ** locale accepts something else. In that case, the code copies 's'
@@ -307,6 +310,8 @@ static const char *l_str2d(const char *s, lua_Number *result) {
 	int mode = pmode ? ltolower(cast_uchar(*pmode)) : 0;
 	if (mode == 'n') /* reject 'inf' and 'nan' */
 		return NULL;
+	if (mode != 'x' && (endptr = luaN_str2d(s, result)) != NULL)
+		return endptr; /* common decimal case */
 	endptr = l_str2dloc(s, result, mode); /* try to convert */
 	if (endptr == NULL) { /* failed? may be a different locale */
 		char buff[L_MAXLENNUM + 1];
@@ -399,9 +404,9 @@ void luaO_tostring(lua_State *L, StkId ob) {
 	TValue *obj = *ob;
 	lua_assert(ttisnumber(obj));
 	if (ttisinteger(obj))
-		len = lua_integer2str(buff, sizeof(buff), ivalue(obj));
+		len = luaN_int2str(buff, sizeof(buff), ivalue(obj));
 	else {
-		len = lua_number2str(buff, sizeof(buff), fltvalue(obj));
+		len = luaN_num2str(buff, sizeof(buff), fltvalue(obj), LUA_NUMBER_DIGITS);
 #if !defined(LUA_COMPAT_FLOATSTRING)
 		if (buff[strspn(buff, "-0123456789")] == '\0') { /* looks like an int? */
 			buff[len++] = lua_getlocaledecpoint();
@@ -65,6 +65,16 @@ LUAI_DDEF const char *const luaP_opnames[NUM_OPCODES+1] = {
   "CLOSURE",
   "VARARG",
   "EXTRAARG",
+  "GETTABUPCALL",
+  "SELFCALL",
+  "EQBOOL",
+  "LTBOOL",
+  "LEBOOL",
+  "VARARGCALL",
+  "LTNUM",
+  "LENUM",
+  "GETTABLEI",
+  "GETTABLES",
   NULL
 };
 
@@ -120,5 +130,29 @@ LUAI_DDEF const lu_byte luaP_opmodes[NUM_OPCODES] = {
  ,opmode(0, 1, OpArgU, OpArgN, iABx)		/* OP_CLOSURE */
  ,opmode(0, 1, OpArgU, OpArgN, iABC)		/* OP_VARARG */
  ,opmode(0, 0, OpArgU, OpArgU, iAx)		/* OP_EXTRAARG */
+ ,opmode(0, 1, OpArgU, OpArgK, iABC)		/* OP_GETTABUPCALL */
+ ,opmode(0, 1, OpArgR, OpArgK, iABC)		/* OP_SELFCALL */
+ ,opmode(1, 0, OpArgK, OpArgK, iABC)		/* OP_EQBOOL */
+ ,opmode(1, 0, OpArgK, OpArgK, iABC)		/* OP_LTBOOL */
+ ,opmode(1, 0, OpArgK, OpArgK, iABC)		/* OP_LEBOOL */
+ ,opmode(0, 1, OpArgU, OpArgN, iABC)		/* OP_VARARGCALL */
+ ,opmode(1, 0, OpArgK, OpArgK, iABC)		/* OP_LTNUM */
+ ,opmode(1, 0, OpArgK, OpArgK, iABC)		/* OP_LENUM */
+ ,opmode(0, 1, OpArgR, OpArgK, iABC)		/* OP_GETTABLEI */
+ ,opmode(0, 1, OpArgR, OpArgK, iABC)		/* OP_GETTABLES */
+};
+
+
+LUAI_DDEF const lu_byte luaP_plainops[NUM_OPCODES - FIRST_FUSED] = {
+  OP_GETTABUP,	/* OP_GETTABUPCALL */
+  OP_SELF,	/* OP_SELFCALL */
+  OP_EQ,	/* OP_EQBOOL */
+  OP_LT,	/* OP_LTBOOL */
+  OP_LE,	/* OP_LEBOOL */
+  OP_VARARG,	/* OP_VARARGCALL */
+  OP_LT,	/* OP_LTNUM */
+  OP_LE,	/* OP_LENUM */
+  OP_GETTABLE,	/* OP_GETTABLEI */
+  OP_GETTABLE	/* OP_GETTABLES */
 };
 
@@ -365,7 +365,10 @@ static int os_setlocale (lua_State *L) {
      "numeric", "time", NULL};
   const char *l = luaL_optstring(L, 1, NULL);
   int op = luaL_checkoption(L, 2, "all", catnames);
-  lua_pushstring(L, setlocale(cat[op], l));
+  const char *res = setlocale(cat[op], l);
+  if (res != NULL && l != NULL)
+    lua_collate(L, -1);  /* collation may have changed */
+  lua_pushstring(L, res);
   return 1;
 }
 
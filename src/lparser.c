@@ -513,6 +513,7 @@ static void close_func(LexState *ls) {
 	leaveblock(fs);
 	luaM_reallocvector(L, f->code, f->ncode, fs->pc, Instruction);
 	f->ncode = fs->pc;
+	luaK_fuse(f);
 	luaM_reallocvector(L, f->lineinfo, f->sizelineinfo, fs->pc, int);
 	f->sizelineinfo = fs->pc;
 //	f->k = ls->module->k;
@@ -1251,7 +1252,7 @@ static void forbody(LexState *ls, int base, int line, int nvars, int isnum) {
 	BlockCnt bl;
 	FuncState *fs = ls->fs;
 	int prep, endfor;
-	adjustlocalvars(ls, 3); /* control variables */
+	adjustlocalvars(ls, isnum ? 3 : 4); /* control variables */
 	checknext(ls, TK_DO);
 	prep = isnum ? luaK_codeAsBx(fs, OP_FORPREP, base, NO_JUMP) : luaK_jump(fs);
 	enterblock(fs, &bl, 0); /* scope for declared variables */
@@ -1296,13 +1297,14 @@ static void forlist(LexState *ls, TString *indexname) {
 	/* forlist -> NAME {,NAME} IN explist forbody */
 	FuncState *fs = ls->fs;
 	expdesc e;
-	int nvars = 4; /* gen, state, control, plus at least one declared var */
+	int nvars = 5; /* gen, state, control, cursor, plus a declared var */
 	int line;
 	int base = fs->freereg;
 	/* create control variables */
 	new_localvarliteral(ls, "(for generator)");
 	new_localvarliteral(ls, "(for state)");
 	new_localvarliteral(ls, "(for control)");
+	new_localvarliteral(ls, "(for cursor)");
 	/* create declared variables */
 	new_localvar(ls, indexname);
 	while (testnext(ls, ',')) {
@@ -1312,8 +1314,10 @@ static void forlist(LexState *ls, TString *indexname) {
 	checknext(ls, TK_IN);
 	line = ls->linenumber;
 	adjust_assign(ls, 3, explist(ls, &e), &e);
+	luaK_nil(fs, fs->freereg, 1); /* cursor starts unset */
+	luaK_reserveregs(fs, 1);
 	luaK_checkstack(fs, 3); /* extra space to call generator */
-	forbody(ls, base, line, nvars - 3, 0);
+	forbody(ls, base, line, nvars - 4, 0);
 }
 
 static void forstat(LexState *ls, int line) {
@@ -1581,6 +1585,8 @@ LClosure *luaY_parser(lua_State *L, ZIO *z, Mbuffer *buff, Dyndata *dyd,
 	lexstate.h = cnstTable; /* create table for scanner */
 	stack_push2(L, cnstTable); /* anchor it */
 	Module *module = (Module*) luaC_newobjNotGC(L, LUA_TMODULE, sizeof(Module));
+	module->k = NULL;
+	module->nconst = 0;
 	lexstate.module = module;
 	Proto* p = luaF_newproto(L);
 	funcstate.f = cl->p = p;
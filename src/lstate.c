@@ -19,12 +19,14 @@
 #include "ldo.h"
 #include "lfunc.h"
 #include "lgc.h"
+#include "ljit.h"
 #include "llex.h"
 #include "lmem.h"
 #include "lstate.h"
 #include "lstring.h"
 #include "ltable.h"
 #include "ltm.h"
+#include "lvm.h"
 //----------------------
 #include "qlist.h"
 #include <stdlib.h>
@@ -106,11 +108,25 @@ CallInfo *luaE_extendCI(lua_State *L) {
 	return ci;
 }
 
+/*
+ ** the block 'cis' stays linked after 'base_ci' for the life of the
+ ** thread: lists are freed from its end (or from the current 'ci', if
+ ** it is deeper)
+ */
+#define inblock(L,ci)	((ci) >= (L)->cis && (ci) < (L)->cis + BASIC_CI_SIZE)
+
+static CallInfo *lastkept(lua_State *L) {
+	CallInfo *ci = L->ci;
+	while (ci->next != NULL && inblock(L, ci->next))
+		ci = ci->next;
+	return ci;
+}
+
 /*
  ** free all CallInfo structures not in use by a thread
  */
 void luaE_freeCI(lua_State *L) {
-	CallInfo *ci = L->ci;
+	CallInfo *ci = lastkept(L);
 	CallInfo *next = ci->next;
 	ci->next = NULL;
 	while ((ci = next) != NULL) {
@@ -124,7 +140,7 @@ void luaE_freeCI(lua_State *L) {
  ** free half of the CallInfo structures not in use by a thread
  */
 void luaE_shrinkCI(lua_State *L) {
-	CallInfo *ci = L->ci;
+	CallInfo *ci = lastkept(L);
 	CallInfo *next2; /* next's next */
 	/* while there are two nexts */
 	while (ci->next != NULL && (next2 = ci->next->next) != NULL) {
@@ -154,6 +170,14 @@ static void stack_init(lua_State *L1, lua_State *L) {
 	ci->top = L1->top + LUA_MINSTACK;
 	L1->ci = ci;
 	stack_push_nil(L1); /* 'function' entry for this 'ci' */
+	/* link the block of 'CallInfo's */
+	L1->cis = luaM_newvector(L, BASIC_CI_SIZE, CallInfo);
+	for (i = 0; i < BASIC_CI_SIZE; i++) {
+		L1->cis[i].previous = ci;
+		L1->cis[i].next = NULL;
+		ci->next = &L1->cis[i];
+		ci = ci->next;
+	}
 }
 
 void freestack(lua_State *L) {
@@ -162,6 +186,9 @@ void freestack(lua_State *L) {
 	L->ci = &L->base_ci; /* free the entire 'ci' list */
 	luaE_freeCI(L);
 	lua_assert(L->nci == 0);
+	if (L->cis != NULL)
+		luaM_freearray(L, L->cis, BASIC_CI_SIZE);
+	L->cis = NULL;
 	StkId ptr = L->stack;
 	while (ptr < L->top && *ptr) {
 		refDec(L, *ptr);
@@ -217,6 +244,7 @@ static void preinit_thread(lua_State *L, global_State *g) {
 	L->l_G = g;
 	L->stack = NULL;
 	L->ci = NULL;
+	L->cis = NULL;
 	L->nci = 0;
 	L->stacksize = 0;
 	L->twups = L; /* thread has no upvalues */
@@ -237,9 +265,9 @@ static void close_state(lua_State *L) {
 	global_State *g = G(L);
 	luaF_close(L, L->stack); /* close all upvalues for this thread */
 	luaC_freeallobjects(L); /* collect all objects */
+	luaC_callallgc(L); /* while the registry is still there */
 	if (g->version) /* closing a fully built state? */
 		luai_userstateclose(L);
-	refDec(L, g->memerrmsg);
 	for (int i = 0; i < TM_N; i++)
 		refDec(L, g->tmname[i]);
 	luaX_destroy(L);
@@ -252,6 +280,7 @@ static void close_state(lua_State *L) {
 //	clean_const(L);
 	freestack(L);
 //	luaH_free_set(L, g->strt);
+	refDec(L, g->memerrmsg); /* last: it fills the free entries of 'strcache' */
 	luaS_destroy(L);
 	const_destroy(L);
 	refDec(L, L);
@@ -303,6 +332,7 @@ LUA_API lua_State *lua_newstate(lua_Alloc f, void *ud) {
 	if (l == NULL)
 		return NULL;
 	L = &l->l.l;
+	memset(O2B(L), 0, sizeof(GCPrefix)); /* it is 'l->l.extra_' */
 	_S = L;
 	_G = g = &l->g;
 	L->value_.p = L;
@@ -314,6 +344,7 @@ LUA_API lua_State *lua_newstate(lua_Alloc f, void *ud) {
 	g->frealloc = f;
 	g->ud = ud;
 	g->mainthread = L;
+	g->strt = NULL;
 	g->seed = 137;
 //	g->seed = makeseed(L);
 	g->gcrunning = 0; /* no GC while building state */
@@ -334,6 +365,11 @@ LUA_API lua_State *lua_newstate(lua_Alloc f, void *ud) {
 	g->gcstepmul = LUAI_GCMUL;
 	for (i = 0; i < LUA_NUMTAGS; i++)
 		g->mt[i] = NULL;
+	g->iternext = g->iteripairs = g->select = NULL;
+	luaV_setcollate(g, LUA_COLLAUTO);
+	g->jiton = 0; /* off until 'lua_jit' turns it on */
+	g->njit = 0;
+	luaM_initcaches(L);
 	if (luaD_rawrunprotected(L, f_luaopen, NULL) != LUA_OK) { //f_luaopen基本初始化
 		/* memory allocation error: free partial state */
 		close_state(L);
@@ -9,6 +9,7 @@
 
 #include "lprefix.h"
 
+#include <stdint.h>
 #include <string.h>
 
 #include "lua.h"
@@ -24,14 +25,6 @@
 #include "qlist.h"
 #define MEMERRMSG       "not enough memory"
 
-/*
- ** Lua will use at most ~(2^LUAI_HASHLIMIT) bytes from a string to
- ** compute its hash
- */
-#if !defined(LUAI_HASHLIMIT)
-#define LUAI_HASHLIMIT		5
-#endif
-
 typedef struct NodeStr {
 	struct NodeStr *prev;
 	struct NodeStr *next;
@@ -52,14 +45,103 @@ int luaS_eqlngstr(TString *a, TString *b) {
 	(memcmp(getstr(a), getstr(b), len) == 0)); /* equal contents */
 }
 
+/*
+ ** {======================================================
+ ** String hash
+ ** =======================================================
+ */
+
+/*
+ ** Seeded hash over every byte of the string, in the style of wyhash:
+ ** the input is read 8 bytes at a time and each pair of words is folded
+ ** with a 64x64->128-bit multiplication, so that long strings sharing a
+ ** prefix, suffix or any sampled skeleton still hash apart. Long inputs
+ ** run three independent lanes, which keeps the multiplier busy.
+ */
+#define HK0	0xa0761d6478bd642fULL
+#define HK1	0xe7037ed1a0b428dbULL
+#define HK2	0x8ebc6af09c88c6e3ULL
+#define HK3	0x589965cc75374cc3ULL
+
+/* 128-bit product of '*a' and '*b': low half in '*a', high half in '*b' */
+static inline void hmul(uint64_t *a, uint64_t *b) {
+#if defined(__SIZEOF_INT128__)
+	__uint128_t r = (__uint128_t) *a * *b;
+	*a = (uint64_t) r;
+	*b = (uint64_t) (r >> 64);
+#else
+	uint64_t ha = *a >> 32, hb = *b >> 32, la = (uint32_t) *a,
+			lb = (uint32_t) *b;
+	uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+	uint64_t t = rl + (rm0 << 32), c = t < rl, lo = t + (rm1 << 32);
+	c += lo < t;
+	*a = lo;
+	*b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+static inline uint64_t hmix(uint64_t a, uint64_t b) {
+	hmul(&a, &b);
+	return a ^ b;
+}
+
+static inline uint64_t rd64(const char *p) {
+	uint64_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline uint64_t rd32(const char *p) {
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
 unsigned int luaS_hash(const char *str, size_t l, unsigned int seed) {
-	unsigned int h = seed ^ cast(unsigned int, l); //Times33
-	size_t step = (l >> LUAI_HASHLIMIT) + 1;
-	for (; l >= step; l -= step)
-		h ^= ((h << 5) + (h >> 2) + cast_byte(str[l - 1]));
-	return h;
+	const char *p = str;
+	uint64_t h = seed ^ HK0, a, b;
+	h ^= hmix(h, HK1);
+	if (l <= 16) {
+		if (l >= 4) { /* two (maybe overlapping) pairs of 4-byte words */
+			size_t d = (l >> 3) << 2;
+			a = (rd32(p) << 32) | rd32(p + d);
+			b = (rd32(p + l - 4) << 32) | rd32(p + l - 4 - d);
+		} else if (l > 0) {
+			a = ((uint64_t) cast_byte(p[0]) << 16)
+					| ((uint64_t) cast_byte(p[l >> 1]) << 8) | cast_byte(p[l - 1]);
+			b = 0;
+		} else
+			a = b = 0;
+	} else {
+		size_t i = l;
+		if (i > 48) {
+			uint64_t h1 = h, h2 = h;
+			do {
+				h = hmix(rd64(p) ^ HK1, rd64(p + 8) ^ h);
+				h1 = hmix(rd64(p + 16) ^ HK2, rd64(p + 24) ^ h1);
+				h2 = hmix(rd64(p + 32) ^ HK3, rd64(p + 40) ^ h2);
+				p += 48;
+				i -= 48;
+			} while (i > 48);
+			h ^= h1 ^ h2;
+		}
+		while (i > 16) {
+			h = hmix(rd64(p) ^ HK1, rd64(p + 8) ^ h);
+			p += 16;
+			i -= 16;
+		}
+		/* last 16 bytes, overlapping what was already read */
+		a = rd64(p + i - 16);
+		b = rd64(p + i - 8);
+	}
+	a ^= HK1;
+	b ^= h;
+	hmul(&a, &b);
+	return cast(unsigned int, hmix(a ^ HK0 ^ l, b ^ HK1));
 }
 
+/* }====================================================== */
+
 unsigned int luaS_hashlongstr(TString *ts) {
 	lua_assert(ts->tt == LUA_TLNGSTR);
 	if (ts->extra == 0) { /* no hash? */
@@ -70,44 +152,89 @@ unsigned int luaS_hashlongstr(TString *ts) {
 }
 
 /*
- ** resizes the string table
+ ** {======================================================
+ ** Incremental rehash
+ ** =======================================================
+ */
+
+/*
+ ** Growing the string table does not move every string at once: the new
+ ** bucket array becomes the main one and the old one is drained a few
+ ** buckets at a time by each intern or remove. Until the old array is
+ ** empty a string may live in either, so lookups check both. 'strt'
+ ** keeps the old array in fields that a string table does not use
+ ** otherwise.
+ */
+#define oldentry(t)	cast(SEntry*, (t)->array)	/* array being drained */
+#define oldsize(t)	(t)->sizearray	/* its size (0 when not rehashing) */
+#define rehashpos(t)	(t)->len_array	/* first bucket not moved yet */
+#define isrehashing(t)	(oldsize(t) != 0)
+
+/* buckets moved per intern/remove: the old array is empty long before
+ * the new one fills up and needs to grow in turn */
+#define REHASHSTEP	4
+
+/* link 'node' as the head of bucket 'entry' */
+static void linkhead(SEntry *entry, NodeStr *node) {
+	NodeStr *next = entry->node;
+	node->next = next;
+	node->prev = cast(NodeStr*, cast(intptr_t,entry) | 1);
+	if (next)
+		next->prev = node;
+	entry->node = node;
+}
+
+/*
+ ** move up to 'n' buckets of the old array into the main one; frees the
+ ** old array once it is empty
  */
+static void rehashstep(lua_State *L, Table *t, unsigned int n) {
+	SEntry *oldt = oldentry(t), *newt = cast(SEntry*, t->entry);
+	unsigned int size = oldsize(t), i = rehashpos(t);
+	for (; n > 0 && i < size; n--, i++) {
+		NodeStr *node = oldt[i].node, *next;
+		oldt[i].node = NULL;
+		for (; node; node = next) {
+			next = node->next;
+			linkhead(&newt[node->ts->hash & t->nodemask], node);
+		}
+	}
+	rehashpos(t) = i;
+	if (i == size) {
+		luaM_freearray(L, oldt, size);
+		t->array = NULL;
+		oldsize(t) = rehashpos(t) = 0;
+	}
+}
 
+/* }====================================================== */
+
+/*
+ ** resizes the string table: the new array takes over at once and the
+ ** old one is drained by 'rehashstep' (a pending rehash is completed
+ ** first)
+ */
 void luaS_resize(lua_State *L, lua_Integer size) {
 	Table *t = G(L)->strt;
-	lua_Integer oldsize = t->lsizenode, pos, newsize = 64;
+	lua_Integer oldsize = t->lsizenode, newsize = 64;
 	for (; newsize < size && newsize > 0; newsize <<= 1)
 		;
-	if (newsize < 0)
+	if (newsize < 0 || newsize > MAX_INT)
 		luaD_throw(L, LUA_ERRMEM);
+	if (isrehashing(t))
+		rehashstep(L, t, oldsize(t));
 	if (newsize != oldsize) {
-		register SEntry *oldt = (SEntry*) t->entry, *newt, *entry;
-		newt = luaM_newvector(L, newsize, SEntry);
-		t->entry = (Entry*) newt;
+		SEntry *newt = luaM_newvector(L, newsize, SEntry);
 		memset(newt, 0, newsize * sizeof(SEntry));
-		t->lsizenode = newsize;
-		lua_Integer mod = newsize - 1;
-		t->nodemask = mod;
 		if (t->length) {
-			NodeStr *node, *next;
-			for (register ssize_t i = 0; i < oldsize; i++) {
-				node = oldt[i].node;
-				while (node) {
-					pos = node->ts->hash & mod;
-					next = node->next;
-					entry = &newt[pos];
-					node->next = entry->node;
-					if (node->next) {
-						node->next->prev = node;
-					}
-					node->prev = cast(NodeStr*, cast(intptr_t,entry)|1);
-					entry->node = node;
-					node = next;
-				}
-			}
-		}
-		if (oldsize)
-			luaM_freearray(L, oldt, oldsize);
+			t->array = cast(TValue**, t->entry);
+			oldsize(t) = cast(unsigned int, oldsize);
+			rehashpos(t) = 0;
+		} else if (oldsize)
+			luaM_freearray(L, cast(SEntry*, t->entry), oldsize);
+		t->entry = cast(Entry*, newt);
+		t->lsizenode = newsize;
+		t->nodemask = newsize - 1;
 	}
 }
 
@@ -116,6 +243,25 @@ void luaS_resize(lua_State *L, lua_Integer size) {
  ** a non-collectable string.)
  */
 void luaS_clearcache(global_State *g) {
+	int i, j;
+	for (i = 0; i < STRCACHE_N; i++)
+		for (j = 0; j < STRCACHE_M; j++) {
+			g->strcache[i][j]->info = 0; /* no-op for 'memerrmsg' */
+			g->strcache[i][j] = g->memerrmsg;
+		}
+}
+
+/*
+ ** Remove a short string from its set of the API cache; the set keeps
+ ** its other entries.
+ */
+static void uncache(global_State *g, TString *ts) {
+	TString **p = g->strcache[cacheset(ts)];
+	int j;
+	for (j = 0; j < STRCACHE_M; j++)
+		if (p[j] == ts)
+			p[j] = g->memerrmsg;
+	ts->info = 0;
 }
 
 /*
@@ -123,6 +269,7 @@ void luaS_clearcache(global_State *g) {
  */
 void luaS_init(lua_State *L) {
 	global_State *g = G(L);
+	int i, j;
 	if (g->strt == NULL) {
 		Table *strt = (Table*) luaM_realloc_(L, NULL, 0, sizeof(Table));
 		memset(strt, 0, sizeof(Table));
@@ -132,6 +279,9 @@ void luaS_init(lua_State *L) {
 		/* pre-create memory-error message */
 		g->memerrmsg = luaS_newliteral(L, MEMERRMSG);
 		refInc(g->memerrmsg);/* it should never be collected */
+		for (i = 0; i < STRCACHE_N; i++) /* fill cache with valid strings */
+			for (j = 0; j < STRCACHE_M; j++)
+				g->strcache[i][j] = g->memerrmsg;
 	}
 }
 
@@ -156,46 +306,213 @@ TString *luaS_createlngstrobj(lua_State *L, size_t l) {
 	return ts;
 }
 
+/* string of 'len' bytes at 'str' with hash 'hash' in bucket 'entry' */
+static TString *findstr(SEntry *entry, const char *str, int len,
+		unsigned int hash) {
+	NodeStr *node;
+	for (node = entry->node; node; node = node->next) {
+		if (node->ts->hash == hash && node->ts->length == len
+				&& memcmp(str, node->ts->val, len) == 0)
+			return node->ts;
+	}
+	return NULL;
+}
+
+/*
+ ** characters held by the block of a growable string of length 'l': the
+ ** next power of 2, so that appends copy each byte O(1) times on average
+ */
+size_t luaS_capacity(size_t l) {
+	size_t cap = 64;
+	while (cap <= l)
+		cap <<= 1;
+	return cap;
+}
+
+/*
+ ** new growable long string of length 'l' (contents left to the caller)
+ */
+TString *luaS_newgrowable(lua_State *L, size_t l) {
+	TString *ts = createstrobj(L, luaS_capacity(l), LUA_TLNGSTR);
+	ts->info = LSTRGROW;
+	ts->length = l;
+	getstr(ts)[l] = '\0';
+	return ts;
+}
+
+/*
+ ** set the length of growable string 'ts' to 'l', moving it to a larger
+ ** block when its spare room is not enough. The caller must hold every
+ ** reference to 'ts' and update them with the result.
+ */
+TString *luaS_growlngstr(lua_State *L, TString *ts, size_t l) {
+	size_t oldcap = luaS_capacity(ts->length), cap = luaS_capacity(l);
+	lua_assert(isgrowable(ts) && l >= ts->length);
+	if (cap != oldcap) {
+		ObjPrefix *ob = cast(ObjPrefix*, luaM_realloc_(L, refObj(ts),
+				sizeof(ObjPrefix) + sizelstring(oldcap),
+				sizeof(ObjPrefix) + sizelstring(cap)));
+		ts = cast(TString*, ob + 1);
+		ts->value_.p = ts; /* objects point to themselves */
+	}
+	ts->length = l;
+	ts->extra = 0; /* contents changed: forget the hash */
+	getstr(ts)[l] = '\0';
+	return ts;
+}
+
+/* string object whose characters start at 'b' */
+#define buff2ts(b)	cast(TString *, (b) - offsetof(TString, val))
+
+/*
+ ** block of a string buffer (see 'lua_resizestrbuf'): a long string
+ ** object with room for 'cap' characters plus the ending '\0', replacing
+ ** the block at 'b' with room for 'ocap' (NULL for a new one). 'cap' 0
+ ** frees the block. Its header is meaningless until 'luaS_adoptbuff'.
+ */
+char *luaS_resizebuff(lua_State *L, char *b, size_t ocap, size_t cap) {
+	ObjPrefix *ob;
+	TString *ts;
+	if (cap == 0) { /* free the block? */
+		if (b != NULL) {
+			ob = refObj(buff2ts(b));
+			obj_remove(L, ob);
+			luaM_realloc_(L, ob, sizeof(ObjPrefix) + sizelstring(ocap), 0);
+		}
+		return NULL;
+	}
+	if (b == NULL)
+		ts = createstrobj(L, cap, LUA_TLNGSTR);
+	else {
+		ob = cast(ObjPrefix*, luaM_realloc_(L, refObj(buff2ts(b)),
+				sizeof(ObjPrefix) + sizelstring(ocap),
+				sizeof(ObjPrefix) + sizelstring(cap)));
+		ts = cast(TString*, ob + 1);
+		ts->value_.p = ts; /* objects point to themselves */
+	}
+	return ts->val;
+}
+
+/*
+ ** string with the first 'l' characters of the buffer block at 'b',
+ ** with room for 'cap' of them, which it takes over: a long string
+ ** keeps the block as a growable one (so later appends with '..' stay
+ ** in place too), trimming it when it was reserved beyond that; a
+ ** short one must be interned, so it copies them and frees the block.
+ */
+TString *luaS_adoptbuff(lua_State *L, char *b, size_t cap, size_t l) {
+	TString *ts;
+	lua_assert(l < cap || (b == NULL && l == 0));
+	if (l <= LUAI_MAXSHORTLEN) {
+		ts = luaS_newlstr(L, (b != NULL) ? b : "", l);
+		luaS_resizebuff(L, b, cap, 0);
+		return ts;
+	}
+	if (cap != luaS_capacity(l))
+		b = luaS_resizebuff(L, b, cap, luaS_capacity(l));
+	ts = buff2ts(b);
+	ts->info = LSTRGROW;
+	ts->extra = 0;
+	ts->length = l;
+	b[l] = '\0';
+	return ts;
+}
+
+/*
+ ** substring of 'l' bytes of string 'ts' starting at byte 'i'. A long
+ ** enough piece of a long string shares the bytes of its outermost
+ ** parent, which the slice keeps alive, instead of copying them.
+ */
+TString *luaS_sub(lua_State *L, TString *ts, size_t i, size_t l) {
+	TString *parent = ts;
+	TString *sl;
+	StrSlice *ss;
+	lua_assert(i + l <= tsslen(ts));
+	if (ts->tt == LUA_TLNGSTR && isslice(ts))
+		parent = strslice(ts)->parent; /* slices never nest */
+	if (l <= LUAI_MAXSHORTLEN || ts->tt != LUA_TLNGSTR
+			|| l * LSTRSLICERATIO < tsslen(parent))
+		return luaS_newlstr(L, getstr(ts) + i, l);
+	if (l == tsslen(ts))
+		return ts;
+	sl = cast(TString*, luaC_newobjNotGC(L, LUA_TLNGSTR,
+			sizelstring(sizeof(StrSlice))));
+	sl->info = LSTRSLICE;
+	sl->extra = 0;
+	sl->length = l;
+	ss = strslice(sl);
+	ss->data = getstr(ts) + i;
+	ss->parent = parent;
+	ss->cstr = NULL;
+	refInc(parent);
+	return sl;
+}
+
+/*
+ ** '\0'-terminated contents of slice 'ts': its own bytes when the parent
+ ** happens to have a '\0' right after them (e.g., a suffix), otherwise a
+ ** copy kept until the slice dies, so that the address stays valid
+ */
+const char *luaS_terminate(lua_State *L, TString *ts) {
+	StrSlice *ss = strslice(ts);
+	if (ss->cstr == NULL) {
+		if (ss->data[ts->length] == '\0')
+			return ss->data;
+		ss->cstr = luaM_newvector(L, ts->length + 1, char);
+		memcpy(ss->cstr, ss->data, ts->length * sizeof(char));
+		ss->cstr[ts->length] = '\0';
+	}
+	return ss->cstr;
+}
+
+/*
+ ** release what a dying slice holds (its block is freed by the caller)
+ */
+void luaS_freeslice(lua_State *L, TString *ts) {
+	StrSlice *ss = strslice(ts);
+	if (ss->cstr != NULL)
+		luaM_freearray(L, ss->cstr, ts->length + 1);
+	refDec(L, cast(TValue*, ss->parent));
+}
+
 static TString* internshrstr(lua_State *L, const char *str, int len) {
 	Table *t = G(L)->strt;
-	if (t->length > t->lsizenode) {
+	TString *ts;
+	NodeStr *node;
+	if (isrehashing(t))
+		rehashstep(L, t, REHASHSTEP);
+	else if (t->length > t->lsizenode)
 		luaS_resize(L, t->lsizenode * 2);
-	}
-	lua_Integer hash = luaS_hash(str, len, G(L)->seed);
-	size_t pos = t->nodemask & hash;
-	SEntry *entry = (SEntry*) t->entry + pos;
-	NodeStr *node = entry->node;
-	while (node) {
-		if (node->ts->hash == hash
-				&& memcmp(str, cast(NodeStr*,node)->ts->val, len) == 0) {
-			return cast(NodeStr*,node)->ts;
-		}
-		node = node->next;
+	unsigned int hash = luaS_hash(str, len, G(L)->seed);
+	SEntry *entry = (SEntry*) t->entry + (t->nodemask & hash);
+	if ((ts = findstr(entry, str, len, hash)) != NULL)
+		return ts;
+	if (isrehashing(t)) { /* not moved to the main array yet? */
+		size_t pos = hash & (oldsize(t) - 1);
+		if (pos >= rehashpos(t)
+				&& (ts = findstr(oldentry(t) + pos, str, len, hash)) != NULL)
+			return ts;
 	}
 	node = cast(NodeStr*, luaM_realloc_(L, NULL, 0, sizesstring(len)));
 	node->nref = 0;
-	TString *ts = node->ts;
+	ts = node->ts;
 	ts->marked = node->nref = 0;
 	ts->value_.p = ts;
 	ts->tt = LUA_TSHRSTR;
 	ts->hash = hash;
+	ts->info = ts->extra = 0;
 	memcpy(getstr(ts), str, len * sizeof(char));
 	ts->val[len] = '\0';
 	ts->length = len;
-	ts->info = ts->extra = 0;
 	++t->length;
-	NodeStr *next = entry->node;
-	node->next = next;
-	node->prev = cast(NodeStr*, cast(intptr_t,entry) | 1);
-	if (next) {
-		next->prev = node;
-	}
-	entry->node = node;
+	linkhead(entry, node);
 	return ts;
 }
 inline void luaS_destroy(lua_State *L) {
 	Table *t = G(L)->strt;
 	lua_assert(t->length == 0);
+	if (isrehashing(t))
+		luaM_freearray(L, oldentry(t), oldsize(t));
 	luaM_realloc_(L, t->entry, t->lsizenode * sizeof(SEntry), 0);
 	luaM_realloc_(L, t, sizeof(Table), 0);
 }
@@ -203,18 +520,21 @@ void luaS_remove(lua_State *L, TString *ts) {
 	SEntry *entry;
 	NodeStr *node = cast(NodeStr*, ts) - 1;
 	lua_assert(node->nref == 0);
+	if (incache(ts))
+		uncache(G(L), ts);
 	intptr_t prev = cast(intptr_t, node->prev);
+	NodeStr *next = node->next;
 	if (prev & 1) {
 		entry = cast(SEntry*, prev ^ 1);
-		entry->node = node->next;
-	} else {
-		NodeStr *next = node->next;
+		entry->node = next;
+	} else
 		cast(NodeStr*,prev)->next = next;
-		if (next)
-			next->prev = cast(NodeStr*, prev);
-	}
+	if (next)
+		next->prev = node->prev; /* the new head points back to the entry */
 	luaM_realloc_(L, node, sizesstring(ts->length), 0);
 	G(L)->strt->length--;
+	if (isrehashing(G(L)->strt))
+		rehashstep(L, G(L)->strt, REHASHSTEP);
 }
 
 /*
@@ -264,7 +584,28 @@ TString *luaS_newlstr(lua_State *L, const char *str, size_t l) {
  ** check hits.
  */
 TString *luaS_new(lua_State *L, const char *str) {
-	return luaS_newlstr(L, str, strlen(str));
+	global_State *g = G(L);
+	unsigned int i = point2uint(str) % STRCACHE_N; /* hash */
+	TString **p = g->strcache[i];
+	TString *ts;
+	int j;
+	for (j = 0; j < STRCACHE_M; j++) {
+		if (strcmp(str, getstr(p[j])) == 0) /* hit? */
+			return p[j]; /* that is it */
+	}
+	ts = luaS_newlstr(L, str, strlen(str));
+	if (ts->tt == LUA_TSHRSTR && ts != g->memerrmsg) {
+		/* only short strings are cached; each one in a single entry */
+		if (incache(ts))
+			uncache(g, ts);
+		if (p[STRCACHE_M - 1] != g->memerrmsg)
+			p[STRCACHE_M - 1]->info = 0; /* evicted */
+		for (j = STRCACHE_M - 1; j > 0; j--)
+			p[j] = p[j - 1]; /* move out last element */
+		p[0] = ts; /* new element is first in the list */
+		ts->info = cast_byte(STRCACHED | i);
+	}
+	return ts;
 }
 
 Udata *luaS_newudata(lua_State *L, size_t s) {
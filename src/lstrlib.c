@@ -35,6 +35,17 @@
 #endif
 
 
+/*
+** byte kernels (case mapping, reversal, substring search) use SSE2 when
+** the compiler targets it and AVX2 when the CPU has it; define
+** LUA_NOSTRSIMD to keep only the scalar loops
+*/
+#if !defined(LUA_NOSTRSIMD) && defined(__GNUC__) && defined(__SSE2__)
+#define STRSIMD
+#include <immintrin.h>
+#endif
+
+
 /* macro to 'unsign' a character */
 #define uchar(c)	((unsigned char)(c))
 
@@ -51,9 +62,21 @@
 
 
 
+/*
+** get the subject string of a string function: like 'luaL_checklstring',
+** but a slice is read in place, as these functions use its length and
+** never need a '\0' after it
+*/
+static const char *checksubject (lua_State *L, int arg, size_t *l) {
+  if (lua_type(L, arg) == LUA_TSTRING)
+    return lua_tolstringview(L, arg, l);
+  return luaL_checklstring(L, arg, l);
+}
+
+
 static int str_len (lua_State *L) {
   size_t l;
-  luaL_checklstring(L, 1, &l);
+  checksubject(L, 1, &l);
   lua_pushinteger(L, (lua_Integer)l);
   return 1;
 }
@@ -69,25 +92,255 @@ static lua_Integer posrelat (lua_Integer pos, size_t len) {
 
 static int str_sub (lua_State *L) {
   size_t l;
-  const char *s = luaL_checklstring(L, 1, &l);
-  lua_Integer start = posrelat(luaL_checkinteger(L, 2), l);
-  lua_Integer end = posrelat(luaL_optinteger(L, 3, -1), l);
+  lua_Integer start, end;
+  checksubject(L, 1, &l);
+  start = posrelat(luaL_checkinteger(L, 2), l);
+  end = posrelat(luaL_optinteger(L, 3, -1), l);
   if (start < 1) start = 1;
   if (end > (lua_Integer)l) end = l;
   if (start <= end)
-    lua_pushlstring(L, s + start - 1, (size_t)(end - start) + 1);
+    lua_pushsubstring(L, 1, (size_t)start - 1, (size_t)(end - start) + 1);
   else lua_pushliteral(L, "");
   return 1;
 }
 
 
+/*
+** {======================================================
+** BYTE KERNELS
+** =======================================================
+*/
+
+typedef void (*MapKernel) (char *d, const char *s, size_t l);
+typedef const char *(*FindKernel) (const char *s1, size_t l1,
+                                   const char *s2, size_t l2);
+
+
+static void lower_scalar (char *d, const char *s, size_t l) {
+  size_t i;
+  for (i = 0; i < l; i++)
+    d[i] = tolower(uchar(s[i]));
+}
+
+
+static void upper_scalar (char *d, const char *s, size_t l) {
+  size_t i;
+  for (i = 0; i < l; i++)
+    d[i] = toupper(uchar(s[i]));
+}
+
+
+static void reverse_scalar (char *d, const char *s, size_t l) {
+  size_t i;
+  for (i = 0; i < l; i++)
+    d[i] = s[l - i - 1];
+}
+
+
+/* search 's2' (2 <= l2 <= l1) with 'memchr' on its first char */
+static const char *find_scalar (const char *s1, size_t l1,
+                                const char *s2, size_t l2) {
+  const char *init;  /* to search for a '*s2' inside 's1' */
+  l2--;  /* 1st char will be checked by 'memchr' */
+  l1 = l1-l2;  /* 's2' cannot be found after that */
+  while (l1 > 0 && (init = (const char *)memchr(s1, *s2, l1)) != NULL) {
+    init++;   /* 1st char is already checked */
+    if (memcmp(init, s2+1, l2) == 0)
+      return init-1;
+    else {  /* correct 'l1' and 's1' to try again */
+      l1 -= init-s1;
+      s1 = init;
+    }
+  }
+  return NULL;  /* not found */
+}
+
+
+#if defined(STRSIMD)
+
+/*
+** Case mapping flips bit 0x20 of the letters in a vector of ASCII bytes;
+** a vector holding any byte >= 0x80 goes through the C library, so the
+** locale still decides about those. The caller checks that the locale
+** maps ASCII letters as "C" does.
+*/
+static void case_sse2 (char *d, const char *s, size_t l, int up) {
+  const __m128i lo = _mm_set1_epi8(up ? 'a' - 1 : 'A' - 1);
+  const __m128i hi = _mm_set1_epi8(up ? 'z' + 1 : 'Z' + 1);
+  const __m128i bit = _mm_set1_epi8(0x20);
+  MapKernel f = up ? upper_scalar : lower_scalar;
+  size_t i;
+  for (i = 0; i + 16 <= l; i += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+    __m128i m;
+    if (_mm_movemask_epi8(v) != 0) {  /* not all ASCII? */
+      f(d + i, s + i, 16);
+      continue;
+    }
+    m = _mm_and_si128(_mm_cmpgt_epi8(v, lo), _mm_cmplt_epi8(v, hi));
+    _mm_storeu_si128((__m128i *)(d + i),
+                     _mm_xor_si128(v, _mm_and_si128(m, bit)));
+  }
+  f(d + i, s + i, l - i);
+}
+
+static void lower_sse2 (char *d, const char *s, size_t l) {
+  case_sse2(d, s, l, 0);
+}
+
+static void upper_sse2 (char *d, const char *s, size_t l) {
+  case_sse2(d, s, l, 1);
+}
+
+
+/* SSE2 has no byte shuffle: reverse dwords, then words, then bytes */
+static void reverse_sse2 (char *d, const char *s, size_t l) {
+  size_t i;
+  for (i = 0; i + 16 <= l; i += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(s + l - i - 16));
+    v = _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 1, 2, 3));
+    v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+    v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+    v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+    _mm_storeu_si128((__m128i *)(d + i), v);
+  }
+  reverse_scalar(d + i, s, l - i);
+}
+
+
+/*
+** Substring search: a vector of candidate starts is kept when both its
+** byte and the byte 'l2 - 1' ahead match the ends of 's2', and only
+** those candidates are compared in full.
+*/
+static const char *find_sse2 (const char *s1, size_t l1,
+                              const char *s2, size_t l2) {
+  const __m128i first = _mm_set1_epi8(s2[0]);
+  const __m128i last = _mm_set1_epi8(s2[l2 - 1]);
+  size_t i;
+  for (i = 0; i + 16 + l2 - 1 <= l1; i += 16) {
+    __m128i bf = _mm_loadu_si128((const __m128i *)(s1 + i));
+    __m128i bl = _mm_loadu_si128((const __m128i *)(s1 + i + l2 - 1));
+    unsigned int m = (unsigned int)_mm_movemask_epi8(_mm_and_si128(
+        _mm_cmpeq_epi8(first, bf), _mm_cmpeq_epi8(last, bl)));
+    while (m != 0) {
+      int k = __builtin_ctz(m);
+      if (memcmp(s1 + i + k + 1, s2 + 1, l2 - 2) == 0)
+        return s1 + i + k;
+      m &= m - 1;
+    }
+  }
+  return (l1 - i >= l2) ? find_scalar(s1 + i, l1 - i, s2, l2) : NULL;
+}
+
+
+#define AVX2	__attribute__((target("avx2")))
+
+AVX2 static void case_avx2 (char *d, const char *s, size_t l, int up) {
+  const __m256i lo = _mm256_set1_epi8(up ? 'a' - 1 : 'A' - 1);
+  const __m256i hi = _mm256_set1_epi8(up ? 'z' + 1 : 'Z' + 1);
+  const __m256i bit = _mm256_set1_epi8(0x20);
+  size_t i;
+  for (i = 0; i + 32 <= l; i += 32) {
+    __m256i v = _mm256_loadu_si256((const __m256i *)(s + i));
+    __m256i m;
+    if (_mm256_movemask_epi8(v) != 0) {  /* not all ASCII? */
+      case_sse2(d + i, s + i, 32, up);
+      continue;
+    }
+    m = _mm256_and_si256(_mm256_cmpgt_epi8(v, lo), _mm256_cmpgt_epi8(hi, v));
+    _mm256_storeu_si256((__m256i *)(d + i),
+                        _mm256_xor_si256(v, _mm256_and_si256(m, bit)));
+  }
+  case_sse2(d + i, s + i, l - i, up);
+}
+
+AVX2 static void lower_avx2 (char *d, const char *s, size_t l) {
+  case_avx2(d, s, l, 0);
+}
+
+AVX2 static void upper_avx2 (char *d, const char *s, size_t l) {
+  case_avx2(d, s, l, 1);
+}
+
+
+/* reverse the bytes of each lane, then swap the lanes */
+AVX2 static void reverse_avx2 (char *d, const char *s, size_t l) {
+  const __m256i rev = _mm256_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8,
+                                       7, 6, 5, 4, 3, 2, 1, 0,
+                                       15, 14, 13, 12, 11, 10, 9, 8,
+                                       7, 6, 5, 4, 3, 2, 1, 0);
+  size_t i;
+  for (i = 0; i + 32 <= l; i += 32) {
+    __m256i v = _mm256_loadu_si256((const __m256i *)(s + l - i - 32));
+    v = _mm256_permute4x64_epi64(_mm256_shuffle_epi8(v, rev), 0x4E);
+    _mm256_storeu_si256((__m256i *)(d + i), v);
+  }
+  reverse_sse2(d + i, s, l - i);
+}
+
+
+AVX2 static const char *find_avx2 (const char *s1, size_t l1,
+                                   const char *s2, size_t l2) {
+  const __m256i first = _mm256_set1_epi8(s2[0]);
+  const __m256i last = _mm256_set1_epi8(s2[l2 - 1]);
+  size_t i;
+  for (i = 0; i + 32 + l2 - 1 <= l1; i += 32) {
+    __m256i bf = _mm256_loadu_si256((const __m256i *)(s1 + i));
+    __m256i bl = _mm256_loadu_si256((const __m256i *)(s1 + i + l2 - 1));
+    unsigned int m = (unsigned int)_mm256_movemask_epi8(_mm256_and_si256(
+        _mm256_cmpeq_epi8(first, bf), _mm256_cmpeq_epi8(last, bl)));
+    while (m != 0) {
+      int k = __builtin_ctz(m);
+      if (memcmp(s1 + i + k + 1, s2 + 1, l2 - 2) == 0)
+        return s1 + i + k;
+      m &= m - 1;
+    }
+  }
+  return (l1 - i >= l2) ? find_sse2(s1 + i, l1 - i, s2, l2) : NULL;
+}
+
+#endif
+
+
+static struct {
+  MapKernel lower, upper, reverse;
+  FindKernel find;
+} kernels = {lower_scalar, upper_scalar, reverse_scalar, find_scalar};
+
+
+/* pick the widest kernels this CPU runs */
+static void setkernels (void) {
+#if defined(STRSIMD)
+  kernels.lower = lower_sse2;
+  kernels.upper = upper_sse2;
+  kernels.reverse = reverse_sse2;
+  kernels.find = find_sse2;
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    kernels.lower = lower_avx2;
+    kernels.upper = upper_avx2;
+    kernels.reverse = reverse_avx2;
+    kernels.find = find_avx2;
+  }
+#endif
+}
+
+
+/* does the current locale map ASCII letters as the "C" locale does? */
+static int asciicase (void) {
+  return tolower('I') == 'i' && toupper('i') == 'I';
+}
+
+/* }====================================================== */
+
+
 static int str_reverse (lua_State *L) {
-  size_t l, i;
+  size_t l;
   luaL_Buffer b;
-  const char *s = luaL_checklstring(L, 1, &l);
+  const char *s = checksubject(L, 1, &l);
   char *p = luaL_buffinitsize(L, &b, l);
-  for (i = 0; i < l; i++)
-    p[i] = s[l - i - 1];
+  kernels.reverse(p, s, l);
   luaL_pushresultsize(&b, l);
   return 1;
 }
@@ -95,12 +348,11 @@ static int str_reverse (lua_State *L) {
 
 static int str_lower (lua_State *L) {
   size_t l;
-  size_t i;
   luaL_Buffer b;
-  const char *s = luaL_checklstring(L, 1, &l);
+  const char *s = checksubject(L, 1, &l);
   char *p = luaL_buffinitsize(L, &b, l);
-  for (i=0; i<l; i++)
-    p[i] = tolower(uchar(s[i]));
+  if (asciicase()) kernels.lower(p, s, l);
+  else lower_scalar(p, s, l);
   luaL_pushresultsize(&b, l);
   return 1;
 }
@@ -108,20 +360,24 @@ static int str_lower (lua_State *L) {
 
 static int str_upper (lua_State *L) {
   size_t l;
-  size_t i;
   luaL_Buffer b;
-  const char *s = luaL_checklstring(L, 1, &l);
+  const char *s = checksubject(L, 1, &l);
   char *p = luaL_buffinitsize(L, &b, l);
-  for (i=0; i<l; i++)
-    p[i] = toupper(uchar(s[i]));
+  if (asciicase()) kernels.upper(p, s, l);
+  else upper_scalar(p, s, l);
   luaL_pushresultsize(&b, l);
   return 1;
 }
 
 
+/*
+** The first copy (and its separator) is written once; the result then
+** doubles by copying what is already built, so the work is a few large
+** 'memcpy's whatever the size of the repeated piece.
+*/
 static int str_rep (lua_State *L) {
   size_t l, lsep;
-  const char *s = luaL_checklstring(L, 1, &l);
+  const char *s = checksubject(L, 1, &l);
   lua_Integer n = luaL_checkinteger(L, 2);
   const char *sep = luaL_optlstring(L, 3, "", &lsep);
   if (n <= 0) lua_pushliteral(L, "");
@@ -129,16 +385,19 @@ static int str_rep (lua_State *L) {
     return luaL_error(L, "resulting string too large");
   else {
     size_t totallen = (size_t)n * l + (size_t)(n - 1) * lsep;
+    size_t done = l;
     luaL_Buffer b;
     char *p = luaL_buffinitsize(L, &b, totallen);
-    while (n-- > 1) {  /* first n-1 copies (followed by separator) */
-      memcpy(p, s, l * sizeof(char)); p += l;
-      if (lsep > 0) {  /* empty 'memcpy' is not that cheap */
-        memcpy(p, sep, lsep * sizeof(char));
-        p += lsep;
-      }
+    memcpy(p, s, l * sizeof(char));
+    if (n > 1 && lsep > 0) {  /* empty 'memcpy' is not that cheap */
+      memcpy(p + l, sep, lsep * sizeof(char));
+      done += lsep;
+    }
+    while (done < totallen) {  /* 'done' is a whole number of copies */
+      size_t chunk = (done < totallen - done) ? done : totallen - done;
+      memcpy(p + done, p, chunk * sizeof(char));
+      done += chunk;
     }
-    memcpy(p, s, l * sizeof(char));  /* last copy (not followed by separator) */
     luaL_pushresultsize(&b, totallen);
   }
   return 1;
@@ -147,7 +406,7 @@ static int str_rep (lua_State *L) {
 
 static int str_byte (lua_State *L) {
   size_t l;
-  const char *s = luaL_checklstring(L, 1, &l);
+  const char *s = checksubject(L, 1, &l);
   lua_Integer posi = posrelat(luaL_optinteger(L, 2, 1), l);
   lua_Integer pose = posrelat(luaL_optinteger(L, 3, posi), l);
   int n, i;
@@ -216,6 +475,7 @@ typedef struct MatchState {
   const char *src_end;  /* end ('\0') of source string */
   const char *p_end;  /* end ('\0') of pattern */
   lua_State *L;
+  int src_idx;  /* index of the source string (captures may share it) */
   int matchdepth;  /* control for recursive depth (to avoid C stack overflow) */
   unsigned char level;  /* total number of captures (finished or unfinished) */
   struct {
@@ -342,7 +602,7 @@ static const char *matchbalance (MatchState *ms, const char *s,
                                    const char *p) {
   if (p >= ms->p_end - 1)
     luaL_error(ms->L, "malformed pattern (missing arguments to '%%b')");
-  if (*s != *p) return NULL;
+  if (s >= ms->src_end || *s != *p) return NULL;
   else {
     int b = *p;
     int e = *(p+1);
@@ -462,7 +722,8 @@ static const char *match (MatchState *ms, const char *s, const char *p) {
             ep = classend(ms, p);  /* points to what is next */
             previous = (s == ms->src_init) ? '\0' : *(s - 1);
             if (!matchbracketclass(uchar(previous), p, ep - 1) &&
-               matchbracketclass(uchar(*s), p, ep - 1)) {
+               matchbracketclass((s < ms->src_end) ? uchar(*s) : '\0',
+                                 p, ep - 1)) {
               p = ep; goto init;  /* return match(ms, s, ep); */
             }
             s = NULL;  /* match failed */
@@ -525,33 +786,46 @@ static const char *match (MatchState *ms, const char *s, const char *p) {
 
 
 
+/* false starts before 'lmemfind' leaves 'memchr' for the find kernel */
+#define FINDMISSES	8
+
+/*
+** 'memchr' is the fastest scan while the first char of 's2' is rare;
+** once it keeps stopping at false starts, the find kernel, which also
+** checks the last char of 's2', takes over the rest of 's1'
+*/
 static const char *lmemfind (const char *s1, size_t l1,
                                const char *s2, size_t l2) {
   if (l2 == 0) return s1;  /* empty strings are everywhere */
   else if (l2 > l1) return NULL;  /* avoids a negative 'l1' */
   else {
-    const char *init;  /* to search for a '*s2' inside 's1' */
-    l2--;  /* 1st char will be checked by 'memchr' */
-    l1 = l1-l2;  /* 's2' cannot be found after that */
-    while (l1 > 0 && (init = (const char *)memchr(s1, *s2, l1)) != NULL) {
-      init++;   /* 1st char is already checked */
-      if (memcmp(init, s2+1, l2) == 0)
-        return init-1;
-      else {  /* correct 'l1' and 's1' to try again */
-        l1 -= init-s1;
-        s1 = init;
-      }
+    const char *end = s1 + (l1 - l2) + 1;  /* past the last start */
+    const char *init;
+    int miss = 0;
+    while (s1 < end &&
+           (init = (const char *)memchr(s1, *s2, end - s1)) != NULL) {
+      if (memcmp(init + 1, s2 + 1, l2 - 1) == 0)
+        return init;
+      s1 = init + 1;
+      if (++miss == FINDMISSES && s1 < end)
+        return kernels.find(s1, (size_t)(end - s1) + l2 - 1, s2, l2);
     }
     return NULL;  /* not found */
   }
 }
 
 
+/* push a piece of the source string */
+static void push_piece (MatchState *ms, const char *s, size_t l) {
+  lua_pushsubstring(ms->L, ms->src_idx, (size_t)(s - ms->src_init), l);
+}
+
+
 static void push_onecapture (MatchState *ms, int i, const char *s,
                                                     const char *e) {
   if (i >= ms->level) {
     if (i == 0)  /* ms->level == 0, too */
-      lua_pushlstring(ms->L, s, e - s);  /* add whole match */
+      push_piece(ms, s, e - s);  /* add whole match */
     else
       luaL_error(ms->L, "invalid capture index %%%d", i + 1);
   }
@@ -561,7 +835,7 @@ static void push_onecapture (MatchState *ms, int i, const char *s,
     if (l == CAP_POSITION)
       lua_pushinteger(ms->L, (ms->capture[i].init - ms->src_init) + 1);
     else
-      lua_pushlstring(ms->L, ms->capture[i].init, l);
+      push_piece(ms, ms->capture[i].init, l);
   }
 }
 
@@ -588,9 +862,10 @@ static int nospecials (const char *p, size_t l) {
 }
 
 
-static void prepstate (MatchState *ms, lua_State *L,
+static void prepstate (MatchState *ms, lua_State *L, int idx,
                        const char *s, size_t ls, const char *p, size_t lp) {
   ms->L = L;
+  ms->src_idx = idx;
   ms->matchdepth = MAXCCALLS;
   ms->src_init = s;
   ms->src_end = s + ls;
@@ -604,9 +879,434 @@ static void reprepstate (MatchState *ms) {
 }
 
 
+/*
+** {======================================================
+** COMPILED PATTERNS
+** A pattern is compiled once into a list of items (single-char
+** classes become 256-bit sets) plus the literal prefix every match
+** starts with, and kept in a small cache shared by the pattern
+** functions of a state. Patterns the compiler does not take (too
+** long, too many captures or sets, malformed) go through the
+** interpreter above, which keeps their (lazy) error behavior.
+** =======================================================
+*/
+
+#define MAXPLEN		64	/* longer patterns are interpreted */
+#define MAXPSETS	8	/* maximum number of different sets */
+#define PCACHESIZE	32	/* number of cached patterns (power of 2) */
+
+/* item kinds */
+#define PI_CHAR		0	/* literal character 'c' */
+#define PI_ANY		1	/* '.' */
+#define PI_SET		2	/* class or '[set]': set number 'c' */
+#define PI_OPEN		3	/* '(' */
+#define PI_POSITION	4	/* '()' */
+#define PI_CLOSE	5	/* ')': closes capture 'c' */
+#define PI_BALANCE	6	/* '%bxy': 'c' is x, 'c2' is y */
+#define PI_FRONTIER	7	/* '%f[set]': set number 'c' */
+#define PI_BACKREF	8	/* '%1'-'%9': 'c' is the digit */
+#define PI_END		9	/* '$' ending the pattern */
+
+typedef struct PItem {
+  unsigned char kind;
+  unsigned char rep;  /* suffix of a single-char item ('*', '+', '-', '?') */
+  unsigned char c, c2;
+} PItem;
+
+typedef struct Pattern {
+  const char *key;  /* address of the pattern text (its identity) */
+  size_t len;  /* length of the pattern text */
+  char text[MAXPLEN];  /* copy of the text, to validate a hit */
+  int nitem;  /* number of items (-1: not compilable) */
+  int nset;  /* number of sets */
+  int anchor;  /* pattern starts with '^'? */
+  int literal;  /* pattern is just its prefix? */
+  int first;  /* item every match starts with, for skipping (or -1) */
+  size_t nprefix;  /* length of the literal prefix */
+  char prefix[MAXPLEN];
+  PItem item[MAXPLEN];
+  unsigned char set[MAXPSETS][256 / CHAR_BIT];
+} Pattern;
+
+typedef struct PCache {
+  Pattern slot[PCACHESIZE];
+} PCache;
+
+
+#define testset(st,c)	((st)[(c) / CHAR_BIT] & (1u << ((c) % CHAR_BIT)))
+
+static int addset (Pattern *pt, const char *p, const char *ep) {
+  int n = 0;
+  unsigned char st[256 / CHAR_BIT];
+  int c;
+  memset(st, 0, sizeof(st));
+  for (c = 0; c < 256; c++) {
+    if (*p == '[' ? matchbracketclass(c, p, ep - 1) : match_class(c, uchar(p[1])))
+      st[c / CHAR_BIT] |= 1u << (c % CHAR_BIT);
+  }
+  for (n = 0; n < pt->nset; n++)
+    if (memcmp(pt->set[n], st, sizeof(st)) == 0) return n;
+  if (n == MAXPSETS) return -1;
+  memcpy(pt->set[n], st, sizeof(st));
+  return pt->nset++;
+}
+
+
+/* end of the class at 'p' (as 'classend'), or NULL if malformed */
+static const char *pclassend (const char *p, const char *pend) {
+  switch (*p++) {
+    case L_ESC: return (p == pend) ? NULL : p + 1;
+    case '[': {
+      if (*p == '^') p++;
+      do {
+        if (p == pend) return NULL;
+        if (*(p++) == L_ESC && p < pend) p++;
+      } while (*p != ']');
+      return p + 1;
+    }
+    default: return p;
+  }
+}
+
+
+static int isclassletter (int cl) {
+  return strchr("acdglpsuwxz", tolower(cl)) != NULL;
+}
+
+
+static void setprefix (Pattern *pt) {
+  int i;
+  int plain = 1;  /* no captures so far? */
+  pt->nprefix = 0;
+  pt->first = -1;
+  for (i = 0; i < pt->nitem; i++) {
+    const PItem *it = &pt->item[i];
+    if (it->kind == PI_OPEN || it->kind == PI_POSITION || it->kind == PI_CLOSE) {
+      plain = 0;  /* zero-width, but matches must record it */
+      continue;
+    }
+    if (it->kind == PI_CHAR && it->rep == 0)
+      pt->prefix[pt->nprefix++] = it->c;
+    else {
+      if (pt->nprefix == 0 && (it->kind == PI_CHAR || it->kind == PI_SET) &&
+          (it->rep == 0 || it->rep == '+'))
+        pt->first = i;
+      break;
+    }
+  }
+  pt->literal = plain && i == pt->nitem && pt->nprefix > 0;
+}
+
+
+/* compile pattern 'p' into 'pt'; returns 0 if it must be interpreted */
+static int compile (Pattern *pt, const char *p, size_t lp) {
+  const char *pend = p + lp;
+  int open[LUA_MAXCAPTURES];  /* captures still open */
+  int nopen = 0, ncap = 0;
+  pt->nitem = pt->nset = 0;
+  pt->anchor = (lp > 0 && *p == '^');
+  if (pt->anchor) p++;
+  while (p < pend) {
+    PItem *it = &pt->item[pt->nitem++];
+    it->rep = it->c = it->c2 = 0;
+    switch (*p) {
+      case '(': {
+        if (ncap == LUA_MAXCAPTURES) return 0;
+        if (p + 1 < pend && p[1] == ')') {
+          it->kind = PI_POSITION; p += 2;
+        }
+        else {
+          it->kind = PI_OPEN; open[nopen++] = ncap; p++;
+        }
+        ncap++;
+        continue;
+      }
+      case ')': {
+        if (nopen == 0) return 0;
+        it->kind = PI_CLOSE; it->c = open[--nopen]; p++;
+        continue;
+      }
+      case '$': {
+        if (p + 1 == pend) {
+          it->kind = PI_END; p++;
+          continue;
+        }
+        break;
+      }
+      case L_ESC: {
+        if (p + 1 == pend) return 0;
+        if (p[1] == 'b') {
+          if (p + 3 >= pend) return 0;
+          it->kind = PI_BALANCE; it->c = uchar(p[2]); it->c2 = uchar(p[3]);
+          p += 4;
+          continue;
+        }
+        else if (p[1] == 'f') {
+          const char *ep;
+          int n;
+          p += 2;
+          if (p == pend || *p != '[' || (ep = pclassend(p, pend)) == NULL ||
+              (n = addset(pt, p, ep)) < 0)
+            return 0;
+          it->kind = PI_FRONTIER; it->c = n;
+          p = ep;
+          continue;
+        }
+        else if (isdigit(uchar(p[1]))) {
+          it->kind = PI_BACKREF; it->c = uchar(p[1]);
+          p += 2;
+          continue;
+        }
+        break;
+      }
+      default: break;
+    }
+    {  /* single-char class plus optional suffix */
+      const char *ep = pclassend(p, pend);
+      if (ep == NULL) return 0;
+      if (*p == '.')
+        it->kind = PI_ANY;
+      else if (*p == '[' || (*p == L_ESC && isclassletter(uchar(p[1])))) {
+        int n = addset(pt, p, ep);
+        if (n < 0) return 0;
+        it->kind = PI_SET; it->c = n;
+      }
+      else {
+        it->kind = PI_CHAR; it->c = uchar(*p == L_ESC ? p[1] : *p);
+      }
+      if (ep < pend && strchr("*+-?", *ep)) {
+        it->rep = uchar(*ep);
+        ep++;
+      }
+      p = ep;
+    }
+  }
+  setprefix(pt);
+  return 1;
+}
+
+
+/*
+** compiled form of pattern 'p', from the cache of the running function
+** (its first upvalue), or NULL if it must be interpreted
+*/
+static const Pattern *getpattern (lua_State *L, const char *p, size_t lp) {
+  PCache *pc = (PCache *)lua_touserdata(L, lua_upvalueindex(1));
+  size_t h = (size_t)p;
+  Pattern *pt;
+  if (lp > MAXPLEN) return NULL;
+  pt = &pc->slot[((h >> 4) ^ (h >> 11)) & (PCACHESIZE - 1)];
+  if (pt->key != p || pt->len != lp || memcmp(pt->text, p, lp) != 0) {
+    pt->key = p;
+    pt->len = lp;
+    memcpy(pt->text, p, lp);
+    if (!compile(pt, p, lp))
+      pt->nitem = -1;
+  }
+  return (pt->nitem < 0) ? NULL : pt;
+}
+
+
+static int singleitem (const Pattern *pt, const PItem *it, int c) {
+  switch (it->kind) {
+    case PI_CHAR: return (c == it->c);
+    case PI_ANY: return 1;
+    default: return testset(pt->set[it->c], c);
+  }
+}
+
+
+static const char *pmatch (MatchState *ms, const Pattern *pt,
+                           const char *s, int i);
+
+
+static const char *pmax_expand (MatchState *ms, const Pattern *pt,
+                                const char *s, int i) {
+  const PItem *it = &pt->item[i];
+  ptrdiff_t n = 0;
+  if (it->kind == PI_ANY)
+    n = ms->src_end - s;
+  else
+    while (s + n < ms->src_end && singleitem(pt, it, uchar(s[n])))
+      n++;
+  while (n >= 0) {
+    const char *res = pmatch(ms, pt, s + n, i + 1);
+    if (res) return res;
+    n--;
+  }
+  return NULL;
+}
+
+
+static const char *pmin_expand (MatchState *ms, const Pattern *pt,
+                                const char *s, int i) {
+  const PItem *it = &pt->item[i];
+  for (;;) {
+    const char *res = pmatch(ms, pt, s, i + 1);
+    if (res != NULL)
+      return res;
+    else if (s < ms->src_end && singleitem(pt, it, uchar(*s)))
+      s++;
+    else return NULL;
+  }
+}
+
+
+static const char *pbalance (MatchState *ms, const char *s, int b, int e) {
+  int cont = 1;
+  if (s >= ms->src_end || uchar(*s) != b) return NULL;
+  while (++s < ms->src_end) {
+    if (uchar(*s) == e) {
+      if (--cont == 0) return s + 1;
+    }
+    else if (uchar(*s) == b) cont++;
+  }
+  return NULL;
+}
+
+
+/* same as 'match', item 'i' onwards of a compiled pattern */
+static const char *pmatch (MatchState *ms, const Pattern *pt,
+                           const char *s, int i) {
+  if (ms->matchdepth-- == 0)
+    luaL_error(ms->L, "pattern too complex");
+  init:
+  if (i != pt->nitem) {
+    const PItem *it = &pt->item[i];
+    switch (it->kind) {
+      case PI_OPEN: case PI_POSITION: {
+        int level = ms->level;
+        ms->capture[level].init = s;
+        ms->capture[level].len =
+            (it->kind == PI_OPEN) ? CAP_UNFINISHED : CAP_POSITION;
+        ms->level = level + 1;
+        if ((s = pmatch(ms, pt, s, i + 1)) == NULL)
+          ms->level--;
+        break;
+      }
+      case PI_CLOSE: {
+        const char *res;
+        ms->capture[it->c].len = s - ms->capture[it->c].init;
+        if ((res = pmatch(ms, pt, s, i + 1)) == NULL)
+          ms->capture[it->c].len = CAP_UNFINISHED;
+        s = res;
+        break;
+      }
+      case PI_END: {
+        s = (s == ms->src_end) ? s : NULL;
+        break;
+      }
+      case PI_BALANCE: {
+        if ((s = pbalance(ms, s, it->c, it->c2)) != NULL) {
+          i++; goto init;
+        }
+        break;
+      }
+      case PI_FRONTIER: {
+        int prev = (s == ms->src_init) ? '\0' : uchar(*(s - 1));
+        int cur = (s < ms->src_end) ? uchar(*s) : '\0';
+        if (!testset(pt->set[it->c], prev) && testset(pt->set[it->c], cur)) {
+          i++; goto init;
+        }
+        s = NULL;
+        break;
+      }
+      case PI_BACKREF: {
+        if ((s = match_capture(ms, s, it->c)) != NULL) {
+          i++; goto init;
+        }
+        break;
+      }
+      default: {
+        if (s >= ms->src_end || !singleitem(pt, it, uchar(*s))) {
+          if (it->rep == '*' || it->rep == '?' || it->rep == '-') {
+            i++; goto init;
+          }
+          s = NULL;
+        }
+        else {
+          switch (it->rep) {
+            case '?': {
+              const char *res;
+              if ((res = pmatch(ms, pt, s + 1, i + 1)) != NULL)
+                s = res;
+              else {
+                i++; goto init;
+              }
+              break;
+            }
+            case '+':
+              s++;
+              /* FALLTHROUGH */
+            case '*':
+              s = pmax_expand(ms, pt, s, i);
+              break;
+            case '-':
+              s = pmin_expand(ms, pt, s, i);
+              break;
+            default:
+              s++; i++; goto init;
+          }
+        }
+        break;
+      }
+    }
+  }
+  ms->matchdepth++;
+  return s;
+}
+
+
+/*
+** first position from 's' where an unanchored match may start, or NULL
+** if there is none
+*/
+static const char *pskip (const Pattern *pt, const char *s, const char *e) {
+  if (pt->nprefix > 0)
+    return lmemfind(s, e - s, pt->prefix, pt->nprefix);
+  else if (pt->first >= 0) {
+    const PItem *it = &pt->item[pt->first];
+    if (it->kind == PI_CHAR)
+      return (const char *)memchr(s, it->c, e - s);
+    while (s < e && !testset(pt->set[it->c], uchar(*s)))
+      s++;
+    return (s < e) ? s : NULL;
+  }
+  return s;
+}
+
+
+/*
+** find the first match of 'pt' starting at 's' or later (only at 's'
+** if 'anchor'); returns its start and sets '*e' to its end
+*/
+static const char *pfind (MatchState *ms, const Pattern *pt,
+                          const char *s, const char **e, int anchor) {
+  for (;;) {
+    reprepstate(ms);
+    if (!anchor && (s = pskip(pt, s, ms->src_end)) == NULL)
+      return NULL;
+    if (pt->literal) {  /* no need to run it */
+      if (anchor && ((size_t)(ms->src_end - s) < pt->nprefix ||
+                     memcmp(s, pt->prefix, pt->nprefix) != 0))
+        return NULL;
+      *e = s + pt->nprefix;
+      return s;
+    }
+    if ((*e = pmatch(ms, pt, s, 0)) != NULL)
+      return s;
+    if (anchor || s >= ms->src_end)
+      return NULL;
+    s++;
+  }
+}
+
+/* }====================================================== */
+
+
 static int str_find_aux (lua_State *L, int find) {
   size_t ls, lp;
-  const char *s = luaL_checklstring(L, 1, &ls);
+  const char *s = checksubject(L, 1, &ls);
   const char *p = luaL_checklstring(L, 2, &lp);
   lua_Integer init = posrelat(luaL_optinteger(L, 3, 1), ls);
   if (init < 1) init = 1;
@@ -627,12 +1327,25 @@ static int str_find_aux (lua_State *L, int find) {
   else {
     MatchState ms;
     const char *s1 = s + init - 1;
+    const Pattern *pt = getpattern(L, p, lp);
     int anchor = (*p == '^');
     if (anchor) {
       p++; lp--;  /* skip anchor character */
     }
-    prepstate(&ms, L, s, ls, p, lp);
-    do {
+    prepstate(&ms, L, 1, s, ls, p, lp);
+    if (pt != NULL) {
+      const char *res;
+      if ((s1 = pfind(&ms, pt, s1, &res, anchor)) != NULL) {
+        if (find) {
+          lua_pushinteger(L, (s1 - s) + 1);  /* start */
+          lua_pushinteger(L, res - s);   /* end */
+          return push_captures(&ms, NULL, 0) + 2;
+        }
+        else
+          return push_captures(&ms, s1, res);
+      }
+    }
+    else do {
       const char *res;
       reprepstate(&ms);
       if ((res=match(&ms, s1, p)) != NULL) {
@@ -667,6 +1380,8 @@ typedef struct GMatchState {
   const char *p;  /* pattern */
   const char *lastmatch;  /* end of last match */
   MatchState ms;  /* match state */
+  int compiled;  /* 'pt' holds the compiled pattern? */
+  Pattern pt;  /* a copy: the cache may reuse its slot meanwhile */
 } GMatchState;
 
 
@@ -674,6 +1389,18 @@ static int gmatch_aux (lua_State *L) {
   GMatchState *gm = (GMatchState *)lua_touserdata(L, lua_upvalueindex(3));
   const char *src;
   gm->ms.L = L;
+  if (gm->compiled) {
+    const char *s, *e;
+    for (src = gm->src; src <= gm->ms.src_end; src = s + 1) {
+      if ((s = pfind(&gm->ms, &gm->pt, src, &e, 0)) == NULL)
+        break;
+      if (e != gm->lastmatch) {
+        gm->src = gm->lastmatch = e;
+        return push_captures(&gm->ms, s, e);
+      }
+    }
+    return 0;  /* not found */
+  }
   for (src = gm->src; src <= gm->ms.src_end; src++) {
     const char *e;
     reprepstate(&gm->ms);
@@ -688,13 +1415,18 @@ static int gmatch_aux (lua_State *L) {
 
 static int gmatch (lua_State *L) {
   size_t ls, lp;
-  const char *s = luaL_checklstring(L, 1, &ls);
+  const char *s = checksubject(L, 1, &ls);
   const char *p = luaL_checklstring(L, 2, &lp);
+  const Pattern *pt = getpattern(L, p, lp);
   GMatchState *gm;
   lua_settop(L, 2);  /* keep them on closure to avoid being collected */
   gm = (GMatchState *)lua_newuserdata(L, sizeof(GMatchState));
-  prepstate(&gm->ms, L, s, ls, p, lp);
+  prepstate(&gm->ms, L, lua_upvalueindex(1), s, ls, p, lp);
   gm->src = s; gm->p = p; gm->lastmatch = NULL;
+  /* in 'gmatch' a '^' is not an anchor: leave that to the interpreter */
+  gm->compiled = (pt != NULL && !pt->anchor);
+  if (gm->compiled)
+    gm->pt = *pt;
   lua_pushcclosure(L, gmatch_aux, 3);
   return 1;
 }
@@ -761,7 +1493,7 @@ static void add_value (MatchState *ms, luaL_Buffer *b, const char *s,
 
 static int str_gsub (lua_State *L) {
   size_t srcl, lp;
-  const char *src = luaL_checklstring(L, 1, &srcl);  /* subject */
+  const char *src = checksubject(L, 1, &srcl);  /* subject */
   const char *p = luaL_checklstring(L, 2, &lp);  /* pattern */
   const char *lastmatch = NULL;  /* end of last match */
   int tr = lua_type(L, 3);  /* replacement type */
@@ -770,6 +1502,8 @@ static int str_gsub (lua_State *L) {
   lua_Integer n = 0;  /* replacement count */
   MatchState ms;
   luaL_Buffer b;
+  const Pattern *cpt = getpattern(L, p, lp);
+  Pattern pt;  /* a copy: replacements may run code that reuses the slot */
   luaL_argcheck(L, tr == LUA_TNUMBER || tr == LUA_TSTRING ||
                    tr == LUA_TFUNCTION || tr == LUA_TTABLE, 3,
                       "string/function/table expected");
@@ -777,11 +1511,20 @@ static int str_gsub (lua_State *L) {
   if (anchor) {
     p++; lp--;  /* skip anchor character */
   }
-  prepstate(&ms, L, src, srcl, p, lp);
+  prepstate(&ms, L, 1, src, srcl, p, lp);
+  if (cpt != NULL)
+    pt = *cpt;
   while (n < max_s) {
     const char *e;
+    if (cpt != NULL && !anchor) {  /* jump to where a match may start */
+      const char *q = pskip(&pt, src, ms.src_end);
+      if (q == NULL) break;  /* no more matches */
+      luaL_addlstring(&b, src, q - src);
+      src = q;
+    }
     reprepstate(&ms);  /* (re)prepare state for new match */
-    if ((e = match(&ms, src, p)) != NULL && e != lastmatch) {  /* match? */
+    e = (cpt != NULL) ? pmatch(&ms, &pt, src, 0) : match(&ms, src, p);
+    if (e != NULL && e != lastmatch) {  /* match? */
       n++;
       add_value(&ms, &b, src, e, tr);  /* add replacement to buffer */
       src = lastmatch = e;
@@ -958,10 +1701,11 @@ static void addliteral (lua_State *L, luaL_Buffer *b, int arg) {
       }
       else {  /* integers */
         lua_Integer n = lua_tointeger(L, arg);
-        const char *format = (n == LUA_MININTEGER)  /* corner case? */
-                           ? "0x%" LUA_INTEGER_FRMLEN "x"  /* use hexa */
-                           : LUA_INTEGER_FMT;  /* else use default format */
-        nb = l_sprintf(buff, MAX_ITEM, format, (LUAI_UACINT)n);
+        if (n == LUA_MININTEGER)  /* corner case? */
+          nb = l_sprintf(buff, MAX_ITEM, "0x%" LUA_INTEGER_FRMLEN "x",
+                         (LUAI_UACINT)n);  /* use hexa */
+        else  /* else use default format */
+          nb = lua_integertobuff(buff, MAX_ITEM, n);
       }
       luaL_addsize(b, nb);
       break;
@@ -1000,6 +1744,23 @@ static const char *scanformat (lua_State *L, const char *strfrmt, char *form) {
 }
 
 
+/*
+** Precision of a "%g" or "%.<n>g" format without flags or width,
+** which 'lua_numbertobuff' can do; -1 for any other format.
+*/
+static int plainprecision (const char *form) {
+  if (form[1] == 'g') return 6;  /* default precision */
+  if (form[1] != '.') return -1;
+  form += 2;
+  if (form[0] == 'g') return 0;
+  if (!isdigit(uchar(form[0]))) return -1;
+  if (form[1] == 'g') return form[0] - '0';
+  if (isdigit(uchar(form[1])) && form[2] == 'g')
+    return (form[0] - '0') * 10 + (form[1] - '0');
+  return -1;
+}
+
+
 /*
 ** add length modifier into formats
 */
@@ -1013,22 +1774,22 @@ static void addlenmod (char *form, const char *lenmod) {
 }
 
 
-static int str_format (lua_State *L) {
+/*
+** add to 'b' the format string at 'arg' applied to the values after it
+*/
+static void addformat (lua_State *L, luaL_Buffer *b, int arg) {
   int top = lua_gettop(L);
-  int arg = 1;
   size_t sfl;
   const char *strfrmt = luaL_checklstring(L, arg, &sfl);
   const char *strfrmt_end = strfrmt+sfl;
-  luaL_Buffer b;
-  luaL_buffinit(L, &b);
   while (strfrmt < strfrmt_end) {
     if (*strfrmt != L_ESC)
-      luaL_addchar(&b, *strfrmt++);
+      luaL_addchar(b, *strfrmt++);
     else if (*++strfrmt == L_ESC)
-      luaL_addchar(&b, *strfrmt++);  /* %% */
+      luaL_addchar(b, *strfrmt++);  /* %% */
     else { /* format item */
       char form[MAX_FORMAT];  /* to store the format ('%...') */
-      char *buff = luaL_prepbuffsize(&b, MAX_ITEM);  /* to put formatted item */
+      char *buff = luaL_prepbuffsize(b, MAX_ITEM);  /* to put formatted item */
       int nb = 0;  /* number of bytes in added item */
       if (++arg > top)
         luaL_argerror(L, arg, "no value");
@@ -1041,6 +1802,10 @@ static int str_format (lua_State *L) {
         case 'd': case 'i':
         case 'o': case 'u': case 'x': case 'X': {
           lua_Integer n = luaL_checkinteger(L, arg);
+          if (form[2] == '\0' && (form[1] == 'd' || form[1] == 'i')) {
+            nb = lua_integertobuff(buff, MAX_ITEM, n);  /* plain decimal */
+            break;
+          }
           addlenmod(form, LUA_INTEGER_FRMLEN);
           nb = l_sprintf(buff, MAX_ITEM, form, (LUAI_UACINT)n);
           break;
@@ -1053,24 +1818,29 @@ static int str_format (lua_State *L) {
         case 'e': case 'E': case 'f':
         case 'g': case 'G': {
           lua_Number n = luaL_checknumber(L, arg);
+          int prec = plainprecision(form);
+          if (prec >= 0) {
+            nb = lua_numbertobuff(buff, MAX_ITEM, n, prec);
+            break;
+          }
           addlenmod(form, LUA_NUMBER_FRMLEN);
           nb = l_sprintf(buff, MAX_ITEM, form, (LUAI_UACNUMBER)n);
           break;
         }
         case 'q': {
-          addliteral(L, &b, arg);
+          addliteral(L, b, arg);
           break;
         }
         case 's': {
           size_t l;
           const char *s = luaL_tolstring(L, arg, &l);
           if (form[2] == '\0')  /* no modifiers? */
-            luaL_addvalue(&b);  /* keep entire string */
+            luaL_addvalue(b);  /* keep entire string */
           else {
             luaL_argcheck(L, l == strlen(s), arg, "string contains zeros");
             if (!strchr(form, '.') && l >= 100) {
               /* no precision and string is too long to be formatted */
-              luaL_addvalue(&b);  /* keep entire string */
+              luaL_addvalue(b);  /* keep entire string */
             }
             else {  /* format the string into 'buff' */
               nb = l_sprintf(buff, MAX_ITEM, form, s);
@@ -1080,14 +1850,21 @@ static int str_format (lua_State *L) {
           break;
         }
         default: {  /* also treat cases 'pnLlh' */
-          return luaL_error(L, "invalid option '%%%c' to 'format'",
-                               *(strfrmt - 1));
+          luaL_error(L, "invalid option '%%%c' to 'format'",
+                        *(strfrmt - 1));
         }
       }
       lua_assert(nb < MAX_ITEM);
-      luaL_addsize(&b, nb);
+      luaL_addsize(b, nb);
     }
   }
+}
+
+
+static int str_format (lua_State *L) {
+  luaL_Buffer b;
+  luaL_buffinit(L, &b);
+  addformat(L, &b, 1);
   luaL_pushresult(&b);
   return 1;
 }
@@ -1539,17 +2316,229 @@ static int str_unpack (lua_State *L) {
 /* }====================================================== */
 
 
+/*
+** {======================================================
+** STRING BUFFERS
+** =======================================================
+*/
+
+
+/*
+** the buffer at argument 1. The functions of the library keep the
+** metatable of buffers as their upvalue, which spares the registry
+** lookup of 'luaL_checkudata' on every call.
+*/
+static luaL_StrBuf *checkstrbuf (lua_State *L) {
+  void *p = lua_touserdata(L, 1);
+  if (p != NULL && lua_getmetatable(L, 1)) {
+    int ok = lua_rawequal(L, -1, lua_upvalueindex(1));
+    lua_pop(L, 1);
+    if (ok)
+      return (luaL_StrBuf *)p;
+  }
+  return (luaL_StrBuf *)luaL_checkudata(L, 1, LUA_STRBUFHANDLE);  /* error */
+}
+
+
+/*
+** returns room for 'sz' more bytes at the end of buffer 'sb'; the block
+** keeps one spare byte for the '\0' of the final string
+*/
+static char *sb_prep (lua_State *L, luaL_StrBuf *sb, size_t sz) {
+  if (sz >= sb->size - sb->n) {  /* not enough room? */
+    if (sz >= MAXSIZE - sb->n)
+      luaL_error(L, "resulting string too large");
+    sb->b = lua_resizestrbuf(L, sb->b, &sb->size, sb->n + sz);
+  }
+  return sb->b + sb->n;
+}
+
+
+static void sb_addlstring (lua_State *L, luaL_StrBuf *sb, const char *s,
+                                         size_t l) {
+  if (l > 0) {
+    memcpy(sb_prep(L, sb, l), s, l);
+    sb->n += l;
+  }
+}
+
+
+/*
+** add the number at 'arg' as 'tostring' would convert it, formatting
+** it straight into the buffer
+*/
+static void sb_addnumber (lua_State *L, luaL_StrBuf *sb, int arg) {
+  char *buff = sb_prep(L, sb, MAX_ITEM);
+  int nb;
+  if (lua_isinteger(L, arg))
+    nb = lua_integertobuff(buff, MAX_ITEM, lua_tointeger(L, arg));
+  else {
+    nb = lua_numbertobuff(buff, MAX_ITEM, lua_tonumber(L, arg),
+                          LUA_NUMBER_DIGITS);
+    if (buff[strspn(buff, "-0123456789")] == '\0') {  /* looks like an int? */
+      buff[nb++] = lua_getlocaledecpoint();
+      buff[nb++] = '0';  /* adds '.0' to result */
+    }
+  }
+  sb->n += nb;
+}
+
+
+static int sb_new (lua_State *L) {
+  lua_Integer n = luaL_optinteger(L, 1, 0);
+  luaL_StrBuf *sb = (luaL_StrBuf *)lua_newuserdata(L, sizeof(luaL_StrBuf));
+  luaL_argcheck(L, n >= 0, 1, "invalid size");
+  sb->b = NULL;
+  sb->n = sb->size = 0;
+  lua_pushvalue(L, lua_upvalueindex(1));
+  lua_setmetatable(L, -2);
+  if (n > 0)
+    sb_prep(L, sb, (size_t)n);
+  return 1;
+}
+
+
+/*
+** append strings, numbers and other buffers; numbers and buffers go
+** in without becoming strings first
+*/
+static int sb_append (lua_State *L) {
+  luaL_StrBuf *sb = checkstrbuf(L);
+  int n = lua_gettop(L);
+  int arg;
+  for (arg = 2; arg <= n; arg++) {
+    luaL_StrBuf *other;
+    size_t l;
+    const char *s;
+    switch (lua_type(L, arg)) {
+      case LUA_TNUMBER:
+        sb_addnumber(L, sb, arg);
+        break;
+      case LUA_TUSERDATA:
+        if ((other = (luaL_StrBuf *)luaL_testudata(L, arg,
+                                        LUA_STRBUFHANDLE)) != NULL) {
+          l = other->n;
+          s = sb_prep(L, sb, l);  /* may move 'other->b' if it is 'sb' */
+          if (l > 0) memcpy((char *)s, other->b, l);
+          sb->n += l;
+          break;
+        }
+        /* else go through */
+      default:
+        s = checksubject(L, arg, &l);
+        sb_addlstring(L, sb, s, l);
+        break;
+    }
+  }
+  lua_settop(L, 1);
+  return 1;
+}
+
+
+/*
+** append 'string.format(fmt, ...)'; the items are formatted into an
+** auxiliary buffer on the C stack, never into a string
+*/
+static int sb_format (lua_State *L) {
+  luaL_StrBuf *sb = checkstrbuf(L);
+  luaL_Buffer b;
+  luaL_buffinit(L, &b);
+  addformat(L, &b, 2);
+  sb_addlstring(L, sb, b.b, b.n);
+  lua_settop(L, 1);
+  return 1;
+}
+
+
+static int sb_reserve (lua_State *L) {
+  luaL_StrBuf *sb = checkstrbuf(L);
+  lua_Integer n = luaL_checkinteger(L, 2);
+  luaL_argcheck(L, n >= 0, 2, "invalid size");
+  sb_prep(L, sb, (size_t)n);
+  lua_settop(L, 1);
+  return 1;
+}
+
+
+/* empty the buffer, keeping its block for the next contents */
+static int sb_reset (lua_State *L) {
+  luaL_StrBuf *sb = checkstrbuf(L);
+  sb->n = 0;
+  lua_settop(L, 1);
+  return 1;
+}
+
+
+static int sb_len (lua_State *L) {
+  luaL_StrBuf *sb = checkstrbuf(L);
+  lua_pushinteger(L, (lua_Integer)sb->n);
+  return 1;
+}
+
+
+/*
+** the contents as a string, which takes over the block of the buffer
+** instead of copying it; the buffer is left empty
+*/
+static int sb_tostring (lua_State *L) {
+  luaL_StrBuf *sb = checkstrbuf(L);
+  char *b = sb->b;
+  size_t size = sb->size, n = sb->n;
+  sb->b = NULL;  /* the block belongs to the string from now on */
+  sb->n = sb->size = 0;
+  lua_pushstrbuf(L, b, size, n);
+  return 1;
+}
+
+
+/* a copy of the contents, for 'tostring' and 'print'; the buffer keeps them */
+static int sb_tostringcopy (lua_State *L) {
+  luaL_StrBuf *sb = checkstrbuf(L);
+  lua_pushlstring(L, sb->b, sb->n);
+  return 1;
+}
+
+
+static int sb_gc (lua_State *L) {
+  luaL_StrBuf *sb = checkstrbuf(L);
+  sb->b = lua_resizestrbuf(L, sb->b, &sb->size, 0);
+  sb->n = 0;
+  return 0;
+}
+
+
+static const luaL_Reg sblib[] = {
+  {"new", sb_new},
+  {NULL, NULL}
+};
+
+
+/*
+** methods for string buffers
+*/
+static const luaL_Reg sbmethods[] = {
+  {"append", sb_append},
+  {"format", sb_format},
+  {"reserve", sb_reserve},
+  {"reset", sb_reset},
+  {"len", sb_len},
+  {"tostring", sb_tostring},
+  {"__len", sb_len},
+  {"__tostring", sb_tostringcopy},
+  {"__gc", sb_gc},
+  {NULL, NULL}
+};
+
+/* }====================================================== */
+
+
 static const luaL_Reg strlib[] = {
   {"byte", str_byte},
   {"char", str_char},
   {"dump", str_dump},
-  {"find", str_find},
   {"format", str_format},
-  {"gmatch", gmatch},
-  {"gsub", str_gsub},
   {"len", str_len},
   {"lower", str_lower},
-  {"match", str_match},
   {"rep", str_rep},
   {"reverse", str_reverse},
   {"sub", str_sub},
@@ -1561,6 +2550,16 @@ static const luaL_Reg strlib[] = {
 };
 
 
+/* functions sharing the compiled-pattern cache (their upvalue) */
+static const luaL_Reg patlib[] = {
+  {"find", str_find},
+  {"gmatch", gmatch},
+  {"gsub", str_gsub},
+  {"match", str_match},
+  {NULL, NULL}
+};
+
+
 static void createmetatable (lua_State *L) {
   lua_createtable(L, 0, 1);  /* table to be metatable for strings */
   lua_pushliteral(L, "");  /* dummy string */
@@ -1577,8 +2576,26 @@ static void createmetatable (lua_State *L) {
 ** Open string library
 */
 LUAMOD_API int luaopen_string (lua_State *L) {
+  setkernels();
   luaL_newlib(L, strlib);
+  memset(lua_newuserdata(L, sizeof(PCache)), 0, sizeof(PCache));
+  luaL_setfuncs(L, patlib, 1);
   createmetatable(L);
   return 1;
 }
 
+
+/*
+** Open string buffer library
+*/
+LUAMOD_API int luaopen_strbuf (lua_State *L) {
+  luaL_newlibtable(L, sblib);
+  luaL_newmetatable(L, LUA_STRBUFHANDLE);  /* metatable for buffers */
+  lua_pushvalue(L, -1);  /* push metatable */
+  lua_setfield(L, -2, "__index");  /* metatable.__index = metatable */
+  lua_pushvalue(L, -1);
+  luaL_setfuncs(L, sbmethods, 1);  /* add buffer methods to new metatable */
+  luaL_setfuncs(L, sblib, 1);  /* the metatable is their upvalue too */
+  return 1;
+}
+
@@ -72,18 +72,14 @@
 #define LINK2RB_SIZE 10
 #define RB2LINK_SIZE 3
 #define MAP_MINSIZE 4
+#define ARRAY_MINSIZE 4
 #define MAP_TABLE 1
-#define MAXFREESET 256
-#define MAXFREEMAP MAXFREESET*2
-#define MAXFREETABLE MAXFREESET
-static GCPrefix *free_table[MAXFREETABLE];
-static int numfreeTable = 0;
-static NodeSet *free_set[MAXFREESET];
-static int numfreeSet = 0;
-static NodeMap *free_map[MAXFREEMAP];
-static int numfreeMap = 0;
+/* freed tables and hash nodes are recycled through the global caches */
+#define freemapnode(L,n)	luaM_cacheput(L, gcache(L, CACHE_MAP), n)
+#define freesetnode(L,n)	luaM_cacheput(L, gcache(L, CACHE_SET), n)
 static inline int value_equal(lua_State *L, const TValue *v1, const TValue *v2);
-static lua_Unsigned luaH_countn(Table *t);
+static int hashgset(lua_State *L, Table *t, const TValue *key,
+		lua_Integer hash, int insert, Node *res);
 int luaH_get_next(lua_State *L, Table *t, const TValue *key, NodeMap **res);
 /*
  ** Hash for floating-point numbers.
@@ -140,6 +136,23 @@ lua_Integer gethash(const TValue *key) {
 	}
 }
 
+/*
+ ** Buckets are picked by the low bits of a hash, and the raw hash of an
+ ** integer, float or pointer key is the key itself: strided integers or
+ ** aligned addresses would then pile up in a few chains. Such hashes go
+ ** through a seeded mix first (strings are hashed already): the product
+ ** by an odd constant carries every bit upwards, and the shifts around
+ ** it fold high bits into the low ones.
+ */
+static inline lua_Integer mixhash(lua_State *L, lua_Integer h) {
+	lua_Unsigned u = l_castS2U(h) ^ G(L)->seed;
+	u = (u ^ (u >> 32)) * 0x9e3779b97f4a7c15u;
+	return l_castU2S(u ^ (u >> 32));
+}
+
+/* hash that picks the bucket of 'key', given 'h = gethash(key)' */
+#define keyhash(L,key,h)	(ttisstring(key) ? (h) : mixhash(L, h))
+
 int luaH_next(lua_State *L, Table *t, StkId key) {
 	TValue *k = *key;
 	NodeMap *res;
@@ -151,7 +164,165 @@ int luaH_next(lua_State *L, Table *t, StkId key) {
 	return 0; /* no more elements */
 }
 
-static void setarrayvector(lua_State *L, Table *t, int nasize) {
+/*
+ ** {=============================================================
+ ** Traversal with a cursor
+ ** ==============================================================
+ */
+
+/*
+ ** A cursor remembers where the last key returned by a traversal lives,
+ ** so that the next step resumes there instead of looking the key up
+ ** again. 0 means "unknown position"; 'pos + 1' is a slot of the array
+ ** part; in the hash part it packs the bucket and the depth of the node
+ ** in the bucket's chain.
+ */
+#define CURSOR_HASHSHIFT	32
+#define cursorinhash(c)	((c) >> CURSOR_HASHSHIFT)
+#define hashcursor(b,d) \
+	((cast(lua_Integer, (b) + 1) << CURSOR_HASHSHIFT) | cast(lua_Integer, d))
+#define cursorbucket(c)	(cast(size_t, (c) >> CURSOR_HASHSHIFT) - 1)
+#define cursordepth(c)	cast(size_t, (c) & 0xffffffff)
+
+/*
+ ** first element at or after depth 'd' of bucket 'b'
+ */
+static int hashnext(lua_State *L, Table *t, size_t b, size_t d, StkId key,
+		lua_Integer *cursor) {
+	if (t->length == 0)
+		return 0;
+	for (; b < t->lsizenode; b++, d = 0) {
+		NodeMap *node = t->entry[b].node.map;
+		size_t i;
+		for (i = 0; node && i < d; i++)
+			node = node->next;
+		if (node) {
+			setobj2s(L, key, node->i_key);
+			setobj2s(L, key + 1, node->i_val);
+			*cursor = hashcursor(b, d);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/*
+ ** first element at or after slot 'pos' of the array part, continuing
+ ** into the hash part
+ */
+static int arraynext(lua_State *L, Table *t, size_t pos, StkId key,
+		lua_Integer *cursor) {
+	if (t->array_used) {
+		for (; pos < t->sizearray; pos++) {
+			if (t->array[pos]->tt) {
+				setobj2s(L, key, int_get(L, pos + 1));
+				setobj2s(L, key + 1, t->array[pos]);
+				*cursor = pos + 1;
+				return 1;
+			}
+		}
+	}
+	return hashnext(L, t, 0, 0, key, cursor);
+}
+
+/*
+ ** position of key 'k' (just returned by 'luaH_next') as a cursor
+ */
+static lua_Integer findcursor(lua_State *L, Table *t, const TValue *k) {
+	if (ttisinteger(k) && l_castS2U(ivalue(k)) - 1u < t->sizearray)
+		return ivalue(k);
+	if (t->length) {
+		size_t b = keyhash(L, k, gethash(k)) & t->nodemask, d = 0;
+		NodeMap *node = t->entry[b].node.map;
+		for (; node; node = node->next, d++) {
+			if (node->i_key == k)
+				return hashcursor(b, d);
+		}
+	}
+	return 0;
+}
+
+/*
+ ** Like 'luaH_next', but resumes from '*cursor' when it still matches
+ ** the key in 'key' (a key removed during the traversal leaves its
+ ** successor at its place in the chain). Otherwise the key is looked up
+ ** as 'next' does, and the cursor is resynchronized.
+ */
+int luaH_nextc(lua_State *L, Table *t, StkId key, lua_Integer *cursor) {
+	const TValue *k = *key;
+	lua_Integer c = *cursor;
+	if (ttisnil(k))
+		return arraynext(L, t, 0, key, cursor);
+	if (c != 0) {
+		if (!cursorinhash(c)) {
+			if (ttisinteger(k) && ivalue(k) == c)
+				return arraynext(L, t, c, key, cursor);
+		} else if (cursorbucket(c) < cast(size_t, t->lsizenode)) {
+			size_t b = cursorbucket(c), d = cursordepth(c), i = 0;
+			NodeMap *node = t->entry[b].node.map;
+			for (; node; node = node->next, i++) {
+				if (node->i_key == k)
+					return hashnext(L, t, b, i + 1, key, cursor);
+			}
+			if ((keyhash(L, k, gethash(k)) & t->nodemask) == b) /* 'k' was removed */
+				return hashnext(L, t, b, d, key, cursor);
+		}
+	}
+	if (luaH_next(L, t, key)) {
+		*cursor = findcursor(L, t, *key);
+		return 1;
+	}
+	return 0;
+}
+
+/* }============================================================= */
+
+/*
+ ** {=============================================================
+ ** Array part
+ ** ==============================================================
+ */
+
+/*
+ ** The array part doubles when a key lands right past its end while it
+ ** is at least half full; it only shrinks when less than 1/8 of it is in
+ ** use (checked when the hash part must grow). The gap between the two
+ ** thresholds keeps push/pop workloads from moving keys back and forth
+ ** between the parts. 'len_array' is the first border: slots 1..len are
+ ** all non-nil and t[len + 1] is nil.
+ */
+#define arraygrows(t,pos) \
+	((pos) == (t)->sizearray && (t)->sizearray < MAXASIZE / 2 \
+			&& (t)->array_used >= (t)->sizearray >> 1)
+#define growarray(L,t) \
+	setarrayvector(L, t, (t)->sizearray ? (t)->sizearray << 1 : ARRAY_MINSIZE)
+
+/*
+ ** move the integer keys in (oldasize, nasize] from the hash part into
+ ** the (already enlarged) array part with a single pass over the buckets
+ */
+static void hash2array(lua_State *L, Table *t, unsigned int oldasize,
+		unsigned int nasize) {
+	lua_Integer b;
+	for (b = 0; b < t->lsizenode && t->length; b++) {
+		NodeMap **prev = &t->entry[b].node.map, *node;
+		while ((node = *prev) != NULL) {
+			TValue *k = node->i_key;
+			if (ttisinteger(k)
+					&& l_castS2U(ivalue(k)) - 1u - oldasize < nasize - oldasize) {
+				t->array[ivalue(k) - 1] = node->i_val;
+				t->array_used++;
+				t->length--;
+				*prev = node->next;
+				refDec(L, k);
+				freemapnode(L, node);
+			} else
+				prev = &node->next;
+		}
+	}
+}
+
+static void setarrayvector(lua_State *L, Table *t, unsigned int nasize) {
 	unsigned int i;
 	Node res;
 	NodeMap map;
@@ -159,22 +330,29 @@ static void setarrayvector(lua_State *L, Table *t, int nasize) {
 	TValue ikey = { { (void*) 0 }, LUA_TNUMINT };
 	if (nasize > oldasize) { /* array part must grow? */
 		luaM_reallocvector(L, t->array, oldasize, nasize, TValue*);
-		unsigned int len_array = t->len_array;
-		for (i = oldasize + 1; i <= nasize; i++) {
-			if (t->length && (ikey.value_.i = i, luaH_del(L, t, &ikey, &map))) {
-				refDec(L, map.i_key);
-				t->array[i - 1] = map.i_val;
-				t->array_used++;
-			} else {
-				t->array[i - 1] = luaO_nilobject;
-			}
+		for (i = oldasize; i < nasize; i++)
+			t->array[i] = luaO_nilobject;
+		if (t->length) {
+#ifndef USE_RBTREE
+			if (cast(lua_Integer, nasize - oldasize) > t->lsizenode + t->length)
+				hash2array(L, t, oldasize, nasize);
+			else
+#endif
+				for (i = oldasize + 1; i <= nasize && t->length; i++) {
+					if ((ikey.value_.i = i, luaH_del(L, t, &ikey, &map))) {
+						refDec(L, map.i_key);
+						t->array[i - 1] = map.i_val;
+						t->array_used++;
+					}
+				}
 		}
-		t->len_array = len_array;
-		t->sizearray = nasize;
+		t->sizearray = nasize; /* 'luaH_del' above still saw the old size */
+		while (t->len_array < nasize && t->array[t->len_array]->tt)
+			t->len_array++;
 	}
 	/* create new hash part with appropriate size */
 	else if (nasize < oldasize) { /* array part must shrink? */
-		assert(nasize > 0);
+		lua_assert(nasize > t->len_array);
 		t->sizearray = nasize;
 		/* re-insert elements from vanishing slice */
 		for (i = nasize + 1; i <= oldasize; i++) {
@@ -182,19 +360,49 @@ static void setarrayvector(lua_State *L, Table *t, int nasize) {
 			if (v->tt) {
 				t->array_used--;
 				TValue *key = int_get(L, i);
-				lua_assert(luaH_gset(L, t, key, i, 1, &res) == 0);
+				hashgset(L, t, key, i, 1, &res);
 				res.map->i_val = v;
 			}
-			/* shrink array */
-			luaM_reallocvector(L, t->array, oldasize, nasize, TValue*);
 		}
+		/* shrink array */
+		luaM_reallocvector(L, t->array, oldasize, nasize, TValue*);
 	}
 }
+
+/*
+ ** the border has just been raised by one: move it past the run of
+ ** non-nil slots that follows. The key right after the array part may
+ ** still be in the hash part, in which case the array grows to take it.
+ */
+static void raiseborder(lua_State *L, Table *t) {
+	while (t->len_array < t->sizearray && t->array[t->len_array]->tt)
+		t->len_array++;
+	while (t->len_array == t->sizearray && t->length
+			&& t->sizearray < MAXASIZE / 2
+			&& !ttisnil(luaH_getint(L, t, cast(lua_Integer, t->sizearray) + 1)))
+		setarrayvector(L, t, t->sizearray << 1); /* also walks the border */
+}
+
+/*
+ ** shrink a sparse array part to the smallest power of 2 that keeps it at
+ ** most a quarter full and still holds the border
+ */
+static void shrinkarray(lua_State *L, Table *t) {
+	unsigned int n = ARRAY_MINSIZE;
+	while (n <= t->len_array || n < t->array_used << 2)
+		n <<= 1;
+	if (n < t->sizearray)
+		setarrayvector(L, t, n);
+}
+
+/* }============================================================= */
+
 int luaH_del(lua_State *L, Table *t, const TValue *key, NodeMap *res) {
 	lua_Integer hash;
 	size_t pos;
 	NodeMap *node, *prev;
 	lua_assert(t->type);
+	invalidateTMkey(t, key);
 	if (key->tt == LUA_TNUMINT && (hash = key->value_.i) > 0) {
 		if (hash <= t->len_array) {
 			t->len_array = hash - 1;
@@ -211,9 +419,6 @@ int luaH_del(lua_State *L, Table *t, const TValue *key, NodeMap *res) {
 					refDec(L, v);
 				t->array[pos] = luaO_nilobject;
 				t->array_used--;
-				if (t->array_used < sizearray >> 2) {
-					setarrayvector(L, t, sizearray >> 1);
-				}
 				return 1;
 			} else
 				return 0;
@@ -221,6 +426,7 @@ int luaH_del(lua_State *L, Table *t, const TValue *key, NodeMap *res) {
 	}
 	if (t->length == 0 || key->tt == LUA_TNIL)
 		return 0;
+	hash = keyhash(L, key, gethash(key));
 	pos = hash & t->nodemask;
 	Entry *entry = t->entry + pos;
 #if USE_RBTREE
@@ -253,13 +459,7 @@ int luaH_del(lua_State *L, Table *t, const TValue *key, NodeMap *res) {
 			RB.delNode(tree, rnode);
 			entry->len--;
 			t->length--;
-			if (numfreeMap < MAXFREEMAP)
-				free_map[numfreeMap++] = node;
-			else
-				luaM_realloc_(L, node, sizeof(NodeMap), 0);
-			if (t->length <= t->lsizenode >> 3) {
-				luaH_resize_(L, t, t->length);
-			}
+			freemapnode(L, node);
 			return 1;
 		} else
 			return 0;
@@ -300,13 +500,7 @@ int luaH_del(lua_State *L, Table *t, const TValue *key, NodeMap *res) {
 					refDec(L, node->i_key);
 					refDec(L, node->i_val);
 				}
-				if (numfreeMap < MAXFREEMAP)
-					free_map[numfreeMap++] = node;
-				else
-					luaM_realloc_(L, node, sizeof(NodeMap), 0);
-				if (t->length <= t->lsizenode >> 3) {
-					luaH_resize_(L, t, t->length);
-				}
+				freemapnode(L, node);
 				return 1;
 			}
 		}
@@ -379,10 +573,7 @@ int luaH_del_set(lua_State *L, Table *t, const TValue *key, lua_Integer hash) {
 			}
 #endif
 			refDec(L, node->i_key);
-			if (numfreeSet < MAXFREESET)
-				free_set[numfreeSet++] = (NodeSet*) node;
-			else
-				luaM_realloc_(L, node, sizeof(NodeSet), 0);
+			freesetnode(L, node);
 			if (t->length < t->lsizenode >> 3) {
 				luaH_resize_(L, t, t->lsizenode >> 1);
 			}
@@ -443,8 +634,13 @@ void luaH_resize_(lua_State *L, Table *t, lua_Integer size) {
 			luaM_freearray(L, oldt, oldsize);
 	}
 }
+/*
+ ** explicit sizing; it drops the pin that 'luaH_clear' leaves ('table.new'
+ ** and 'table.reserve' set it again after calling this)
+ */
 void luaH_resize(lua_State *L, Table *t, unsigned int nasize,
 		unsigned int nhsize) {
+	t->keepsize = 0;
 	if (nasize != t->sizearray)
 		setarrayvector(L, t, nasize);
 	if (nhsize != t->lsizenode)
@@ -461,8 +657,8 @@ void luaH_resizearray(lua_State *L, Table *t, unsigned int nasize) {
 
 Table *luaH_new(lua_State *L) {
 	Table *t;
-	if (numfreeTable) {
-		GCPrefix *bp = free_table[--numfreeTable];
+	GCPrefix *bp = cast(GCPrefix*, luaM_cacheget(L, gcache(L, CACHE_TABLE)));
+	if (bp) {
 		t = cast(Table*, bp + 1);
 		box_append(L, bp);
 		t->collectable = 1;
@@ -478,12 +674,15 @@ Table *luaH_new(lua_State *L) {
 	t->len_array = 0;
 	t->array = NULL;
 	t->array_used = 0;
+	t->keepsize = 0;
+	t->flags = 0;
+	t->tmcache = NULL;
 	return t;
 }
 Table *luaH_create(lua_State *L, int isTable, int defsize) {
 	Table *t;
-	if (numfreeTable) {
-		GCPrefix *bp = free_table[--numfreeTable];
+	GCPrefix *bp = cast(GCPrefix*, luaM_cacheget(L, gcache(L, CACHE_TABLE)));
+	if (bp) {
 		t = cast(Table*, bp + 1);
 		box_append(L, bp);
 	} else {
@@ -497,6 +696,9 @@ Table *luaH_create(lua_State *L, int isTable, int defsize) {
 	t->lsizenode = 0;
 	t->len_array = 0;
 	t->array_used = 0;
+	t->keepsize = 0;
+	t->flags = 0;
+	t->tmcache = NULL;
 	if (defsize)
 		luaH_resize_(L, t, defsize);
 	return t;
@@ -514,11 +716,11 @@ TValue *luaH_newkey(lua_State *L, Table *t, const TValue *key) {
 /*
  ** search function for integers
  */
-const TValue *luaH_getint(Table *t, lua_Integer key) {
+const TValue *luaH_getint(lua_State *L, Table *t, lua_Integer key) {
 	static TValue v = { { NULL }, LUA_TNUMINT };
 	v.value_.i = key;
 	Node res;
-	if (luaH_gset(NULL, t, &v, key, 0, &res)) {
+	if (luaH_gset(L, t, &v, key, 0, &res)) {
 		return res.map->i_val;
 	}
 	return luaO_nilobject;
@@ -528,12 +730,12 @@ const TValue *luaH_getint(Table *t, lua_Integer key) {
  ** search function for short strings
  */
 const TValue *luaH_getshortstr(Table *t, TString *key) {
-	return luaH_getstr(t, key);
+	return luaH_getstr(NULL, t, key); /* strings are not mixed: no state */
 }
 
-const TValue *luaH_getstr(Table *t, TString *key) {
+const TValue *luaH_getstr(lua_State *L, Table *t, TString *key) {
 	Node res;
-	if (luaH_gset(NULL, t, (TValue*) key, key->hash, 0, &res)) {
+	if (luaH_gset(L, t, (TValue*) key, key->hash, 0, &res)) {
 		return res.map->i_val;
 	}
 	return luaO_nilobject;
@@ -541,7 +743,14 @@ const TValue *luaH_getstr(Table *t, TString *key) {
 int luaH_setifexist(lua_State *L, Table *t, TValue *key, TValue *val) {
 	Node res;
 	if (val->tt) {
+		if (ttisinteger(key) && t->metatable == NULL
+				&& l_castS2U(ivalue(key)) - 1u == t->len_array) {
+			/* 't[#t + 1] = v' on a plain table: append right away */
+			luaH_setint(L, t, ivalue(key), val);
+			return 1;
+		}
 		if (luaH_gset(L, t, key, gethash(key), 0, &res)) {
+			invalidateTMkey(t, key);
 			refDec(L, res.map->i_val);
 			refInc(val);
 			res.map->i_val = val;
@@ -633,10 +842,14 @@ static inline int value_equal(lua_State *L, const TValue *v1, const TValue *v2)
 		return v1->value_.i == v2->value_.i;
 	}
 	if (tm) {
+		TValue *o;
+		int res;
 		luaT_callTM(L, tm, v1, v2, L->top, 1);
-		if (!l_isfalse(*L->top)) {
-			return 1;
-		}
+		o = *L->top;
+		*L->top = NULL;
+		res = !l_isfalse(o);
+		refDec(L, o);
+		return res;
 	}
 	return 0;
 }
@@ -649,28 +862,32 @@ int luaH_gset(lua_State *L, Table *t, const TValue *key, lua_Integer hash,
 	}
 	if (key->tt == LUA_TNUMINT && hash > 0) {
 		size_t pos = hash - 1;
-		if (insert) {
-//			unsigned int len_array ;
-			if (pos == t->len_array) {
-				t->len_array++;
-				luaH_countn(t);
-			}
-			if (t->len_array > t->sizearray) {
-				setarrayvector(L, t, t->len_array * 1.6 + 4);
-			} else if (t->array_used > t->sizearray * 0.8) {
-				setarrayvector(L, t, t->array_used << 1);
-			}
-		}
+		if (insert && arraygrows(t, pos))
+			growarray(L, t);
 		if (pos < t->sizearray) {
-			res->map = cast(NodeMap*,
-					cast(char*,&t->array[pos])-offsetof(NodeMap,i_val));
 			if (t->array[pos]->tt == LUA_TNIL && insert) {
 				t->array_used++;
+				if (pos == t->len_array) {
+					t->len_array++;
+					raiseborder(L, t); /* may reallocate the array */
+				}
+				res->map = cast(NodeMap*,
+						cast(char*,&t->array[pos])-offsetof(NodeMap,i_val));
 				return 0;
 			}
+			res->map = cast(NodeMap*,
+					cast(char*,&t->array[pos])-offsetof(NodeMap,i_val));
 			return t->array[pos]->tt;
 		}
 	}
+	return hashgset(L, t, key, hash, insert, res);
+}
+
+/*
+ ** 'luaH_gset' restricted to the hash part
+ */
+static int hashgset(lua_State *L, Table *t, const TValue *key,
+		lua_Integer hash, int insert, Node *res) {
 	if (insert) {
 		if (t->lsizenode == 0)
 			luaH_resize_(L, t, MAP_MINSIZE);
@@ -685,14 +902,23 @@ int luaH_gset(lua_State *L, Table *t, const TValue *key, lua_Integer hash,
 			}
 #else
 			if (t->length > t->lsizenode) {
-				lua_Integer i = t->lsizenode << 1;
-				assert(i > 0);
-				luaH_resize_(L, t, i);
+				if (t->array_used < t->sizearray >> 3 && !t->keepsize)
+					shrinkarray(L, t); /* its keys may fill the hash part */
+				if (t->length > t->lsizenode) {
+					lua_Integer i = t->lsizenode << 1;
+					assert(i > 0);
+					luaH_resize_(L, t, i);
+				}
+			} else if (t->length < t->lsizenode >> 3 && !t->keepsize) {
+				/* shrink here rather than in 'luaH_del', so that clearing
+				 * fields never moves the others during a traversal */
+				luaH_resize_(L, t, t->length << 1);
 			}
 #endif
 		}
 	} else if (t->length == 0)
 		return 0;
+	hash = keyhash(L, key, hash); /* also what 'node->hash' keeps */
 	NodeMap *node;
 #ifdef USE_RBTREE
 	NodeMap *prev;
@@ -759,8 +985,14 @@ int luaH_gset(lua_State *L, Table *t, const TValue *key, lua_Integer hash,
 						break;
 					}
 					if (tm) {
+						TValue *o;
+						int eq;
 						luaT_callTM(L, tm, key, node->i_key, L->top, 1);
-						if (!l_isfalse(*L->top)) {
+						o = *L->top;
+						*L->top = NULL;
+						eq = !l_isfalse(o);
+						refDec(L, o);
+						if (eq) {
 							res->map = node;
 							return 1;
 						}
@@ -772,9 +1004,8 @@ int luaH_gset(lua_State *L, Table *t, const TValue *key, lua_Integer hash,
 	}
 	if (insert) {
 		++t->length;
-		if (numfreeMap)
-			node = free_map[--numfreeMap];
-		else
+		node = cast(NodeMap*, luaM_cacheget(L, gcache(L, CACHE_MAP)));
+		if (node == NULL)
 			node = (NodeMap*) luaM_realloc_(L, NULL, 0, sizeof(NodeMap));
 		node->hash = hash;
 		node->next = entry->node.map;
@@ -806,21 +1037,24 @@ int luaH_get_next(lua_State *L, Table *t, const TValue *key, NodeMap **res) {
 	size_t hash = gethash(key);
 	int isfind = 0;
 	size_t pos;
-	if ((key->tt == LUA_TNUMINT || key->tt == LUA_TNIL) && t->array_used) {
+	/* a nil key starts the traversal; an integer key inside the array part
+	 * continues it there; anything else is searched in the hash part */
+	if (key->tt == LUA_TNIL
+			|| (key->tt == LUA_TNUMINT && hash - 1 < t->sizearray)) {
 		if (key->tt) {
 			pos = hash - 1;
 		} else
 			pos = -1;
-		while (++pos < t->sizearray) {
-			if (t->array[pos]->tt) {
-				map->i_key = int_get(L, pos + 1);
-				map->i_val = t->array[pos];
-				*res = map;
-				return 2;
+		if (t->array_used)
+			while (++pos < t->sizearray) {
+				if (t->array[pos]->tt) {
+					map->i_key = int_get(L, pos + 1);
+					map->i_val = t->array[pos];
+					*res = map;
+					return 2;
+				}
 			}
-		}
 		isfind = 1;
-		hash = 0;
 	}
 	if (t->length == 0)
 		return 0;
@@ -828,7 +1062,7 @@ int luaH_get_next(lua_State *L, Table *t, const TValue *key, NodeMap **res) {
 #ifdef USE_RBTREE
 	RBNode *rnode;
 #endif
-	pos = t->nodemask & hash;
+	pos = isfind ? 0 : t->nodemask & keyhash(L, key, hash);
 	for (int i = pos; i < t->lsizenode; i++) {
 		Entry *entry = t->entry + i;
 #ifdef USE_RBTREE
@@ -902,9 +1136,8 @@ TValue *luaH_gset_int(lua_State *L, Table *t, lua_Integer key) {
 		}
 	}
 	++t->length;
-	if (numfreeSet)
-		node = free_set[--numfreeSet];
-	else
+	node = cast(NodeSet*, luaM_cacheget(L, gcache(L, CACHE_SET)));
+	if (node == NULL)
 		node = luaM_realloc_(L, NULL, 0, sizeof(NodeSet));
 	node->hash = hash;
 	node->next = entry->node.set;
@@ -965,31 +1198,74 @@ void luaH_free(lua_State *L, Table *t) {
 				next = node->next;
 				refDec(L, node->i_key);
 				refDec(L, node->i_val);
-				if (numfreeMap < MAXFREEMAP) {
-					free_map[numfreeMap++] = node;
-				} else
-					luaM_realloc_(L, node, sizeof(NodeMap), 0);
+				freemapnode(L, node);
 				node = next;
 			}
 		}
 	}
 	if (size)
 		luaM_realloc_(L, t->entry, t->lsizenode * sizeof(Entry), 0);
+	if (t->tmcache != NULL) {
+		luaM_free(L, t->tmcache);
+		t->tmcache = NULL;
+	}
+	t->flags = 0;
 	gp->nref--;
 	if (gp->nref > 0) {
 		t->lsizenode = 0;
 		t->sizearray = 0;
+		t->len_array = t->array_used = 0;
+		t->keepsize = 0;
 		t->metatable = 0;
 		t->length = 0;
 	} else {
 		box_remove(L, gp);
-		if (numfreeTable < MAXFREETABLE) {
-			free_table[numfreeTable++] = gp;
-		} else {
-			luaM_realloc_(L, gp, sizeof(Table), 0);
+		luaM_cacheput(L, gcache(L, CACHE_TABLE), gp);
+	}
+}
+/*
+ ** remove every entry of 't' but keep its array and bucket vectors, so
+ ** that refilling it does not allocate; hash nodes go to the free list.
+ ** The vectors stay pinned ('keepsize') until the next 'luaH_resize', as
+ ** a table cleared for reuse is refilled to about the same size.
+ */
+void luaH_clear(lua_State *L, Table *t) {
+	register lua_Integer i, size = t->sizearray;
+	TValue **array = t->array;
+	lua_assert(t->type);
+	for (i = 0; i < size; i++) {
+		TValue *v = array[i];
+		array[i] = cast(TValue*, luaO_nilobject);
+		refDec(L, v);
+	}
+	t->len_array = t->array_used = 0;
+	invalidateTMcache(t);
+	size = t->lsizenode;
+	if (t->length) {
+		NodeMap *node, *next;
+		Entry *entry;
+		t->length = 0;
+		for (i = 0; i < size; i++) {
+			entry = &t->entry[i];
+#ifdef USE_RBTREE
+			if (entry->tree)
+				RB.destroy(L, &entry->tree, NULL);
+			entry->len = 0;
+#endif
+			node = entry->node.map;
+			entry->node.map = NULL;
+			while (node) {
+				next = node->next;
+				refDec(L, node->i_key);
+				refDec(L, node->i_val);
+				freemapnode(L, node);
+				node = next;
+			}
 		}
 	}
+	t->keepsize = 1;
 }
+
 void luaH_free_set(lua_State *L, Table *t) {
 	register lua_Integer size = t->lsizenode, i;
 	if (t->length) {
@@ -1018,9 +1294,9 @@ void luaH_free_set(lua_State *L, Table *t) {
 /*
  ** main search function
  */
-TValue *luaH_get(Table *t, const TValue *key) {
+TValue *luaH_get(lua_State *L, Table *t, const TValue *key) {
 	Node res;
-	if (luaH_gset(NULL, t, (TValue*) key, gethash(key), 0, &res)) {
+	if (luaH_gset(L, t, (TValue*) key, gethash(key), 0, &res)) {
 		return res.map->i_val;
 	} else
 		return luaO_nilobject;
@@ -1045,6 +1321,8 @@ void luaH_setint(lua_State *L, Table *t, lua_Integer key, TValue *value) {
 	if (value->tt) {
 		refInc(value);
 		size_t pos = l_castS2U(key) - 1;
+		if (arraygrows(t, pos)) /* before the key is boxed for the hash part */
+			growarray(L, t);
 		if (pos < t->sizearray) {
 			if (t->array[pos]->tt) {
 				refDec(L, t->array[pos]);
@@ -1052,24 +1330,31 @@ void luaH_setint(lua_State *L, Table *t, lua_Integer key, TValue *value) {
 				t->array_used++;
 			}
 			t->array[pos] = value;
-			if (pos == t->len_array)
+			if (pos == t->len_array) {
 				t->len_array++;
+				raiseborder(L, t);
+			}
 			return;
 		}
 		Node res;
 		TValue *k = (TValue*) int_get(L, key);
+		refInc(k); /* a new box is freed below unless a new node keeps it */
 		if (luaH_gset(L, t, k, key, 1, &res)) {
 			refDec(L, res.map->i_val);
 		}
 		res.map->i_val = value;
+		refDec(L, k);
 	} else {
 		TValue *k = (TValue*) int_get(L, key);
+		refInc(k);
 		luaH_del(L, t, k, NULL);
+		refDec(L, k);
 	}
 }
 void luaH_setdel(lua_State *L, Table *t, TValue *key, TValue *value) {
 	if (value->tt) {
 		Node res;
+		invalidateTMkey(t, key);
 		if (luaH_gset(L, t, key, gethash(key), 1, &res)) {
 			refDec(L, res.map->i_val);
 		}
@@ -1079,22 +1364,6 @@ void luaH_setdel(lua_State *L, Table *t, TValue *key, TValue *value) {
 		luaH_del(L, t, key, NULL);
 	}
 }
-void table_clear_cache() {
-	register int i;
-	for (i = 0; i < numfreeMap; i++) {
-		luaM_realloc_(_S, free_map[i], sizeof(NodeMap), 0);
-	}
-	numfreeMap = 0;
-	for (i = 0; i < numfreeSet; i++) {
-		luaM_realloc_(_S, free_set[i], sizeof(NodeMap), 0);
-	}
-	numfreeSet = 0;
-	for (i = 0; i < numfreeTable; i++) {
-		luaM_realloc_(_S, free_table[i], sizeof(Table) + sizeof(GCPrefix), 0);
-	}
-	numfreeTable = 0;
-}
-
 /*
  ** Try to find a boundary in table 't'. A 'boundary' is an integer index
  ** such that t[i] is non-nil and t[i+1] is nil (and 0 if t[1] is nil).
@@ -1102,12 +1371,4 @@ void table_clear_cache() {
 lua_Unsigned luaH_getn(Table *t) {
 	return t->len_array;
 }
-static lua_Unsigned luaH_countn(Table *t) {
-	register lua_Integer i = t->len_array + 1;
-	while (luaH_getint(t, i)->tt) {
-		i++;
-	}
-	t->len_array = i - 1;
-	return t->len_array;
-}
 
@@ -21,6 +21,7 @@
 #include "lobject.h"
 #include "lstate.h"
 #include "lapi.h"
+#include "ltable.h"
 /*
  ** Operations that an object must define to mimic a table
  ** (some functions only need some of them)
@@ -399,12 +400,66 @@ static int sort(lua_State *L) {
 
 /* }====================================================== */
 
+/*
+ ** {======================================================
+ ** Capacity management
+ ** =======================================================
+ */
+
+/*
+ ** table.new(narray [, nhash]): a table presized for 'narray' sequence
+ ** elements and 'nhash' other keys; its parts never shrink back
+ */
+static int tnew(lua_State *L) {
+	lua_Integer na = luaL_optinteger(L, 1, 0);
+	lua_Integer nh = luaL_optinteger(L, 2, 0);
+	luaL_argcheck(L, 0 <= na && na <= INT_MAX, 1, "size out of range");
+	luaL_argcheck(L, 0 <= nh && nh <= INT_MAX, 2, "size out of range");
+	lua_createtable(L, (int) na, (int) nh);
+	hvalue(index2addr(L, -1))->keepsize = 1;
+	return 1;
+}
+
+/*
+ ** table.clear(t): remove all entries but keep the memory of both parts
+ */
+static int tclear(lua_State *L) {
+	luaL_checktype(L, 1, LUA_TTABLE);
+	luaH_clear(L, hvalue(index2addr(L, 1)));
+	return 0;
+}
+
+/*
+ ** table.reserve(t, narray [, nhash]): grow the parts of 't' to hold at
+ ** least 'narray' sequence elements and 'nhash' other keys; returns 't'
+ */
+static int treserve(lua_State *L) {
+	Table *t;
+	lua_Integer na = luaL_checkinteger(L, 2);
+	lua_Integer nh = luaL_optinteger(L, 3, 0);
+	luaL_checktype(L, 1, LUA_TTABLE);
+	luaL_argcheck(L, 0 <= na && na <= INT_MAX, 2, "size out of range");
+	luaL_argcheck(L, 0 <= nh && nh <= INT_MAX, 3, "size out of range");
+	t = hvalue(index2addr(L, 1));
+	if (na < t->sizearray)
+		na = t->sizearray;
+	if (nh < t->lsizenode)
+		nh = t->lsizenode;
+	luaH_resize(L, t, (unsigned int) na, (unsigned int) nh);
+	t->keepsize = 1;
+	lua_settop(L, 1);
+	return 1;
+}
+
+/* }====================================================== */
+
 static const luaL_Reg tab_funcs[] = { { "concat", tconcat },
 #if defined(LUA_COMPAT_MAXN)
   {"maxn", maxn},
 #endif
 		{ "insert", tinsert }, { "pack", pack }, { "unpack", unpack }, { "remove",
-				tremove }, { "move", tmove }, { "sort", sort }, { NULL, NULL } };
+				tremove }, { "move", tmove }, { "sort", sort }, { "new", tnew }, {
+				"clear", tclear }, { "reserve", treserve }, { NULL, NULL } };
 
 LUAMOD_API int luaopen_table(lua_State *L) {
 	luaL_newlib(L, tab_funcs);
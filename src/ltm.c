@@ -15,6 +15,7 @@
 
 #include "ldebug.h"
 #include "ldo.h"
+#include "lmem.h"
 #include "lobject.h"
 #include "lstate.h"
 #include "lstring.h"
@@ -56,8 +57,31 @@ const TValue *luaT_gettm(Table *events, TMS event, TString *ename) {
 		return tm;
 }
 
+/*
+ ** function to be used with macro "fasttm": looks the event up and keeps
+ ** the result, present or not, in the cache of the metatable
+ */
+const TValue *luaT_gettmcached(lua_State *L, Table *events, TMS event) {
+	const TValue *tm;
+	if (events->tmcache == NULL) { /* allocated before the lookup */
+		TMCache *c = luaM_new(L, TMCache);
+		c->known = 0;
+		events->tmcache = c;
+	}
+	tm = luaH_getshortstr(events, G(L)->tmname[event]);
+	if (ttisnil(tm)) {
+		if (event <= TM_EQ)
+			events->flags |= cast_byte(1u << event);
+		tm = NULL;
+	}
+	events->tmcache->known |= 1u << event;
+	events->tmcache->tm[event] = tm;
+	return tm;
+}
+
 const TValue *luaT_gettmbyobj(lua_State *L, const TValue *o, TMS event) {
 	Table *mt;
+	const TValue *tm;
 	switch (ttnov(o)) {
 	case LUA_TTABLE:
 		mt = hvalue(o)->metatable;
@@ -68,7 +92,8 @@ const TValue *luaT_gettmbyobj(lua_State *L, const TValue *o, TMS event) {
 	default:
 		mt = G(L)->mt[ttnov(o)];
 	}
-	return (mt ? luaH_getshortstr(mt, G(L)->tmname[event]) : luaO_nilobject);
+	tm = fasttm(L, mt, event);
+	return (tm != NULL ? tm : luaO_nilobject);
 }
 
 /*
@@ -90,12 +115,13 @@ void luaT_callTM(lua_State *L, const TValue *f, const TValue *p1,
 		const TValue *p2, StkId p3, int hasres) {
 	ptrdiff_t result = savestack(L, p3);
 	StkId func = L->top;
-	stack_push(L, f); /* push function (assume EXTRA_STACK) */
-	stack_push(L, p1); /* 1st argument */
-	stack_push(L, p2); /* 2nd argument */
-//	L->top += 3;
+	/* the frame of a Lua function is full up to 'ci->top', so these go
+	 * to EXTRA_STACK without the check of 'stack_push' */
+	setobj2s(L, L->top++, f); /* push function */
+	setobj2s(L, L->top++, p1); /* 1st argument */
+	setobj2s(L, L->top++, p2); /* 2nd argument */
 	if (!hasres) /* no result? 'p3' is third argument */
-		stack_push(L, *p3); /* 3rd argument */
+		setobj2s(L, L->top++, *p3); /* 3rd argument */
 	/* metamethod may yield only when called from Lua code */
 	if (isLua(L->ci))
 		luaD_call(L, func, hasres);
@@ -103,7 +129,8 @@ void luaT_callTM(lua_State *L, const TValue *f, const TValue *p1,
 		luaD_callnoyield(L, func, hasres);
 	if (hasres) { /* if has result, move it to its place */
 		p3 = restorestack(L, result);
-		moveobj(L, p3, --L->top);
+		if (p3 != --L->top) /* callers passing 'L->top' take it from there */
+			moveobj(L, p3, L->top);
 	}
 }
 
@@ -146,9 +173,14 @@ void luaT_trybinTM(lua_State *L, const TValue *p1, const TValue *p2, StkId res,
 
 int luaT_callorderTM(lua_State *L, const TValue *p1, const TValue *p2,
 		TMS event) {
+	TValue *o;
+	int res;
 	if (!luaT_callbinTM(L, p1, p2, L->top, event))
 		return -1; /* no metamethod */
-	else
-		return !l_isfalse(*L->top);
+	o = *L->top; /* result was left just above the top */
+	*L->top = NULL;
+	res = !l_isfalse(o);
+	refDec(L, o);
+	return res;
 }
 
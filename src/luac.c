@@ -338,7 +338,7 @@ static void PrintCode(const Proto* f) {
 			printf("%d", MYK(ax));
 			break;
 		}
-		switch (o) {
+		switch (plainop(o)) {
 		case OP_LOADK:
 			printf("\t; ");
 			PrintConstant(f, bx);
@@ -13,6 +13,7 @@
 #include "lua.h"
 
 #include "lapi.h"
+#include "lcode.h"
 #include "ldebug.h"
 #include "ldo.h"
 #include "lfunc.h"
@@ -92,11 +93,20 @@ static TString *LoadString(LoadState *S) {
 	}
 }
 
+/* a string kept by the prototype, which releases it when it is freed */
+static TString *LoadName(LoadState *S) {
+	TString *ts = LoadString(S);
+	if (ts != NULL)
+		refInc(ts);
+	return ts;
+}
+
 static void LoadCode(LoadState *S, Proto *f) {
 	int n = LoadInt(S);
 	f->code = luaM_newvector(S->L, n, Instruction);
 	f->ncode = n;
 	LoadVector(S, f->code, n);
+	luaK_fuse(f); /* dumps carry plain opcodes */
 }
 
 static void LoadFunction(LoadState *S, Proto *f, TString *psource);
@@ -104,8 +114,15 @@ static void LoadFunction(LoadState *S, Proto *f, TString *psource);
 static void LoadConstants(LoadState *S, Proto *f) {
 	int i;
 	int n = LoadInt(S);
+	Module *module;
 	f->k = luaM_newvector(S->L, n, TValue*);
 	f->sizek = n;
+	/* the constants belong to a module, as for a parsed chunk */
+	module = (Module*) luaC_newobjNotGC(S->L, LUA_TMODULE, sizeof(Module));
+	module->k = f->k;
+	module->nconst = 0;
+	f->module = module;
+	refInc(module);
 	for (i = 0; i < n; i++) {
 		StkId o = f->k + i;
 		int t = LoadByte(S);
@@ -132,6 +149,7 @@ static void LoadConstants(LoadState *S, Proto *f) {
 			lua_assert(0);
 		}
 		refInc(*o);
+		module->nconst++;
 	}
 }
 
@@ -173,19 +191,21 @@ static void LoadDebug(LoadState *S, Proto *f) {
 	for (i = 0; i < n; i++)
 		f->locvars[i].name = NULL;
 	for (i = 0; i < n; i++) {
-		f->locvars[i].name = LoadString(S);
+		f->locvars[i].name = LoadName(S);
 		f->locvars[i].startpc = LoadInt(S);
 		f->locvars[i].endpc = LoadInt(S);
 	}
 	n = LoadInt(S);
 	for (i = 0; i < n; i++)
-		f->upvalues[i].name = LoadString(S);
+		f->upvalues[i].name = LoadName(S);
 }
 
 static void LoadFunction(LoadState *S, Proto *f, TString *psource) {
 	f->source = LoadString(S);
 	if (f->source == NULL) /* no source in dump? */
 		f->source = psource; /* reuse parent's source */
+	if (f->source != NULL)
+		refInc(f->source);
 	f->linedefined = LoadInt(S);
 	f->lastlinedefined = LoadInt(S);
 	f->numparams = LoadByte(S);
@@ -20,6 +20,18 @@
 #include "lauxlib.h"
 #include "lualib.h"
 
+
+/*
+** whole blocks of a string are checked with SSE2 (runs of ASCII) or AVX2
+** (full validation, when the CPU has it); define LUA_NOSTRSIMD to use
+** only 'utf8_decode'
+*/
+#if !defined(LUA_NOSTRSIMD) && defined(__GNUC__) && defined(__SSE2__)
+#define UTF8SIMD
+#include <immintrin.h>
+#endif
+
+
 #define MAXUNICODE	0x10FFFF
 
 #define iscont(p)	((*(p) & 0xC0) == 0x80)
@@ -63,13 +75,204 @@ static const char *utf8_decode (const char *o, int *val) {
 }
 
 
+/*
+** {======================================================
+** BLOCK SCANNING
+** =======================================================
+*/
+
+/*
+** A scan kernel checks whole blocks at the start of 's' (length 'len'),
+** adding to '*n' the number of characters that start in them, and
+** returns how many bytes it accepted. It stops before a block it cannot
+** vouch for and before the last partial block; a character may run
+** past the accepted bytes, so 'utf8_count' resumes decoding at the
+** start of the last accepted character.
+*/
+typedef size_t (*ScanKernel) (const char *s, size_t len, lua_Integer *n);
+
+/* smallest range worth handing to the scan kernel */
+#define SCANMIN		64
+
+
+static size_t scan_none (const char *s, size_t len, lua_Integer *n) {
+  (void)s; (void)len; (void)n;
+  return 0;
+}
+
+
+#if defined(UTF8SIMD)
+
+/* SSE2: accept runs of ASCII blocks */
+static size_t scan_sse2 (const char *s, size_t len, lua_Integer *n) {
+  size_t i;
+  for (i = 0; i + 16 <= len; i += 16) {
+    if (_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)(s + i))) != 0)
+      break;
+  }
+  *n += i;
+  return i;
+}
+
+
+/*
+** AVX2: range checks with nibble lookups (Keiser and Lemire, "Validating
+** UTF-8 in less than one instruction per byte"). Each table maps a
+** nibble of a byte or of its predecessor to the set of errors that
+** nibble allows; a pair of bytes is wrong when all three tables agree
+** on some error. Lua 5.3 decodes surrogates, so unlike the paper there
+** is no surrogate error.
+*/
+#define U8SHORT		0x01  /* lead not followed by a continuation */
+#define U8LONG		0x02  /* continuation after an ASCII byte */
+#define U8OVER3		0x04  /* 3-byte overlong form */
+#define U8LARGE		0x08  /* above U+10FFFF */
+#define U8OVER2		0x20  /* 2-byte overlong form */
+#define U8LARGE1000	0x40  /* above U+10FFFF, second byte 1000xxxx */
+#define U8OVER4		0x40  /* 4-byte overlong form */
+#define U8TWOCONTS	0x80  /* continuation after a continuation */
+#define U8CARRY		(U8SHORT | U8LONG | U8TWOCONTS)
+
+#define AVX2	__attribute__((target("avx2")))
+
+AVX2 static __m256i u8table (char t0, char t1, char t2, char t3,
+                             char t4, char t5, char t6, char t7,
+                             char t8, char t9, char t10, char t11,
+                             char t12, char t13, char t14, char t15) {
+  return _mm256_broadcastsi128_si256(_mm_setr_epi8(t0, t1, t2, t3, t4, t5,
+             t6, t7, t8, t9, t10, t11, t12, t13, t14, t15));
+}
+
+AVX2 static size_t scan_avx2 (const char *s, size_t len, lua_Integer *n) {
+  const __m256i hi1 = u8table(U8LONG, U8LONG, U8LONG, U8LONG,
+      U8LONG, U8LONG, U8LONG, U8LONG,
+      (char)U8TWOCONTS, (char)U8TWOCONTS, (char)U8TWOCONTS, (char)U8TWOCONTS,
+      U8SHORT | U8OVER2, U8SHORT, U8SHORT | U8OVER3,
+      U8SHORT | U8LARGE | U8LARGE1000 | U8OVER4);
+  const __m256i lo1 = u8table((char)(U8CARRY | U8OVER3 | U8OVER2 | U8OVER4),
+      (char)(U8CARRY | U8OVER2), (char)U8CARRY, (char)U8CARRY,
+      (char)(U8CARRY | U8LARGE),
+      (char)(U8CARRY | U8LARGE | U8LARGE1000),
+      (char)(U8CARRY | U8LARGE | U8LARGE1000),
+      (char)(U8CARRY | U8LARGE | U8LARGE1000),
+      (char)(U8CARRY | U8LARGE | U8LARGE1000),
+      (char)(U8CARRY | U8LARGE | U8LARGE1000),
+      (char)(U8CARRY | U8LARGE | U8LARGE1000),
+      (char)(U8CARRY | U8LARGE | U8LARGE1000),
+      (char)(U8CARRY | U8LARGE | U8LARGE1000),
+      (char)(U8CARRY | U8LARGE | U8LARGE1000),
+      (char)(U8CARRY | U8LARGE | U8LARGE1000),
+      (char)(U8CARRY | U8LARGE | U8LARGE1000));
+  const __m256i hi2 = u8table(U8SHORT, U8SHORT, U8SHORT, U8SHORT,
+      U8SHORT, U8SHORT, U8SHORT, U8SHORT,
+      (char)(U8LONG | U8OVER2 | U8TWOCONTS | U8OVER3 | U8LARGE1000 | U8OVER4),
+      (char)(U8LONG | U8OVER2 | U8TWOCONTS | U8OVER3 | U8LARGE),
+      (char)(U8LONG | U8OVER2 | U8TWOCONTS | U8LARGE),
+      (char)(U8LONG | U8OVER2 | U8TWOCONTS | U8LARGE),
+      U8SHORT, U8SHORT, U8SHORT, U8SHORT);
+  /* bytes that leave a sequence open at the end of a block */
+  const __m256i open = _mm256_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1,
+      -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+      -1, -1, -1, -1, -1, (char)(0xF0 - 1), (char)(0xE0 - 1), (char)(0xC0 - 1));
+  const __m256i nibble = _mm256_set1_epi8(0x0F);
+  const __m256i zero = _mm256_setzero_si256();
+  __m256i prev = zero, incomplete = zero;
+  lua_Integer count = 0;
+  size_t i;
+  for (i = 0; i + 32 <= len; i += 32) {
+    __m256i in = _mm256_loadu_si256((const __m256i *)(s + i));
+    __m256i p1, p2, p3, cross, err, must;
+    if (_mm256_movemask_epi8(in) == 0) {  /* all ASCII? */
+      if (!_mm256_testz_si256(incomplete, incomplete))
+        break;  /* previous block left a sequence open */
+      count += 32;
+      prev = in;
+      incomplete = zero;
+      continue;
+    }
+    cross = _mm256_permute2x128_si256(prev, in, 0x21);
+    p1 = _mm256_alignr_epi8(in, cross, 15);  /* byte before each byte */
+    p2 = _mm256_alignr_epi8(in, cross, 14);
+    p3 = _mm256_alignr_epi8(in, cross, 13);
+    err = _mm256_and_si256(_mm256_and_si256(
+        _mm256_shuffle_epi8(hi1, _mm256_and_si256(_mm256_srli_epi16(p1, 4), nibble)),
+        _mm256_shuffle_epi8(lo1, _mm256_and_si256(p1, nibble))),
+        _mm256_shuffle_epi8(hi2, _mm256_and_si256(_mm256_srli_epi16(in, 4), nibble)));
+    /* third and fourth bytes of a sequence must be continuations */
+    must = _mm256_or_si256(_mm256_subs_epu8(p2, _mm256_set1_epi8((char)(0xE0 - 1))),
+                           _mm256_subs_epu8(p3, _mm256_set1_epi8((char)(0xF0 - 1))));
+    must = _mm256_and_si256(_mm256_cmpgt_epi8(must, zero),
+                            _mm256_set1_epi8((char)0x80));
+    err = _mm256_xor_si256(err, must);
+    if (!_mm256_testz_si256(err, err))
+      break;
+    /* count the bytes that are not continuations (signed > 0xBF) */
+    count += __builtin_popcount((unsigned int)_mm256_movemask_epi8(
+        _mm256_cmpgt_epi8(in, _mm256_set1_epi8((char)0xBF))));
+    incomplete = _mm256_subs_epu8(in, open);
+    prev = in;
+  }
+  *n += count;
+  return i;
+}
+
+#endif
+
+
+static ScanKernel scankernel = scan_none;
+
+
+static void setscankernel (void) {
+#if defined(UTF8SIMD)
+  scankernel = scan_sse2;
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    scankernel = scan_avx2;
+#endif
+}
+
+
+/*
+** Count the characters that start in [posi,posj] (0-based). Returns -1
+** and sets '*errpos' at the first malformed sequence.
+*/
+static lua_Integer utf8_count (const char *s, lua_Integer posi,
+                               lua_Integer posj, lua_Integer *errpos) {
+  lua_Integer n = 0;
+  lua_Integer next = posi;  /* where to try the scan kernel again */
+  while (posi <= posj) {
+    const char *s1;
+    if (posi >= next && posj - posi >= SCANMIN) {
+      size_t k = scankernel(s + posi, (size_t)(posj - posi + 1), &n);
+      if (k > 0) {
+        lua_Integer last = posi + (lua_Integer)k - 1;
+        while (last > posi && iscont(s + last)) last--;
+        n--;  /* the last character is decoded again below */
+        posi = last;
+      }
+      next = posi + SCANMIN;  /* decode a while before trying again */
+    }
+    s1 = utf8_decode(s + posi, NULL);
+    if (s1 == NULL) {  /* conversion error? */
+      *errpos = posi;
+      return -1;
+    }
+    posi = s1 - s;
+    n++;
+  }
+  return n;
+}
+
+/* }====================================================== */
+
+
 /*
 ** utf8len(s [, i [, j]]) --> number of characters that start in the
 ** range [i,j], or nil + current position if 's' is not well formed in
 ** that interval
 */
 static int utflen (lua_State *L) {
-  int n = 0;
+  lua_Integer n, errpos;
   size_t len;
   const char *s = luaL_checklstring(L, 1, &len);
   lua_Integer posi = u_posrelat(luaL_optinteger(L, 2, 1), len);
@@ -78,15 +281,11 @@ static int utflen (lua_State *L) {
                    "initial position out of string");
   luaL_argcheck(L, --posj < (lua_Integer)len, 3,
                    "final position out of string");
-  while (posi <= posj) {
-    const char *s1 = utf8_decode(s + posi, NULL);
-    if (s1 == NULL) {  /* conversion error? */
-      lua_pushnil(L);  /* return nil ... */
-      lua_pushinteger(L, posi + 1);  /* ... and current position */
-      return 2;
-    }
-    posi = s1 - s;
-    n++;
+  n = utf8_count(s, posi, posj, &errpos);
+  if (n < 0) {  /* conversion error? */
+    lua_pushnil(L);  /* return nil ... */
+    lua_pushinteger(L, errpos + 1);  /* ... and current position */
+    return 2;
   }
   lua_pushinteger(L, n);
   return 1;
@@ -125,6 +324,40 @@ static int codepoint (lua_State *L) {
 }
 
 
+/*
+** decode(s, [i, [j]])  -> table with the codepoints of all characters
+** that start in the range [i,j]
+*/
+static int decode (lua_State *L) {
+  size_t len;
+  const char *s = luaL_checklstring(L, 1, &len);
+  lua_Integer posi = u_posrelat(luaL_optinteger(L, 2, 1), len);
+  lua_Integer pose = u_posrelat(luaL_optinteger(L, 3, -1), len);
+  lua_Integer n, i, errpos;
+  const char *se;
+  luaL_argcheck(L, posi >= 1, 2, "out of range");
+  luaL_argcheck(L, pose <= (lua_Integer)len, 3, "out of range");
+  n = utf8_count(s, posi - 1, pose - 1, &errpos);  /* validate and size */
+  if (n < 0)
+    return luaL_error(L, "invalid UTF-8 code");
+  if (n >= INT_MAX)
+    return luaL_error(L, "string slice too long");
+  lua_createtable(L, (int)n, 0);
+  se = s + pose;
+  i = 0;
+  for (s += posi - 1; s < se;) {
+    int code;
+    if ((unsigned char)*s < 0x80)  /* ascii? */
+      code = (unsigned char)*s++;
+    else
+      s = utf8_decode(s, &code);  /* already known to be valid */
+    lua_pushinteger(L, code);
+    lua_rawseti(L, -2, ++i);
+  }
+  return 1;
+}
+
+
 static void pushutfchar (lua_State *L, int arg) {
   lua_Integer code = luaL_checkinteger(L, arg);
   luaL_argcheck(L, 0 <= code && code <= MAXUNICODE, arg, "value out of range");
@@ -238,6 +471,7 @@ static int iter_codes (lua_State *L) {
 static const luaL_Reg funcs[] = {
   {"offset", byteoffset},
   {"codepoint", codepoint},
+  {"decode", decode},
   {"char", utfchar},
   {"len", utflen},
   {"codes", iter_codes},
@@ -248,6 +482,7 @@ static const luaL_Reg funcs[] = {
 
 
 LUAMOD_API int luaopen_utf8 (lua_State *L) {
+  setscankernel();
   luaL_newlib(L, funcs);
   lua_pushlstring(L, UTF8PATT, sizeof(UTF8PATT)/sizeof(char) - 1);
   lua_setfield(L, -2, "charpattern");
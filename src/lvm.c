@@ -11,6 +11,7 @@
 
 #include <float.h>
 #include <limits.h>
+#include <locale.h>
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -22,6 +23,7 @@
 #include "ldo.h"
 #include "lfunc.h"
 #include "lgc.h"
+#include "ljit.h"
 #include "lobject.h"
 #include "lopcodes.h"
 #include "lstate.h"
@@ -29,6 +31,7 @@
 #include "ltable.h"
 #include "ltm.h"
 #include "lvm.h"
+#include "lvmops.h"
 #include "lapi.h"
 
 /* limit for table tag-method chains (to avoid loops) */
@@ -100,7 +103,8 @@ int luaV_tointeger(const TValue *obj, lua_Integer *p, int mode) {
 	} else if (ttisinteger(obj)) {
 		*p = ivalue(obj);
 		return 1;
-	} else if (cvt2num(obj) && luaO_str2num(svalue(obj), &v) == vslen(obj) + 1) {
+	} else if (cvt2num(obj)
+			&& luaO_str2num(luaS_cstr(_S, tsvalue(obj)), &v) == vslen(obj) + 1) {
 		obj = &v;
 		goto again;
 		/* convert result from 'luaO_str2num' to an integer */
@@ -109,7 +113,7 @@ int luaV_tointeger(const TValue *obj, lua_Integer *p, int mode) {
 }
 void printcode(Instruction i, int pc) {
 #ifdef LUA_PRINT
-	switch (GET_OPCODE(i)) {
+	switch (plainop(GET_OPCODE(i))) {
 	case OP_MOVE:
 		printf("%d OP_MOVE: A %d,Bx %d\n", pc, GETARG_A(i), GETARG_B(i));
 		break;
@@ -321,6 +325,40 @@ static int forlimit(const TValue *obj, lua_Integer *p, lua_Integer step,
 	return 1;
 }
 
+/*
+ ** Prepare a numeric 'for' loop over the initial value, limit and step
+ ** in 'ra', 'ra + 1' and 'ra + 2' (see OP_FORPREP): all integers when
+ ** possible, floats otherwise.
+ */
+void luaV_forprep(lua_State *L, StkId ra) {
+	TValue *init = *ra;
+	TValue *plimit = *(ra + 1);
+	TValue *pstep = *(ra + 2);
+	lua_Integer ilimit;
+	int stopnow;
+	if (ttisinteger(init) && ttisinteger(pstep)
+			&& forlimit(plimit, &ilimit, ivalue(pstep), &stopnow)) {
+		/* all values are integer */
+		lua_Integer initv = (stopnow ? 0 : ivalue(init));
+		TValue *v = int_get(L, ilimit);
+		setobj2s(L, ra + 1, v);
+		luaV_setforint(L, ra, intop(-, initv, ivalue(pstep)));
+	} else { /* try making all values floats */
+		lua_Number ninit;
+		lua_Number nlimit;
+		lua_Number nstep;
+		if (!tonumber(plimit, &nlimit))
+			luaG_runerror(L, "'for' limit must be a number");
+		setobj2s(L, ra + 1, flt_new(L, nlimit)); //plimit=nlimit
+		if (!tonumber(pstep, &nstep))
+			luaG_runerror(L, "'for' step must be a number");
+		setobj2s(L, ra + 2, flt_new(L, nstep)); //pstep=nstep
+		if (!tonumber(init, &ninit))
+			luaG_runerror(L, "'for' initial value must be a number");
+		luaV_setforflt(L, ra, luai_numsub(L, ninit, nstep));
+	}
+}
+
 /*
  ** Finish the table access 'val = t[key]'.
  ** if 'slot' is NULL, 't' is not a table; otherwise, 'slot' points to
@@ -378,9 +416,7 @@ void luaV_finishset(lua_State *L, const TValue *t, TValue *key, TValue *val,
 			lua_assert(ttisnil(slot)); /* old value must be nil */
 			tm = fasttm(L, h->metatable, TM_NEWINDEX); /* get metamethod */
 			if (tm == NULL) { /* no metamethod? */
-				Node res;
-				luaH_setdel(L, h, key, val);
-				//invalidateTMcache(h);//(t)->flags = 0
+				luaH_setdel(L, h, key, val); /* (which invalidates the TM cache) */
 				luaC_barrierback(L, h, val);
 				return;
 			}
@@ -391,7 +427,7 @@ void luaV_finishset(lua_State *L, const TValue *t, TValue *key, TValue *val,
 		}
 		/* try the metamethod */
 		if (ttisfunction(tm)) {
-			luaT_callTM(L, tm, t, key, val, 0);
+			luaT_callTM(L, tm, t, key, &val, 0); /* 3rd argument, not a result slot */
 			return;
 		}
 		t = tm; /* else repeat assignment over 'tm' */
@@ -407,13 +443,23 @@ void luaV_finishset(lua_State *L, const TValue *t, TValue *key, TValue *val,
  ** -larger than zero if 'ls' is smaller-equal-larger than 'rs'.
  ** The code is a little tricky because it allows '\0' in the strings
  ** and it uses 'strcoll' (to respect locales) for each segments
- ** of the strings.
+ ** of the strings. Under a bytewise collation (see 'luaV_setcollate')
+ ** it is a plain 'memcmp'.
  */
-static int l_strcmp(const TString *ls, const TString *rs) {
-	const char *l = getstr(ls);
+static int l_strcmp(lua_State *L, TString *ls, TString *rs) {
+	const char *l, *r;
 	size_t ll = tsslen(ls);
-	const char *r = getstr(rs);
 	size_t lr = tsslen(rs);
+	if (ls == rs)
+		return 0;
+	if (G(L)->bytecmp) { /* byte order: '\0' is just the smallest byte */
+		int temp = memcmp(getstr(ls), getstr(rs), (ll < lr) ? ll : lr);
+		if (temp != 0)
+			return temp;
+		return (ll < lr) ? -1 : (ll > lr);
+	}
+	l = luaS_cstr(L, ls);
+	r = luaS_cstr(L, rs);
 	for (;;) { /* for each segment */
 		int temp = strcoll(l, r);
 		if (temp != 0) /* not equal? */
@@ -434,6 +480,26 @@ static int l_strcmp(const TString *ls, const TString *rs) {
 	}
 }
 
+/*
+ ** Set how 'l_strcmp' orders strings. In the "C" and "POSIX" locales
+ ** (and in "C.UTF-8", which collates by code point) 'strcoll' is
+ ** 'strcmp', which orders each segment as its bytes, so LUA_COLLAUTO
+ ** can use 'memcmp' there too.
+ */
+static int bytelocale(const char *name) {
+	return (name != NULL && (strcmp(name, "C") == 0 || strcmp(name, "POSIX") == 0
+			|| strcmp(name, "C.UTF-8") == 0 || strcmp(name, "C.utf8") == 0));
+}
+
+void luaV_setcollate(global_State *g, int mode) {
+	if (mode >= 0)
+		g->collate = cast_byte(mode);
+	if (g->collate == LUA_COLLAUTO)
+		g->bytecmp = bytelocale(setlocale(LC_COLLATE, NULL));
+	else
+		g->bytecmp = (g->collate == LUA_COLLBYTES);
+}
+
 /*
  ** Check whether integer 'i' is less than float 'f'. If 'i' has an
  ** exact representation as a float ('l_intfitsf'), compare numbers as
@@ -532,7 +598,7 @@ int luaV_lessthan(lua_State *L, const TValue *l, const TValue *r) {
 	if (ttisnumber(l) && ttisnumber(r)) /* both operands are numbers? */
 		return LTnum(l, r);
 	else if (ttisstring(l) && ttisstring(r)) /* both are strings? */
-		return l_strcmp(tsvalue(l), tsvalue(r)) < 0;
+		return l_strcmp(L, tsvalue(l), tsvalue(r)) < 0;
 	else if ((res = luaT_callorderTM(L, l, r, TM_LT)) < 0) /* no metamethod? */
 		luaG_ordererror(L, l, r); /* error */
 	return res;
@@ -551,7 +617,7 @@ int luaV_lessequal(lua_State *L, const TValue *l, const TValue *r) {
 	if (ttisnumber(l) && ttisnumber(r)) /* both operands are numbers? */
 		return LEnum(l, r);
 	else if (ttisstring(l) && ttisstring(r)) /* both are strings? */
-		return l_strcmp(tsvalue(l), tsvalue(r)) <= 0;
+		return l_strcmp(L, tsvalue(l), tsvalue(r)) <= 0;
 	else if ((res = luaT_callorderTM(L, l, r, TM_LE)) >= 0) /* try 'le' */
 		return res;
 	else { /* try 'lt': */
@@ -570,6 +636,7 @@ int luaV_lessequal(lua_State *L, const TValue *l, const TValue *r) {
  */
 int luaV_equalobj(lua_State *L, const TValue *t1, const TValue *t2) {
 	const TValue *tm;
+	int res;
 	if (ttype(t1) != ttype(t2)) { /* not the same variant? */
 		if (ttnov(t1) != ttnov(t2) || ttnov(t1) != LUA_TNUMBER)
 			return 0; /* only numbers can be equal with different variants */
@@ -622,7 +689,11 @@ int luaV_equalobj(lua_State *L, const TValue *t1, const TValue *t2) {
 	if (tm == NULL) /* no TM? */
 		return 0; /* objects are different */
 	luaT_callTM(L, tm, t1, t2, L->top, 1); /* call TM */
-	return !l_isfalse(*L->top);
+	tm = *L->top; /* result was left just above the top */
+	*L->top = NULL;
+	res = !l_isfalse(tm);
+	refDec(L, cast(TValue *, tm));
+	return res;
 }
 
 /* macro used by 'luaV_concat' to ensure that element at 'o' is a string */
@@ -642,11 +713,35 @@ static void copy2buff(StkId top, int n, char *buff) {
 	} while (--n > 0);
 }
 
+/*
+ ** Concatenation into register 'dest' ('dest = dest .. x'): when the
+ ** first operand is the string held by 'dest', the result is built as a
+ ** growable string, and a growable string whose only references are
+ ** 'dest' and its copy in the operand is extended in place, so building
+ ** a string piece by piece is linear instead of quadratic.
+ */
+static TString *accumulate(lua_State *L, StkId dest, StkId top, int n,
+		size_t tl) {
+	TValue *first = *(top - n);
+	TString *ts = tsvalue(first);
+	if (isgrowable(ts) && getRef(first) == 2) { /* nobody else sees it? */
+		size_t l = ts->length;
+		ts = luaS_growlngstr(L, ts, tl); /* may move it */
+		copy2buff(top, n - 1, getstr(ts) + l); /* append the others */
+		*dest = *(top - n) = cast(TValue*, ts);
+	} else {
+		ts = luaS_newgrowable(L, tl);
+		copy2buff(top, n, getstr(ts));
+	}
+	return ts;
+}
+
 /*
  ** Main operation for concatenation: concat 'total' values in the stack,
- ** from 'L->top - total' up to 'L->top - 1'.
+ ** from 'L->top - total' up to 'L->top - 1'. 'destoff' is the saved
+ ** position of the register that receives the result (-1 if unknown).
  */
-void luaV_concat(lua_State *L, int total) {
+static void concat(lua_State *L, int total, ptrdiff_t destoff) {
 	lua_assert(total >= 2);
 	do {
 		StkId top = L->top;
@@ -673,9 +768,15 @@ void luaV_concat(lua_State *L, int total) {
 				char buff[LUAI_MAXSHORTLEN];
 				copy2buff(top, n, buff); /* copy strings to buffer */
 				ts = luaS_newlstr(L, buff, tl);
-			} else { /* long string; copy strings directly to final result */
-				ts = luaS_createlngstrobj(L, tl);
-				copy2buff(top, n, getstr(ts));
+			} else {
+				StkId dest = destoff < 0 ? NULL : restorestack(L, destoff);
+				if (dest != NULL && dest < top - n && *dest == *(top - n)
+						&& ttislngstring(*dest))
+					ts = accumulate(L, dest, top, n, tl);
+				else { /* long string; copy strings directly to final result */
+					ts = luaS_createlngstrobj(L, tl);
+					copy2buff(top, n, getstr(ts));
+				}
 			}
 			setsvalue2s(L, top - n, ts); /* create result */
 		}
@@ -685,6 +786,10 @@ void luaV_concat(lua_State *L, int total) {
 	} while (total > 1); /* repeat until only 1 result left */
 }
 
+void luaV_concat(lua_State *L, int total) {
+	concat(L, total, -1);
+}
+
 /*
  ** Main operation 'ra' = #rb'.
  */
@@ -814,7 +919,6 @@ static void pushclosure(lua_State *L, Proto *p, UpVal **encup, StkId base,
 		else
 			/* get upvalue from enclosing function */
 			ncl->upvals[i] = encup[uv[i].idx];
-		refInc(ncl->upvals[i]->v[0]);
 		ncl->upvals[i]->refcount++;
 		/* new closure is white, so we do not need a barrier here */
 	}
@@ -829,7 +933,7 @@ void luaV_finishOp(lua_State *L) {
 	CallInfo *ci = L->ci;
 	StkId base = ci->u.l.base;
 	Instruction inst = *(ci->u.l.savedpc - 1); /* interrupted instruction */
-	OpCode op = GET_OPCODE(inst);
+	OpCode op = plainop(GET_OPCODE(inst));
 	switch (op) { /* finish its execution */
 	case OP_ADD:
 	case OP_SUB:
@@ -871,13 +975,12 @@ void luaV_finishOp(lua_State *L) {
 		StkId top = L->top - 1; /* top when 'luaT_trybinTM' was called */
 		int b = GETARG_B(inst); /* first element to concatenate */
 		int total = cast_int(top - 1 - (base + b)); /* yet to concatenate */
-		setobj2s(L, top - 2, top); /* put TM result in proper position */
-		if (total > 1) { /* are there elements to concat? */
-			L->top = top - 1; /* top is one after last element (at top-2) */
+		setobj2s(L, top - 2, *top); /* put TM result in proper position */
+		lua_pop(L, 2); /* the 2nd operand and the TM result, as 'concat' does */
+		if (total > 1) /* are there elements to concat? */
 			luaV_concat(L, total); /* concat them (may yield again) */
-		}
 		/* move final result to final position */
-		setobj2s(L, ci->u.l.base + GETARG_A(inst), L->top - 1);
+		setobj2s(L, ci->u.l.base + GETARG_A(inst), *(L->top - 1));
 		L->top = ci->top; /* restore top */
 		break;
 	}
@@ -921,9 +1024,9 @@ void luaV_finishOp(lua_State *L) {
 /* execute a jump instruction */
 #define dojump(ci,i,e) \
   { int a = GETARG_A(i); \
-   printf("dojump: A %d,B %d\n",a,GETARG_sBx(i)); \
     if (a != 0) luaF_close(L, ci->u.l.base + a - 1); \
-    ci->u.l.savedpc += GETARG_sBx(i) + e; }
+    ci->u.l.savedpc += GETARG_sBx(i) + e; \
+    if (GETARG_sBx(i) < 0) checkhooks(L); }
 
 /* for test instructions, execute the jump instruction that follows it */
 #define donextjump(ci)	{ i = *ci->u.l.savedpc; dojump(ci, i, 1); }
@@ -936,29 +1039,43 @@ void luaV_finishOp(lua_State *L) {
                          Protect(L->top = ci->top));  /* restore top */ \
            luai_threadyield(L); }
 
-/* fetch an instruction and prepare its execution */
-#define vmfetch()	 \
-  i = *(ci->u.l.savedpc++); \
-  if (L->hookmask & (LUA_MASKLINE | LUA_MASKCOUNT)) \
-    Protect(luaG_traceexec(L)); \
-  ra = RA(i); /* WARNING: any stack reallocation invalidates 'ra' */ \
-	printcode(i, count++);\
-  lua_assert(base == ci->u.l.base); \
-  lua_assert(L->top < L->stack_last)
-//#define INSTR_GOTO
+/*
+ ** Threaded dispatch (an indirect jump at the end of each instruction,
+ ** through 'opcode_targets') needs the labels-as-values extension of
+ ** GCC and Clang; define LUA_USE_SWITCH to keep the portable 'switch'.
+ */
+#if !defined(INSTR_GOTO) && !defined(LUA_USE_SWITCH) && defined(__GNUC__)
+#define INSTR_GOTO
+#endif
+
+/* 'vmfetch' and 'checkhooks' depend on the variant of the loop */
 #ifdef INSTR_GOTO
 #define vmdispatch(o)	goto *opcode_targets[o];
 #define vmbreak		do{\
 	vmfetch();\
 	goto *opcode_targets[GET_OPCODE(i)];\
 }while(0);
-#define vmcase(l)	TARGET_##l://case l:
+#define vmcase(l)	TARGET_##l:
 #else
 #define vmdispatch(o)	switch(o)
 #define vmcase(l)	case l:
 #define vmbreak break;
 #endif
 
+/*
+ ** end of a superinstruction: fetch the instruction that it pairs with
+ ** and go on with its handler 'l' without a dispatch
+ */
+#define vmfused(l)	{ vmfetch(); goto l; }
+
+/*
+ ** rewrite the opcode of the running instruction: a plain opcode turns
+ ** into its quickened form once the operands fit it, and a quickened
+ ** one turns back when its guard fails (then it goes on at the plain
+ ** handler, which does not quicken again for the same operands)
+ */
+#define quicken(o)	SET_OPCODE(*cast(Instruction *, ci->u.l.savedpc - 1), o)
+
 /*
  ** copy of 'luaV_gettable', but protecting the call to potential
  ** metamethod (which can reallocate the stack)
@@ -972,608 +1089,39 @@ void luaV_finishOp(lua_State *L) {
   if (!luaV_fastset(L,t,k,slot,luaH_setifexist,v)) \
     Protect(luaV_finishset(L,t,k,v,slot)); }
 
-void luaV_execute(lua_State *L) {
-	static int count = 0;
-	CallInfo *ci = L->ci;
-	LClosure *cl;
-	StkId k;
-	StkId base;
-	StkId ra, rb, rc;
-	TValue *vb, *vc;
-	Instruction i;
-#ifdef INSTR_GOTO
-#include"opcode_targets.h"
+/*
+ ** The loop is compiled twice from 'lvmexec.h': a lean variant that
+ ** never looks at line and count hooks, and an instrumented one that
+ ** calls them (and traces instructions with LUA_PRINT). A variant polls
+ ** 'L->hookmask' only on frame changes, after calls to C functions and
+ ** on backward jumps, and returns 1 when 'lua_sethook' switched line or
+ ** count hooks on or off; the other one then goes on from the current
+ ** instruction, as all the state of the loop lives in the 'CallInfo's.
+ */
+#define HOOKMASK	(LUA_MASKLINE | LUA_MASKCOUNT)
+
+#if defined(LUA_PRINT)
+#define usehooks(L)	1  /* every instruction is traced */
+#else
+#define usehooks(L)	((L)->hookmask & HOOKMASK)
 #endif
-	ci->callstatus |= CIST_FRESH; /* fresh invocation of 'luaV_execute" */
-	newframe: /* reentry point when frame changes (call/return) */
-	lua_assert(ci == L->ci);
-	cl = clLvalue(*ci->func); /* local reference to function's closure */
-	k = cl->p->k; /* local reference to function's constant table */
-	base = ci->u.l.base; /* local copy of function's base */
-	lua_assert(base <= L->top);
-	/* main loop of interpreter */
-	for (;;) {
-		i = *(ci->u.l.savedpc++);
-		if (L->hookmask & (LUA_MASKLINE | LUA_MASKCOUNT))
-			Protect(luaG_traceexec(L));
-		ra = base + GETARG_A(i); /* WARNING: any stack reallocation invalidates 'ra' */
-		lua_assert(base == ci->u.l.base);
-		lua_assert(L->top < L->stack_last);
-		printcode(i, count++);
-		vmdispatch (GET_OPCODE(i)) {
-		vmcase(OP_MOVE) {
-			setobj(L, ra, RB(i));
-			vmbreak
-		}
-		vmcase(OP_LOADK) {
-			rb = k + GETARG_Bx(i);
-			setobj(L, ra, rb);
-			vmbreak
-		}
-		vmcase(OP_LOADKX) {
-			lua_assert(GET_OPCODE(*ci->u.l.savedpc) == OP_EXTRAARG);
-			rb = k + GETARG_Ax(*ci->u.l.savedpc++);
-			setobj(L, ra, rb);
-			vmbreak
-		}
-		vmcase(OP_LOADBOOL) {
-			setbvalue(L, ra, GETARG_B(i));
-			if (GETARG_C(i))
-				ci->u.l.savedpc++; /* skip next instruction (if C) */
-			vmbreak
-		}
-		vmcase(OP_LOADNIL) {
-			int b = GETARG_B(i);
-			do {
-				setnilvalue(ra);
-				ra++;
-			} while (b--);
-			vmbreak
-		}
-		vmcase(OP_GETUPVAL) {
-			int b = GETARG_B(i);
-			setobj2s(L, ra, *(cl->upvals[b]->v));
-			vmbreak
-		}
-		vmcase(OP_GETTABUP) {
-			TValue *upval = cl->upvals[GETARG_B(i)]->v[0];
-			rc = RKC(i);
-			gettableProtected(L, upval, *rc, ra);
-			vmbreak
-		}
-		vmcase(OP_GETTABLE) {
-			StkId rb = RB(i);
-			rc = RKC(i);
-			gettableProtected(L, *rb, *rc, ra);
-			vmbreak
-		}
-		vmcase(OP_SETTABUP) {
-			TValue *upval = cl->upvals[GETARG_A(i)]->v[0];
-			rb = RKB(i);
-			rc = RKC(i);
-			settableProtected(L, upval, *rb, *rc);
-			vmbreak
-		}
-		vmcase(OP_SETUPVAL) {
-			UpVal *uv = cl->upvals[GETARG_B(i)];
-			setobj(L, uv->v, ra);
-			luaC_upvalbarrier(L, uv);
-			vmbreak
-		}
-		vmcase(OP_SETTABLE) {
-			rb = RKB(i);
-			rc = RKC(i);
-			settableProtected(L, *ra, *rb, *rc);
-			vmbreak
-		}
-		vmcase(OP_NEWTABLE) {
-			int b = GETARG_B(i);
-			int c = GETARG_C(i);
-			Table *t = luaH_new(L);
-			setobj2s(L, ra, (TValue*) t);
-			if (b != 0 || c != 0)
-				luaH_resize(L, t, luaO_fb2int(b), luaO_fb2int(c));
-			checkGC(L, ra + 1);
-			vmbreak
-		}
-		vmcase(OP_SELF) {
-			const TValue *aux;
-			rb = RB(i);
-			rc = RKC(i);
-			TString *key = tsvalue(*rc); /* key must be a string */
-			setobj(L, ra + 1, rb);
-			if (luaV_fastget(L, *rb, key, aux, luaH_getstr)) {
-				setobj2s(L, ra, aux);
-			} else
-				Protect(luaV_finishget(L, *rb, *rc, ra, aux));
-			vmbreak
-		}
-		vmcase(OP_ADD) {
-			vb = RKB(i)[0];
-			vc = RKC(i)[0];
-			lua_Number nb;
-			lua_Number nc;
-			if (ttisinteger(vb) && ttisinteger(vc)) {
-				lua_Integer ib = ivalue(vb);
-				lua_Integer ic = ivalue(vc);
-				TValue *v = int_get(L, intop(+, ib, ic));
-				setobj2s(L, ra, v);
-			} else if (tonumber(vb, &nb) && tonumber(vc, &nc)) {
-				TValue *v = flt_new(L, luai_numadd(L, nb, nc));
-				setobj2s(L, ra, v);
-			} else {
-				Protect(luaT_trybinTM(L, vb, vc, ra, TM_ADD));
-			}
-			vmbreak
-		}
-		vmcase(OP_SUB) {
-			vb = RKB(i)[0];
-			vc = RKC(i)[0];
-			lua_Number nb;
-			lua_Number nc;
-			if (ttisinteger(vb) && ttisinteger(vc)) {
-				lua_Integer ib = ivalue(vb);
-				lua_Integer ic = ivalue(vc);
-				TValue *v = int_get(L, intop(-, ib, ic));
-				setobj2s(L, ra, v);
-			} else if (tonumber(vb, &nb) && tonumber(vc, &nc)) {
-				TValue *v = flt_new(L, luai_numsub(L, nb, nc));
-				setobj2s(L, ra, v);
-			} else {
-				Protect(luaT_trybinTM(L, vb, vc, ra, TM_SUB));
-			}
-			vmbreak
-		}
-		vmcase(OP_MUL) {
-			vb = RKB(i)[0];
-			vc = RKC(i)[0];
-			lua_Number nb;
-			lua_Number nc;
-			if (ttisinteger(vb) && ttisinteger(vc)) {
-				lua_Integer ib = ivalue(vb);
-				lua_Integer ic = ivalue(vc);
-				TValue *v = int_get(L, intop(*, ib, ic));
-				setobj2s(L, ra, v);
-			} else if (tonumber(vb, &nb) && tonumber(vc, &nc)) {
-				TValue *v = flt_new(L, luai_nummul(L, nb, nc));
-				setobj2s(L, ra, v);
-			} else {
-				Protect(luaT_trybinTM(L, vb, vc, ra, TM_MUL));
-			}
-			vmbreak
-		}
-		vmcase(OP_DIV) { /* float division (always with floats) */
-			vb = RKB(i)[0];
-			vc = RKC(i)[0];
-			lua_Number nb;
-			lua_Number nc;
-			if (tonumber(vb, &nb) && tonumber(vc, &nc)) {
-				TValue *v = flt_new(L, luai_numdiv(L, nb, nc));
-				setobj2s(L, ra, v);
-			} else {
-				Protect(luaT_trybinTM(L, vb, vc, ra, TM_DIV));
-			}
-			vmbreak
-		}
-		vmcase(OP_BAND) {
-			vb = RKB(i)[0];
-			vc = RKC(i)[0];
-			lua_Integer ib;
-			lua_Integer ic;
-			if (tointeger(vb, &ib) && tointeger(vc, &ic)) {
-				TValue *v = int_get(L, intop(&, ib, ic));
-				setobj2s(L, ra, v);
-			} else {
-				Protect(luaT_trybinTM(L, vb, vc, ra, TM_BAND));
-			}
-			vmbreak
-		}
-		vmcase(OP_BOR) {
-			vb = RKB(i)[0];
-			vc = RKC(i)[0];
-			lua_Integer ib;
-			lua_Integer ic;
-			if (tointeger(vb, &ib) && tointeger(vc, &ic)) {
-				TValue *v = int_get(L, intop(|, ib, ic));
-				setobj2s(L, ra, v);
-			} else {
-				Protect(luaT_trybinTM(L, vb, vc, ra, TM_BOR));
-			}
-			vmbreak
-		}
-		vmcase(OP_BXOR) {
-			vb = RKB(i)[0];
-			vc = RKC(i)[0];
-			lua_Integer ib;
-			lua_Integer ic;
-			if (tointeger(vb, &ib) && tointeger(vc, &ic)) {
-				TValue *v = int_get(L, intop(^, ib, ic));
-				setobj2s(L, ra, v);
-			} else {
-				Protect(luaT_trybinTM(L, vb, vc, ra, TM_BXOR));
-			}
-			vmbreak
-		}
-		vmcase(OP_SHL) {
-			vb = RKB(i)[0];
-			vc = RKC(i)[0];
-			lua_Integer ib;
-			lua_Integer ic;
-			if (tointeger(vb, &ib) && tointeger(vc, &ic)) {
-				TValue *v = int_get(L, luaV_shiftl(ib, ic));
-				setobj2s(L, ra, v);
-			} else {
-				Protect(luaT_trybinTM(L, vb, vc, ra, TM_SHL));
-			}
-			vmbreak
-		}
-		vmcase(OP_SHR) {
-			vb = RKB(i)[0];
-			vc = RKC(i)[0];
-			lua_Integer ib;
-			lua_Integer ic;
-			if (tointeger(vb, &ib) && tointeger(vc, &ic)) {
-				TValue *v = int_get(L, luaV_shiftl(ib, ic));
-				setobj2s(L, ra, v);
-			} else {
-				Protect(luaT_trybinTM(L, vb, vc, ra, TM_SHR));
-			}
-			vmbreak
-		}
-		vmcase(OP_MOD) {
-			vb = RKB(i)[0];
-			vc = RKC(i)[0];
-			lua_Number nb;
-			lua_Number nc;
-			if (ttisinteger(vb) && ttisinteger(vc)) {
-				lua_Integer ib = ivalue(vb);
-				lua_Integer ic = ivalue(vc);
-				TValue *v = int_get(L, luaV_mod(L, ib, ic));
-				setobj2s(L, ra, v);
-			} else if (tonumber(vb, &nb) && tonumber(vc, &nc)) {
-				lua_Number m;
-				luai_nummod(L, nb, nc, m);
-				TValue *v = flt_new(L, m);
-				setobj2s(L, ra, v);
-			} else {
-				Protect(luaT_trybinTM(L, vb, vc, ra, TM_MOD));
-			}
-			vmbreak
-		}
-		vmcase(OP_IDIV) { /* floor division */
-			vb = RKB(i)[0];
-			vc = RKC(i)[0];
-			lua_Number nb;
-			lua_Number nc;
-			if (ttisinteger(vb) && ttisinteger(vc)) {
-				lua_Integer ib = ivalue(vb);
-				lua_Integer ic = ivalue(vc);
-				TValue *v = int_get(L, luaV_div(L, ib, ic));
-				setobj2s(L, ra, v);
-			} else if (tonumber(vb, &nb) && tonumber(vc, &nc)) {
-				TValue *v = flt_new(L, luai_numidiv(L, nb, nc));
-				setobj2s(L, ra, v);
-			} else {
-				Protect(luaT_trybinTM(L, vb, vc, ra, TM_IDIV));
-			}
-			vmbreak
-		}
-		vmcase(OP_POW) {
-			vb = RKB(i)[0];
-			vc = RKC(i)[0];
-			lua_Number nb;
-			lua_Number nc;
-			if (tonumber(vb, &nb) && tonumber(vc, &nc)) {
-				TValue *v = flt_new(L, luai_numpow(L, nb, nc));
-				setobj2s(L, ra, v);
-			} else {
-				Protect(luaT_trybinTM(L, vb, vc, ra, TM_POW));
-			}
-			vmbreak
-		}
-		vmcase(OP_UNM) {
-			vb = RB(i)[0];
-			lua_Number nb;
-			if (ttisinteger(vb)) {
-				lua_Integer ib = ivalue(vb);
-				TValue *v = int_get(L, intop(-, 0, ib));
-				setobj2s(L, ra, v);
-			} else if (tonumber(vb, &nb)) {
-				TValue *v = flt_new(L, luai_numunm(L, nb));
-				setobj2s(L, ra, v);
-			} else {
-				Protect(luaT_trybinTM(L, vb, vb, ra, TM_UNM));
-			}
-			vmbreak
-		}
-		vmcase(OP_BNOT) {
-			vb = RB(i)[0];
-			lua_Integer ib;
-			if (tointeger(vb, &ib)) {
-				TValue *v = int_get(L, intop(^, ~l_castS2U(0), ib));
-				setobj2s(L, ra, v);
-			} else {
-				Protect(luaT_trybinTM(L, vb, vb, ra, TM_BNOT));
-			}
-			vmbreak
-		}
-		vmcase(OP_NOT) {
-			vb = RB(i)[0];
-			int res = l_isfalse(vb); /* next assignment may change this value */
-			setbvalue(L, ra, res);
-			vmbreak
-		}
-		vmcase(OP_LEN) {
-			Protect(luaV_objlen(L, ra, RB(i)[0]));
-			vmbreak
-		}
-		vmcase(OP_CONCAT) {
-			int b = GETARG_B(i);
-			int c = GETARG_C(i);
-			StkId rb;
-			L->top = base + c + 1; /* mark the end of concat operands */
-			Protect(luaV_concat(L, c - b + 1));
-			ra = RA(i); /* 'luaV_concat' may invoke TMs and move the stack */
-			rb = base + b;
-			setobjs2s(L, ra, rb);
-			checkGC(L, (ra >= rb ? ra + 1 : rb));
-			L->top = ci->top; /* restore top */
-			vmbreak
-		}
-		vmcase(OP_JMP) {
-			dojump(ci, i, 0);
-			vmbreak
-		}
-		vmcase(OP_EQ) {
-			rb = RKB(i);
-			rc = RKC(i);
-			Protect(
-					if (luaV_equalobj(L, rb[0], rc[0]) != GETARG_A(i)) ci->u.l.savedpc++; else donextjump(ci);)
-			vmbreak
-		}
-		vmcase(OP_LT) {
-			Protect(
-					if (luaV_lessthan(L, RKB(i)[0], RKC(i)[0]) != GETARG_A(i)) ci->u.l.savedpc++; else donextjump(ci);)
-			vmbreak
-		}
-		vmcase(OP_LE) {
-			Protect(
-					if (luaV_lessequal(L, RKB(i)[0], RKC(i)[0]) != GETARG_A(i)) ci->u.l.savedpc++; else donextjump(ci);)
-			vmbreak
-		}
-		vmcase(OP_TEST) {
-			if (GETARG_C(i) ? l_isfalse(*ra) : !l_isfalse(*ra))
-				ci->u.l.savedpc++;
-			else
-				donextjump(ci);
-			vmbreak
-		}
-		vmcase(OP_TESTSET) {
-			rb = RB(i);
-			if (GETARG_C(i) ? l_isfalse(*rb) : !l_isfalse(*rb))
-				ci->u.l.savedpc++;
-			else {
-				setobjs2s(L, ra, rb);
-				donextjump(ci);
-			}
-			vmbreak
-		}
-		vmcase(OP_CALL) {
-			int b = GETARG_B(i);
-			int nresults = GETARG_C(i) - 1;
-			if (b != 0) {
-				rb = ra + b;
-				lua_assert(L->top >= rb);
-				while (L->top > rb) {
-					--L->top;
-					refDec(L, *(L->top));
-					*L->top = NULL;
-				}
-//				L->top = rb; /* else previous instruction set top */
-			}
-			if (luaD_precall(L, ra, nresults)) { /* C function? */
-				if (nresults >= 0) {
-					lua_assert(L->top <= ci->top);
-					L->top = ci->top; /* 一般情况 L->top < ci->top，adjust results */
-				}
-				Protect((void )0); /* update 'base' */
-			} else { /* Lua function */
-				ci = L->ci;
-				goto newframe;
-				/* restart luaV_execute over new Lua function */
-			}
-			vmbreak
-		}
-		vmcase(OP_TAILCALL) {
-			int b = GETARG_B(i);
-			if (b != 0)
-				L->top = ra + b; /* else previous instruction set top */
-			lua_assert(GETARG_C(i) - 1 == LUA_MULTRET);
-			if (luaD_precall(L, ra, LUA_MULTRET)) { /* C function? */
-				Protect((void )0); /* update 'base' */
-			} else {
-				/* tail call: put called frame (n) in place of caller one (o) */
-				CallInfo *nci = L->ci; /* called frame */
-				CallInfo *oci = nci->previous; /* caller frame */
-				StkId nfunc = nci->func; /* called function */
-				StkId ofunc = oci->func; /* caller function */
-				/* last stack slot filled by 'precall' */
-				StkId lim = nci->u.l.base + getproto(*nfunc)->numparams;
-				int aux;
-				/* close all upvalues from previous call */
-				if (cl->p->np > 0)
-					luaF_close(L, oci->u.l.base);
-				/* move new frame into old one */
-				for (aux = 0; nfunc + aux < lim; aux++)
-					setobjs2s(L, ofunc + aux, nfunc + aux);
-				oci->u.l.base = ofunc + (nci->u.l.base - nfunc); /* correct base */
-				oci->top = L->top = ofunc + (L->top - nfunc); /* correct top */
-				oci->u.l.savedpc = nci->u.l.savedpc;
-				oci->callstatus |= CIST_TAIL; /* function was tail called */
-				ci = L->ci = oci; /* remove new frame */
-				lua_assert(L->top == oci->u.l.base + getproto(ofunc[0])->maxstacksize);
-				goto newframe;
-				/* restart luaV_execute over new Lua function */
-			}
-			vmbreak
-		}
-		vmcase(OP_RETURN) {
-			int b = GETARG_B(i);
-			if (cl->p->np > 0)
-				luaF_close(L, base);
-			b = luaD_poscall(L, ci, ra, (b != 0 ? b - 1 : cast_int(L->top - ra)));
-			if (ci->callstatus & CIST_FRESH) /* local 'ci' still from callee */
-				return; /* external invocation: return */
-			else { /* invocation via reentry: continue execution */
-				ci = L->ci;
-				if (b)
-					L->top = ci->top;
-				lua_assert(isLua(ci));
-				lua_assert(GET_OPCODE(*((ci)->u.l.savedpc - 1)) == OP_CALL);
-				goto newframe;
-				/* restart luaV_execute over new Lua function */
-			}
-		}
-		vmcase(OP_FORLOOP) {
-			if (ttisinteger(*ra)) { /* integer loop? */
-				lua_Integer step = ivalue(ra[2]);
-				lua_Integer idx = intop(+, ivalue(*ra), step); /* increment index */
-				lua_Integer limit = ivalue(ra[1]);
-				if ((0 < step) ? (idx <= limit) : (limit <= idx)) {
-					ci->u.l.savedpc += GETARG_sBx(i); /* jump back */
-					TValue *v = int_get(L, idx);
-					setobj2s(L, ra, v);/* update internal index... */
-					setobj2s(L, ra + 3, v);/* ...and external index */
-				}
-			} else { /* floating loop */
-				lua_Number step = fltvalue(ra[2]);
-				lua_Number idx = luai_numadd(L, fltvalue(*ra), step); /* inc. index */
-				lua_Number limit = fltvalue(ra[1]);
-				if (luai_numlt(0, step) ?
-						luai_numle(idx, limit) : luai_numle(limit, idx)) {
-					ci->u.l.savedpc += GETARG_sBx(i); /* jump back */
-					TValue *v = flt_new(L, idx);
-					setobj2s(L, ra, v);/* update internal index... */
-					setobj2s(L, ra + 3, v);/* ...and external index */
-				}
-			}
-			vmbreak
-		}
-		vmcase(OP_FORPREP) {
-			TValue *init = *ra;
-			TValue *plimit = *(ra + 1);
-			TValue *pstep = *(ra + 2);
-			lua_Integer ilimit;
-			int stopnow;
-			if (ttisinteger(init) && ttisinteger(pstep)
-					&& forlimit(plimit, &ilimit, ivalue(pstep), &stopnow)) {
-				/* all values are integer */
-				lua_Integer initv = (stopnow ? 0 : ivalue(init));
-				TValue *v = int_get(L, ilimit);
-				setobj2s(L, ra + 1, v);
-				v = int_get(L, intop(-, initv, ivalue(pstep)));
-				setobj2s(L, ra, v);
-//				setivalue(plimit, ilimit);
-//				setivalue(init, intop(-, initv, ivalue(pstep)));
-			} else { /* try making all values floats */
-				lua_Number ninit;
-				lua_Number nlimit;
-				lua_Number nstep;
-				if (!tonumber(plimit, &nlimit))
-					luaG_runerror(L, "'for' limit must be a number");
-				setobj2s(L, ra + 1, flt_new(L, nlimit)); //plimit=nlimit
-				if (!tonumber(pstep, &nstep))
-					luaG_runerror(L, "'for' step must be a number");
-				setobj2s(L, ra + 2, flt_new(L, nstep)); //pstep=nstep
-				if (!tonumber(init, &ninit))
-					luaG_runerror(L, "'for' initial value must be a number");
-				TValue *v = flt_new(L, luai_numsub(L, ninit, nstep));
-				setobj2s(L, ra, v);
-//				setfltvalue(init, luai_numsub(L, ninit, nstep));
-			}
-			ci->u.l.savedpc += GETARG_sBx(i);
-			vmbreak
-		}
-		vmcase(OP_TFORCALL) {
-			StkId cb = ra + 3; /* call base */
-			setobjs2s(L, cb + 2, ra + 2); //索引
-			setobjs2s(L, cb + 1, ra + 1); //table
-			setobjs2s(L, cb, ra);
-			L->top = cb + 3; /* func. + 2 args (state and index) */
-			Protect(luaD_call(L, cb, GETARG_C(i)));
-			L->top = ci->top;
-			i = *(ci->u.l.savedpc++); /* go to next instruction */
-			ra = RA(i);
-			lua_assert(GET_OPCODE(i) == OP_TFORLOOP);
-			goto l_tforloop;
-		}
-		vmcase(OP_TFORLOOP) {
-			l_tforloop: if (!ttisnil(ra[1])) { /* continue loop? */
-				setobjs2s(L, ra, ra + 1); /* save control variable */
-				ci->u.l.savedpc += GETARG_sBx(i); /* jump back */
-			}
-			vmbreak
-		}
-		vmcase(OP_SETLIST) {
-			int n = GETARG_B(i);
-			int c = GETARG_C(i);
-			unsigned int last, start;
-			Table *h;
-			if (n == 0)
-				n = cast_int(L->top - ra) - 1;
-			if (c == 0) {
-				lua_assert(GET_OPCODE(*ci->u.l.savedpc) == OP_EXTRAARG);
-				c = GETARG_Ax(*ci->u.l.savedpc++);
-			}
-			h = hvalue(*ra);
-			start = (c - 1) * LFIELDS_PER_FLUSH;
-			last = start + n;
-			if (last > h->sizearray) /* needs more space? */
-				luaH_resizearray(L, h, last); /* preallocate it at once */
-			for (; n > 0; n--) {
-				StkId val = ++ra;
-				luaH_setint(L, h, ++start, *val);
-				luaC_barrierback(L, (TValue*) h, *val);
-			}
-			L->top = ci->top; /* correct top (in case of previous open call) */
-			vmbreak
-		}
-		vmcase(OP_CLOSURE) {
-			Proto *p = cl->p->p[GETARG_Bx(i)];
-			LClosure *ncl = getcached(p, cl->upvals, base); /* cached closure */
-			if (ncl == NULL) /* no match? */
-				pushclosure(L, p, cl->upvals, base, ra); /* create a new one */
-			else
-				setclLvalue(L, ra, ncl); /* push cashed closure */
-//        checkGC(L, ra + 1);
-			condchangemem(L, pre, pos);
-			luai_threadyield(L);
-			vmbreak
-		}
-		vmcase(OP_VARARG) {
-			int b = GETARG_B(i) - 1; /* required results */
-			int j;
-			int n = cast_int(base - ci->func) - cl->p->numparams - 1;
-			if (n < 0) /* less arguments than parameters? */
-				n = 0; /* no vararg arguments */
-			if (b < 0) { /* B == 0? */
-				b = n; /* get all var. arguments */
-				Protect(luaD_checkstack(L, n));
-				ra = RA(i); /* previous call may change the stack */
-				L->top = ra + n;
-			}
-			for (j = 0; j < b && j < n; j++)
-				setobjs2s(L, ra + j, base - n + j);
-			for (; j < b; j++) /* complete required results with nil */
-				setnilvalue(ra + j);
-			vmbreak
-		}
-		vmcase(OP_EXTRAARG) {
-			lua_assert(0);
-			vmbreak
-		}
-		}
-	}
+
+#define LUAV_HOOKED	0
+#define luaV_executeloop	execute_lean
+#include "lvmexec.h"
+#undef LUAV_HOOKED
+#undef luaV_executeloop
+
+#define LUAV_HOOKED	1
+#define luaV_executeloop	execute_hooked
+#include "lvmexec.h"
+#undef LUAV_HOOKED
+#undef luaV_executeloop
+
+void luaV_execute(lua_State *L) {
+	L->ci->callstatus |= CIST_FRESH; /* fresh invocation of 'luaV_execute" */
+	while (usehooks(L) ? execute_hooked(L) : execute_lean(L))
+		; /* hooks changed: go on with the other variant */
 }
 
 /* }================================================================== */
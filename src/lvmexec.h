@@ -0,0 +1,799 @@
+/*
+ ** Interpreter loop, included twice by lvm.c (see 'luaV_execute'):
+ ** LUAV_HOOKED selects the variant and 'luaV_executeloop' names it.
+ ** See Copyright Notice in lua.h
+ */
+
+#if LUAV_HOOKED
+
+#define checkhooks(L)	{ if (!usehooks(L)) return 1; }
+
+#define jitenter(L)	((void)0)
+
+#if defined(LUA_PRINT)
+#define tracecode(i)	printcode(i, pcRel(ci->u.l.savedpc, cl->p))
+#else
+#define tracecode(i)	((void)0)
+#endif
+
+/* fetch an instruction and prepare its execution */
+#define vmfetch()	\
+  i = *(ci->u.l.savedpc++); \
+  if (L->hookmask & HOOKMASK) \
+    Protect(luaG_traceexec(L)); \
+  ra = RA(i); /* WARNING: any stack reallocation invalidates 'ra' */ \
+  tracecode(i); \
+  lua_assert(base == ci->u.l.base); \
+  lua_assert(L->top < L->stack_last)
+
+#else
+
+#define checkhooks(L)	{ if (usehooks(L)) return 1; }
+
+/*
+ ** go on with the native code of a hot function (see 'ljit.c'), at its
+ ** entry, after calls to C functions and on backward jumps
+ */
+#if defined(LUA_USE_JIT)
+#define jitenter(L)	{ if (luaJ_hot(L, cl->p)) { \
+	if (luaJ_run(L, ci)) { ci = L->ci; goto newframe; } \
+	base = ci->u.l.base; } }
+#else
+#define jitenter(L)	((void)0)
+#endif
+
+#define tracecode(i)	((void)0)
+
+#define vmfetch()	\
+  i = *(ci->u.l.savedpc++); \
+  ra = RA(i); /* WARNING: any stack reallocation invalidates 'ra' */ \
+  lua_assert(base == ci->u.l.base); \
+  lua_assert(L->top < L->stack_last)
+
+#endif
+
+static int luaV_executeloop(lua_State *L) {
+	CallInfo *ci = L->ci;
+	LClosure *cl;
+	StkId k;
+	StkId base;
+	StkId ra, rb, rc;
+	TValue *vb, *vc;
+	Instruction i;
+#ifdef INSTR_GOTO
+#include"opcode_targets.h"
+#endif
+	newframe: /* reentry point when frame changes (call/return) */
+	lua_assert(ci == L->ci);
+	cl = clLvalue(*ci->func); /* local reference to function's closure */
+	k = cl->p->k; /* local reference to function's constant table */
+	base = ci->u.l.base; /* local copy of function's base */
+	lua_assert(base <= L->top);
+	checkhooks(L);
+	if (ci->u.l.savedpc == cl->p->code) /* a call, not a return */
+		jitenter(L);
+	/* main loop of interpreter */
+	for (;;) {
+		vmfetch();
+		vmdispatch (GET_OPCODE(i)) {
+		vmcase(OP_MOVE) {
+			setobj(L, ra, RB(i));
+			vmbreak
+		}
+		vmcase(OP_LOADK) {
+			rb = k + GETARG_Bx(i);
+			setobj(L, ra, rb);
+			vmbreak
+		}
+		vmcase(OP_LOADKX) {
+			lua_assert(GET_OPCODE(*ci->u.l.savedpc) == OP_EXTRAARG);
+			rb = k + GETARG_Ax(*ci->u.l.savedpc++);
+			setobj(L, ra, rb);
+			vmbreak
+		}
+		vmcase(OP_LOADBOOL) {
+			l_loadbool: setbvalue(L, ra, GETARG_B(i));
+			if (GETARG_C(i))
+				ci->u.l.savedpc++; /* skip next instruction (if C) */
+			vmbreak
+		}
+		vmcase(OP_LOADNIL) {
+			int b = GETARG_B(i);
+			do {
+				setnilvalue(ra);
+				ra++;
+			} while (b--);
+			vmbreak
+		}
+		vmcase(OP_GETUPVAL) {
+			int b = GETARG_B(i);
+			setobj2s(L, ra, *(cl->upvals[b]->v));
+			vmbreak
+		}
+		vmcase(OP_GETTABUP) {
+			TValue *upval = cl->upvals[GETARG_B(i)]->v[0];
+			rc = RKC(i);
+			gettableProtected(L, upval, *rc, ra);
+			vmbreak
+		}
+		vmcase(OP_GETTABLE) l_gettable: {
+			StkId rb = RB(i);
+			rc = RKC(i);
+			if (ttistable(*rb)) {
+				if (ttisinteger(*rc)) {
+					if (l_castS2U(ivalue(*rc)) - 1u < hvalue(*rb)->sizearray)
+						quicken(OP_GETTABLEI);
+				} else if (ttisshrstring(*rc))
+					quicken(OP_GETTABLES);
+			}
+			gettableProtected(L, *rb, *rc, ra);
+			vmbreak
+		}
+		vmcase(OP_SETTABUP) {
+			TValue *upval = cl->upvals[GETARG_A(i)]->v[0];
+			rb = RKB(i);
+			rc = RKC(i);
+			settableProtected(L, upval, *rb, *rc);
+			vmbreak
+		}
+		vmcase(OP_SETUPVAL) {
+			UpVal *uv = cl->upvals[GETARG_B(i)];
+			setobj(L, uv->v, ra);
+			luaC_upvalbarrier(L, uv);
+			vmbreak
+		}
+		vmcase(OP_SETTABLE) {
+			rb = RKB(i);
+			rc = RKC(i);
+			settableProtected(L, *ra, *rb, *rc);
+			vmbreak
+		}
+		vmcase(OP_NEWTABLE) {
+			int b = GETARG_B(i);
+			int c = GETARG_C(i);
+			Table *t = luaH_new(L);
+			setobj2s(L, ra, (TValue*) t);
+			if (b != 0 || c != 0)
+				luaH_resize(L, t, luaO_fb2int(b), luaO_fb2int(c));
+			checkGC(L, ra + 1);
+			vmbreak
+		}
+		vmcase(OP_SELF) {
+			const TValue *aux;
+			rb = RB(i);
+			rc = RKC(i);
+			TString *key = tsvalue(*rc); /* key must be a string */
+			setobj(L, ra + 1, rb);
+			if (luaV_fastget(L, *rb, key, aux, luaH_getstr)) {
+				setobj2s(L, ra, aux);
+			} else
+				Protect(luaV_finishget(L, *rb, *rc, ra, aux));
+			vmbreak
+		}
+		vmcase(OP_ADD) {
+			vb = RKB(i)[0];
+			vc = RKC(i)[0];
+			lua_Number nb;
+			lua_Number nc;
+			if (ttisinteger(vb) && ttisinteger(vc)) {
+				lua_Integer ib = ivalue(vb);
+				lua_Integer ic = ivalue(vc);
+				TValue *v = int_get(L, intop(+, ib, ic));
+				setobj2s(L, ra, v);
+			} else if (tonumber(vb, &nb) && tonumber(vc, &nc)) {
+				TValue *v = flt_new(L, luai_numadd(L, nb, nc));
+				setobj2s(L, ra, v);
+			} else {
+				Protect(luaT_trybinTM(L, vb, vc, ra, TM_ADD));
+			}
+			vmbreak
+		}
+		vmcase(OP_SUB) {
+			vb = RKB(i)[0];
+			vc = RKC(i)[0];
+			lua_Number nb;
+			lua_Number nc;
+			if (ttisinteger(vb) && ttisinteger(vc)) {
+				lua_Integer ib = ivalue(vb);
+				lua_Integer ic = ivalue(vc);
+				TValue *v = int_get(L, intop(-, ib, ic));
+				setobj2s(L, ra, v);
+			} else if (tonumber(vb, &nb) && tonumber(vc, &nc)) {
+				TValue *v = flt_new(L, luai_numsub(L, nb, nc));
+				setobj2s(L, ra, v);
+			} else {
+				Protect(luaT_trybinTM(L, vb, vc, ra, TM_SUB));
+			}
+			vmbreak
+		}
+		vmcase(OP_MUL) {
+			vb = RKB(i)[0];
+			vc = RKC(i)[0];
+			lua_Number nb;
+			lua_Number nc;
+			if (ttisinteger(vb) && ttisinteger(vc)) {
+				lua_Integer ib = ivalue(vb);
+				lua_Integer ic = ivalue(vc);
+				TValue *v = int_get(L, intop(*, ib, ic));
+				setobj2s(L, ra, v);
+			} else if (tonumber(vb, &nb) && tonumber(vc, &nc)) {
+				TValue *v = flt_new(L, luai_nummul(L, nb, nc));
+				setobj2s(L, ra, v);
+			} else {
+				Protect(luaT_trybinTM(L, vb, vc, ra, TM_MUL));
+			}
+			vmbreak
+		}
+		vmcase(OP_DIV) { /* float division (always with floats) */
+			vb = RKB(i)[0];
+			vc = RKC(i)[0];
+			lua_Number nb;
+			lua_Number nc;
+			if (tonumber(vb, &nb) && tonumber(vc, &nc)) {
+				TValue *v = flt_new(L, luai_numdiv(L, nb, nc));
+				setobj2s(L, ra, v);
+			} else {
+				Protect(luaT_trybinTM(L, vb, vc, ra, TM_DIV));
+			}
+			vmbreak
+		}
+		vmcase(OP_BAND) {
+			vb = RKB(i)[0];
+			vc = RKC(i)[0];
+			lua_Integer ib;
+			lua_Integer ic;
+			if (tointeger(vb, &ib) && tointeger(vc, &ic)) {
+				TValue *v = int_get(L, intop(&, ib, ic));
+				setobj2s(L, ra, v);
+			} else {
+				Protect(luaT_trybinTM(L, vb, vc, ra, TM_BAND));
+			}
+			vmbreak
+		}
+		vmcase(OP_BOR) {
+			vb = RKB(i)[0];
+			vc = RKC(i)[0];
+			lua_Integer ib;
+			lua_Integer ic;
+			if (tointeger(vb, &ib) && tointeger(vc, &ic)) {
+				TValue *v = int_get(L, intop(|, ib, ic));
+				setobj2s(L, ra, v);
+			} else {
+				Protect(luaT_trybinTM(L, vb, vc, ra, TM_BOR));
+			}
+			vmbreak
+		}
+		vmcase(OP_BXOR) {
+			vb = RKB(i)[0];
+			vc = RKC(i)[0];
+			lua_Integer ib;
+			lua_Integer ic;
+			if (tointeger(vb, &ib) && tointeger(vc, &ic)) {
+				TValue *v = int_get(L, intop(^, ib, ic));
+				setobj2s(L, ra, v);
+			} else {
+				Protect(luaT_trybinTM(L, vb, vc, ra, TM_BXOR));
+			}
+			vmbreak
+		}
+		vmcase(OP_SHL) {
+			vb = RKB(i)[0];
+			vc = RKC(i)[0];
+			lua_Integer ib;
+			lua_Integer ic;
+			if (tointeger(vb, &ib) && tointeger(vc, &ic)) {
+				TValue *v = int_get(L, luaV_shiftl(ib, ic));
+				setobj2s(L, ra, v);
+			} else {
+				Protect(luaT_trybinTM(L, vb, vc, ra, TM_SHL));
+			}
+			vmbreak
+		}
+		vmcase(OP_SHR) {
+			vb = RKB(i)[0];
+			vc = RKC(i)[0];
+			lua_Integer ib;
+			lua_Integer ic;
+			if (tointeger(vb, &ib) && tointeger(vc, &ic)) {
+				TValue *v = int_get(L, luaV_shiftl(ib, ic));
+				setobj2s(L, ra, v);
+			} else {
+				Protect(luaT_trybinTM(L, vb, vc, ra, TM_SHR));
+			}
+			vmbreak
+		}
+		vmcase(OP_MOD) {
+			vb = RKB(i)[0];
+			vc = RKC(i)[0];
+			lua_Number nb;
+			lua_Number nc;
+			if (ttisinteger(vb) && ttisinteger(vc)) {
+				lua_Integer ib = ivalue(vb);
+				lua_Integer ic = ivalue(vc);
+				TValue *v = int_get(L, luaV_mod(L, ib, ic));
+				setobj2s(L, ra, v);
+			} else if (tonumber(vb, &nb) && tonumber(vc, &nc)) {
+				lua_Number m;
+				luai_nummod(L, nb, nc, m);
+				TValue *v = flt_new(L, m);
+				setobj2s(L, ra, v);
+			} else {
+				Protect(luaT_trybinTM(L, vb, vc, ra, TM_MOD));
+			}
+			vmbreak
+		}
+		vmcase(OP_IDIV) { /* floor division */
+			vb = RKB(i)[0];
+			vc = RKC(i)[0];
+			lua_Number nb;
+			lua_Number nc;
+			if (ttisinteger(vb) && ttisinteger(vc)) {
+				lua_Integer ib = ivalue(vb);
+				lua_Integer ic = ivalue(vc);
+				TValue *v = int_get(L, luaV_div(L, ib, ic));
+				setobj2s(L, ra, v);
+			} else if (tonumber(vb, &nb) && tonumber(vc, &nc)) {
+				TValue *v = flt_new(L, luai_numidiv(L, nb, nc));
+				setobj2s(L, ra, v);
+			} else {
+				Protect(luaT_trybinTM(L, vb, vc, ra, TM_IDIV));
+			}
+			vmbreak
+		}
+		vmcase(OP_POW) {
+			vb = RKB(i)[0];
+			vc = RKC(i)[0];
+			lua_Number nb;
+			lua_Number nc;
+			if (tonumber(vb, &nb) && tonumber(vc, &nc)) {
+				TValue *v = flt_new(L, luai_numpow(L, nb, nc));
+				setobj2s(L, ra, v);
+			} else {
+				Protect(luaT_trybinTM(L, vb, vc, ra, TM_POW));
+			}
+			vmbreak
+		}
+		vmcase(OP_UNM) {
+			vb = RB(i)[0];
+			lua_Number nb;
+			if (ttisinteger(vb)) {
+				lua_Integer ib = ivalue(vb);
+				TValue *v = int_get(L, intop(-, 0, ib));
+				setobj2s(L, ra, v);
+			} else if (tonumber(vb, &nb)) {
+				TValue *v = flt_new(L, luai_numunm(L, nb));
+				setobj2s(L, ra, v);
+			} else {
+				Protect(luaT_trybinTM(L, vb, vb, ra, TM_UNM));
+			}
+			vmbreak
+		}
+		vmcase(OP_BNOT) {
+			vb = RB(i)[0];
+			lua_Integer ib;
+			if (tointeger(vb, &ib)) {
+				TValue *v = int_get(L, intop(^, ~l_castS2U(0), ib));
+				setobj2s(L, ra, v);
+			} else {
+				Protect(luaT_trybinTM(L, vb, vb, ra, TM_BNOT));
+			}
+			vmbreak
+		}
+		vmcase(OP_NOT) {
+			vb = RB(i)[0];
+			int res = l_isfalse(vb); /* next assignment may change this value */
+			setbvalue(L, ra, res);
+			vmbreak
+		}
+		vmcase(OP_LEN) {
+			Protect(luaV_objlen(L, ra, RB(i)[0]));
+			vmbreak
+		}
+		vmcase(OP_CONCAT) {
+			int b = GETARG_B(i);
+			int c = GETARG_C(i);
+			StkId rb;
+			L->top = base + c + 1; /* mark the end of concat operands */
+			Protect(concat(L, c - b + 1, savestack(L, ra)));
+			ra = RA(i); /* 'concat' may invoke TMs and move the stack */
+			rb = base + b;
+			setobjs2s(L, ra, rb);
+			checkGC(L, (ra >= rb ? ra + 1 : rb));
+			L->top = ci->top; /* restore top */
+			vmbreak
+		}
+		vmcase(OP_JMP) {
+			dojump(ci, i, 0);
+			if (GETARG_sBx(i) < 0)
+				jitenter(L);
+			vmbreak
+		}
+		vmcase(OP_EQ) {
+			rb = RKB(i);
+			rc = RKC(i);
+			Protect(
+					if (luaV_equalobj(L, rb[0], rc[0]) != GETARG_A(i)) ci->u.l.savedpc++; else donextjump(ci);)
+			vmbreak
+		}
+		vmcase(OP_LT) l_lt: {
+			vb = RKB(i)[0];
+			vc = RKC(i)[0];
+			if (ttisnumber(vb) && ttisnumber(vc))
+				quicken(OP_LTNUM);
+			Protect(
+					if (luaV_lessthan(L, vb, vc) != GETARG_A(i)) ci->u.l.savedpc++; else donextjump(ci);)
+			vmbreak
+		}
+		vmcase(OP_LE) l_le: {
+			vb = RKB(i)[0];
+			vc = RKC(i)[0];
+			if (ttisnumber(vb) && ttisnumber(vc))
+				quicken(OP_LENUM);
+			Protect(
+					if (luaV_lessequal(L, vb, vc) != GETARG_A(i)) ci->u.l.savedpc++; else donextjump(ci);)
+			vmbreak
+		}
+		vmcase(OP_TEST) {
+			if (GETARG_C(i) ? l_isfalse(*ra) : !l_isfalse(*ra))
+				ci->u.l.savedpc++;
+			else
+				donextjump(ci);
+			vmbreak
+		}
+		vmcase(OP_TESTSET) {
+			rb = RB(i);
+			if (GETARG_C(i) ? l_isfalse(*rb) : !l_isfalse(*rb))
+				ci->u.l.savedpc++;
+			else {
+				setobjs2s(L, ra, rb);
+				donextjump(ci);
+			}
+			vmbreak
+		}
+		vmcase(OP_CALL) l_call: {
+			int b = GETARG_B(i);
+			int nresults = GETARG_C(i) - 1;
+			if (b != 0) {
+				StkId t = L->top;
+				rb = ra + b;
+				lua_assert(t >= rb);
+				while (t > rb) { /* release the registers above the arguments */
+					TValue *o = *--t;
+					if (o != NULL) {
+						*t = NULL; /* cleared first, as in 'stack_pop' */
+						L->top = t;
+						refDec(L, o);
+					}
+				}
+				L->top = rb; /* else previous instruction set top */
+			}
+			if (ttisLclosure(*ra) && !(L->hookmask & LUA_MASKCALL)) {
+				/* Lua function without call hook: enter it here */
+				Proto *p = clLvalue(*ra)->p;
+				int n = cast_int(L->top - ra) - 1; /* number of real arguments */
+				if (!p->is_vararg && L->stack_last - L->top > p->maxstacksize) {
+					CallInfo *nci = (ci->next ? ci->next : luaE_extendCI(L));
+					for (; n < p->numparams; n++) /* complete missing arguments */
+						ra[n + 1] = luaO_nilobject;
+					for (; n > p->numparams; n--) { /* drop extra ones, from the top */
+						TValue *o = ra[n];
+						ra[n] = NULL;
+						L->top = ra + n;
+						refDec(L, o);
+					}
+					nci->nresults = nresults;
+					nci->func = ra;
+					nci->u.l.base = ra + 1;
+					L->top = nci->top = ra + 1 + p->maxstacksize;
+					nci->u.l.savedpc = p->code;
+					nci->callstatus = CIST_LUA;
+					ci = L->ci = nci;
+					goto newframe;
+				}
+			}
+			if (luaD_precall(L, ra, nresults)) { /* C function? */
+				if (nresults >= 0) {
+					lua_assert(L->top <= ci->top);
+					L->top = ci->top; /* 一般情况 L->top < ci->top，adjust results */
+				}
+				Protect((void )0); /* update 'base' */
+				checkhooks(L);
+				jitenter(L);
+			} else { /* Lua function */
+				ci = L->ci;
+				goto newframe;
+				/* restart luaV_execute over new Lua function */
+			}
+			vmbreak
+		}
+		vmcase(OP_TAILCALL) {
+			int b = GETARG_B(i);
+			if (b != 0)
+				L->top = ra + b; /* else previous instruction set top */
+			lua_assert(GETARG_C(i) - 1 == LUA_MULTRET);
+			if (luaD_precall(L, ra, LUA_MULTRET)) { /* C function? */
+				Protect((void )0); /* update 'base' */
+				checkhooks(L);
+			} else {
+				/* tail call: put called frame (n) in place of caller one (o) */
+				CallInfo *nci = L->ci; /* called frame */
+				CallInfo *oci = nci->previous; /* caller frame */
+				StkId nfunc = nci->func; /* called function */
+				StkId ofunc = oci->func; /* caller function */
+				/* last stack slot filled by 'precall' */
+				StkId lim = nci->u.l.base + getproto(*nfunc)->numparams;
+				StkId ntop = L->top; /* top of called frame */
+				int aux;
+				/* close all upvalues from previous call */
+				if (cl->p->np > 0)
+					luaF_close(L, oci->u.l.base);
+				/* a '__gc' run by a release pushes above every slot touched */
+				if (oci->top > L->top)
+					L->top = oci->top;
+				/* move new frame into old one (pointers, not copies) */
+				for (aux = 0; nfunc + aux < lim; aux++) {
+					TValue *o = ofunc[aux];
+					ofunc[aux] = nfunc[aux];
+					nfunc[aux] = NULL;
+					refDec(L, o);
+				}
+				/* and release what the caller left above it */
+				for (; ofunc + aux < L->top; aux++) {
+					TValue *o = ofunc[aux];
+					ofunc[aux] = NULL;
+					refDec(L, o);
+				}
+				oci->u.l.base = ofunc + (nci->u.l.base - nfunc); /* correct base */
+				oci->top = L->top = ofunc + (ntop - nfunc); /* correct top */
+				oci->u.l.savedpc = nci->u.l.savedpc;
+				oci->callstatus |= CIST_TAIL; /* function was tail called */
+				ci = L->ci = oci; /* remove new frame */
+				lua_assert(L->top == oci->u.l.base + getproto(ofunc[0])->maxstacksize);
+				goto newframe;
+				/* restart luaV_execute over new Lua function */
+			}
+			vmbreak
+		}
+		vmcase(OP_RETURN) {
+			int b = GETARG_B(i);
+			if (cl->p->np > 0)
+				luaF_close(L, base);
+			b = luaD_poscall(L, ci, ra, (b != 0 ? b - 1 : cast_int(L->top - ra)));
+			if (ci->callstatus & CIST_FRESH) /* local 'ci' still from callee */
+				return 0; /* external invocation: return */
+			else { /* invocation via reentry: continue execution */
+				ci = L->ci;
+				if (b)
+					L->top = ci->top;
+				lua_assert(isLua(ci));
+				lua_assert(GET_OPCODE(*((ci)->u.l.savedpc - 1)) == OP_CALL);
+				goto newframe;
+				/* restart luaV_execute over new Lua function */
+			}
+		}
+		vmcase(OP_FORLOOP) {
+			if (ttisinteger(*ra)) { /* integer loop? */
+				lua_Integer step = ivalue(ra[2]);
+				lua_Integer idx = intop(+, ivalue(*ra), step); /* increment index */
+				lua_Integer limit = ivalue(ra[1]);
+				if ((0 < step) ? (idx <= limit) : (limit <= idx)) {
+					ci->u.l.savedpc += GETARG_sBx(i); /* jump back */
+					luaV_setforint(L, ra, idx); /* update internal index... */
+					luaV_setforint(L, ra + 3, idx); /* ...and external index */
+					checkhooks(L);
+					jitenter(L);
+				}
+			} else { /* floating loop */
+				lua_Number step = fltvalue(ra[2]);
+				lua_Number idx = luai_numadd(L, fltvalue(*ra), step); /* inc. index */
+				lua_Number limit = fltvalue(ra[1]);
+				if (luai_numlt(0, step) ?
+						luai_numle(idx, limit) : luai_numle(limit, idx)) {
+					ci->u.l.savedpc += GETARG_sBx(i); /* jump back */
+					luaV_setforflt(L, ra, idx); /* update internal index... */
+					luaV_setforflt(L, ra + 3, idx); /* ...and external index */
+					checkhooks(L);
+					jitenter(L);
+				}
+			}
+			vmbreak
+		}
+		vmcase(OP_FORPREP) {
+			Protect(luaV_forprep(L, ra));
+			ci->u.l.savedpc += GETARG_sBx(i);
+			vmbreak
+		}
+		vmcase(OP_TFORCALL) {
+			if (luaV_tforcall(L, ci, ra, GETARG_C(i))) { /* iterator called? */
+				base = ci->u.l.base;
+				checkhooks(L); /* 'savedpc' is at the OP_TFORLOOP */
+			}
+			i = *(ci->u.l.savedpc++); /* go to next instruction */
+			ra = RA(i);
+			lua_assert(GET_OPCODE(i) == OP_TFORLOOP);
+			goto l_tforloop;
+		}
+		vmcase(OP_TFORLOOP) {
+			l_tforloop: if (!ttisnil(ra[2])) { /* continue loop? */
+				setobjs2s(L, ra, ra + 2); /* save control variable */
+				ci->u.l.savedpc += GETARG_sBx(i); /* jump back */
+				checkhooks(L);
+				jitenter(L);
+			}
+			vmbreak
+		}
+		vmcase(OP_SETLIST) {
+			luaV_setlist(L, ci, ra, i);
+			vmbreak
+		}
+		vmcase(OP_CLOSURE) {
+			Proto *p = cl->p->p[GETARG_Bx(i)];
+			LClosure *ncl = getcached(p, cl->upvals, base); /* cached closure */
+			if (ncl == NULL) /* no match? */
+				pushclosure(L, p, cl->upvals, base, ra); /* create a new one */
+			else
+				setclLvalue(L, ra, ncl); /* push cashed closure */
+//        checkGC(L, ra + 1);
+			condchangemem(L, pre, pos);
+			luai_threadyield(L);
+			vmbreak
+		}
+		vmcase(OP_VARARG) l_vararg: {
+			Protect(luaV_vararg(L, ci, i));
+			vmbreak
+		}
+		vmcase(OP_EXTRAARG) {
+			lua_assert(0);
+			vmbreak
+		}
+		vmcase(OP_GETTABUPCALL) {
+			TValue *upval = cl->upvals[GETARG_B(i)]->v[0];
+			rc = RKC(i);
+			gettableProtected(L, upval, *rc, ra);
+			vmfused(l_call)
+		}
+		vmcase(OP_SELFCALL) {
+			const TValue *aux;
+			rb = RB(i);
+			rc = RKC(i);
+			TString *key = tsvalue(*rc); /* key must be a string */
+			setobj(L, ra + 1, rb);
+			if (luaV_fastget(L, *rb, key, aux, luaH_getstr)) {
+				setobj2s(L, ra, aux);
+			} else
+				Protect(luaV_finishget(L, *rb, *rc, ra, aux));
+			vmfused(l_call)
+		}
+		vmcase(OP_VARARGCALL) {
+			Instruction call = *ci->u.l.savedpc; /* the OP_CALL that follows */
+			StkId fn = RA(call);
+			if (*fn != NULL && ttislcf(*fn) && fvalue(*fn) == G(L)->select
+					&& !L->hookmask) {
+				/* 'select(x, ...)' without the call: read the varargs in place */
+				int n = cast_int(base - ci->func) - cl->p->numparams - 1;
+				int nres = GETARG_C(call) - 1; /* LUA_MULTRET in a tail call */
+				int count = 0; /* is it 'select('#', ...)'? */
+				lua_Integer first = 1;
+				int m, j;
+				if (n < 0)
+					n = 0;
+				if (ttisstring(fn[1]) && *svalue(fn[1]) == '#') {
+					count = 1;
+					m = 1;
+				} else if (ttisinteger(fn[1])) {
+					first = ivalue(fn[1]); /* as in 'luaB_select' */
+					if (first < 0)
+						first += n + 1;
+					else if (first > n + 1)
+						first = n + 1;
+					if (first < 1)
+						goto l_vararg; /* let 'select' raise the error */
+					m = n + 1 - cast_int(first);
+				} else
+					goto l_vararg;
+				if (nres < 0) { /* all results */
+					nres = m;
+					Protect(luaD_checkstack(L, m));
+					fn = RA(call);
+				}
+				for (j = 0; j < nres && j < m; j++)
+					setobj2s(L, fn + j,
+							count ? int_get(L, n) : *(base - n + first - 1 + j));
+				for (; j < nres || j < 2; j++) /* nil results, then 'fn[1]' */
+					setnilvalue(fn + j);
+				if (GETARG_C(call) == 0) {
+					/* release the registers above, as the call would have */
+					for (rb = fn + nres; rb < ci->top && *rb != NULL; rb++) {
+						TValue *o = *rb;
+						*rb = NULL;
+						refDec(L, o);
+					}
+					L->top = fn + nres;
+				} else
+					L->top = ci->top;
+				ci->u.l.savedpc++; /* skip the call (an OP_RETURN follows a tail call) */
+				vmbreak
+			}
+			goto l_vararg;
+		}
+		vmcase(OP_EQBOOL) {
+			rb = RKB(i);
+			rc = RKC(i);
+			Protect(
+					if (luaV_equalobj(L, rb[0], rc[0]) != GETARG_A(i)) ci->u.l.savedpc++; else donextjump(ci);)
+			vmfused(l_loadbool)
+		}
+		vmcase(OP_LTBOOL) {
+			Protect(
+					if (luaV_lessthan(L, RKB(i)[0], RKC(i)[0]) != GETARG_A(i)) ci->u.l.savedpc++; else donextjump(ci);)
+			vmfused(l_loadbool)
+		}
+		vmcase(OP_LEBOOL) {
+			Protect(
+					if (luaV_lessequal(L, RKB(i)[0], RKC(i)[0]) != GETARG_A(i)) ci->u.l.savedpc++; else donextjump(ci);)
+			vmfused(l_loadbool)
+		}
+		vmcase(OP_LTNUM) {
+			vb = RKB(i)[0];
+			vc = RKC(i)[0];
+			if (!(ttisnumber(vb) && ttisnumber(vc))) {
+				quicken(OP_LT);
+				goto l_lt;
+			}
+			if (LTnum(vb, vc) != GETARG_A(i))
+				ci->u.l.savedpc++;
+			else
+				donextjump(ci);
+			vmbreak
+		}
+		vmcase(OP_LENUM) {
+			vb = RKB(i)[0];
+			vc = RKC(i)[0];
+			if (!(ttisnumber(vb) && ttisnumber(vc))) {
+				quicken(OP_LE);
+				goto l_le;
+			}
+			if (LEnum(vb, vc) != GETARG_A(i))
+				ci->u.l.savedpc++;
+			else
+				donextjump(ci);
+			vmbreak
+		}
+		vmcase(OP_GETTABLEI) {
+			lua_Unsigned n;
+			vb = RB(i)[0];
+			vc = RKC(i)[0];
+			if (!(ttistable(vb) && ttisinteger(vc)
+					&& (n = l_castS2U(ivalue(vc)) - 1u) < hvalue(vb)->sizearray)) {
+				quicken(OP_GETTABLE);
+				goto l_gettable;
+			}
+			if (!ttisnil(hvalue(vb)->array[n])) {
+				setobj2s(L, ra, hvalue(vb)->array[n]);
+			} else /* absent key: try '__index' */
+				Protect(luaV_finishget(L, vb, vc, ra, hvalue(vb)->array[n]));
+			vmbreak
+		}
+		vmcase(OP_GETTABLES) {
+			const TValue *slot;
+			vb = RB(i)[0];
+			vc = RKC(i)[0];
+			if (!(ttistable(vb) && ttisshrstring(vc))) {
+				quicken(OP_GETTABLE);
+				goto l_gettable;
+			}
+			slot = luaH_getshortstr(hvalue(vb), tsvalue(vc));
+			if (!ttisnil(slot)) {
+				setobj2s(L, ra, slot);
+			} else /* absent key: try '__index' */
+				Protect(luaV_finishget(L, vb, vc, ra, slot));
+			vmbreak
+		}
+		}
+	}
+}
+
+#undef checkhooks
+#undef jitenter
+#undef tracecode
+#undef vmfetch
@@ -0,0 +1,134 @@
+/*
+ ** Instructions shared by the interpreter ('lvmexec.h') and the
+ ** baseline compiler ('ljit.c'), so both run the same code
+ ** See Copyright Notice in lua.h
+ */
+
+#ifndef lvmops_h
+#define lvmops_h
+
+#include "ldo.h"
+#include "lgc.h"
+#include "lopcodes.h"
+#include "lstate.h"
+#include "ltable.h"
+#include "ltm.h"
+#include "lvm.h"
+
+/*
+ ** OP_TFORCALL: steps of 'pairs', and of 'ipairs' over a table without
+ ** '__index', are done here without calling the iterator. Otherwise
+ ** the iterator is called and the result is 1: the stack may have
+ ** moved and hooks may have been set.
+ */
+static inline int luaV_tforcall(lua_State *L, CallInfo *ci, StkId ra, int c) {
+	StkId cb = ra + 4; /* call base */
+	lua_CFunction f = ttislcf(*ra) ? fvalue(*ra) : NULL;
+	if (f == G(L)->iternext && ttistable(ra[1])) { /* 'pairs'? */
+		TValue *cursor = ra[3];
+		if (ttisnil(cursor)) { /* first step: create the cursor */
+			cursor = luaC_newobjNotGC(L, LUA_TNUMINT, sizeof(TValue));
+			cursor->value_.i = 0;
+			setobj2s(L, ra + 3, cursor);
+		}
+		setobjs2s(L, cb, ra + 2);
+		if (!luaH_nextc(L, hvalue(ra[1]), cb, &cursor->value_.i))
+			setnilvalue(cb);
+		if (c < 2)
+			setnilvalue(cb + 1);
+		for (; c > 2; c--)
+			setnilvalue(cb + c - 1);
+	} else if (f == G(L)->iteripairs && ttistable(ra[1])
+			&& ttisinteger(ra[2])
+			&& fasttm(L, hvalue(ra[1])->metatable, TM_INDEX) == NULL) {
+		/* 'ipairs' over a table without '__index': raw reads */
+		Table *h = hvalue(ra[1]);
+		lua_Integer n = ivalue(ra[2]) + 1;
+		const TValue *v =
+				(l_castS2U(n) - 1u < h->sizearray) ?
+						h->array[n - 1] : luaH_getint(L, h, n);
+		if (ttisnil(v))
+			setnilvalue(cb);
+		else
+			setobj2s(L, cb, int_get(L, n));
+		if (c < 2)
+			setnilvalue(cb + 1);
+		else
+			setobj2s(L, cb + 1, v);
+		for (; c > 2; c--)
+			setnilvalue(cb + c - 1);
+	} else {
+		StkId rb = cb + 3; /* func. + 2 args (state and index) */
+		setobjs2s(L, cb + 2, ra + 2); /* index */
+		setobjs2s(L, cb + 1, ra + 1); /* table */
+		setobjs2s(L, cb, ra);
+		while (L->top > rb) { /* release the dead registers above */
+			--L->top;
+			refDec(L, *(L->top));
+			*L->top = NULL;
+		}
+		L->top = rb;
+		luaD_call(L, cb, c);
+		L->top = ci->top;
+		return 1;
+	}
+	return 0;
+}
+
+/*
+ ** OP_SETLIST; 'savedpc' is past the instruction (and is moved past
+ ** its OP_EXTRAARG when there is one)
+ */
+static inline void luaV_setlist(lua_State *L, CallInfo *ci, StkId ra,
+		Instruction i) {
+	int n = GETARG_B(i);
+	int c = GETARG_C(i);
+	unsigned int last, start;
+	Table *h;
+	if (n == 0)
+		n = cast_int(L->top - ra) - 1;
+	if (c == 0) {
+		lua_assert(GET_OPCODE(*ci->u.l.savedpc) == OP_EXTRAARG);
+		c = GETARG_Ax(*ci->u.l.savedpc++);
+	}
+	h = hvalue(*ra);
+	start = (c - 1) * LFIELDS_PER_FLUSH;
+	last = start + n;
+	if (last > h->sizearray) /* needs more space? */
+		luaH_resizearray(L, h, last); /* preallocate it at once */
+	for (; n > 0; n--) {
+		StkId val = ++ra;
+		luaH_setint(L, h, ++start, *val);
+		luaC_barrierback(L, (TValue*) h, *val);
+	}
+	while (L->top > ci->top) { /* open call left values above the frame */
+		--L->top;
+		refDec(L, *(L->top));
+		*L->top = NULL;
+	}
+	L->top = ci->top; /* correct top (in case of previous open call) */
+}
+
+/* OP_VARARG; it may reallocate the stack */
+static inline void luaV_vararg(lua_State *L, CallInfo *ci, Instruction i) {
+	StkId base = ci->u.l.base;
+	StkId ra;
+	int b = GETARG_B(i) - 1; /* required results */
+	int j;
+	int n = cast_int(base - ci->func) - clLvalue(*ci->func)->p->numparams - 1;
+	if (n < 0) /* less arguments than parameters? */
+		n = 0; /* no vararg arguments */
+	if (b < 0) { /* B == 0? */
+		b = n; /* get all var. arguments */
+		luaD_checkstack(L, n);
+		base = ci->u.l.base; /* previous call may change the stack */
+		L->top = base + GETARG_A(i) + n;
+	}
+	ra = base + GETARG_A(i);
+	for (j = 0; j < b && j < n; j++)
+		setobjs2s(L, ra + j, base - n + j);
+	for (; j < b; j++) /* complete required results with nil */
+		setnilvalue(ra + j);
+}
+
+#endif
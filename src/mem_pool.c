@@ -177,6 +177,7 @@ static arena_obj* pool_new_arena() {
 			arenas[i].address = 0; /* mark as unassociated */
 			arenas[i].nextarena = &arenas[i + 1];
 		}
+		arenas[i].address = 0;
 		arenas[i].nextarena = NULL;
 		/* Update globals. */
 		unused_arena_objects = &arenas[narenas];
@@ -4,7 +4,7 @@
  *  E-mail: 1109162935@qq.com
  */
 //@formatter:off
-static void *opcode_targets[OP_EXTRAARG+1] = {
+static void *opcode_targets[NUM_OPCODES] = {
   &&TARGET_OP_MOVE			,
   &&TARGET_OP_LOADK		  ,
   &&TARGET_OP_LOADKX		,
@@ -52,5 +52,15 @@ static void *opcode_targets[OP_EXTRAARG+1] = {
   &&TARGET_OP_CLOSURE   ,
   &&TARGET_OP_VARARG    ,
   &&TARGET_OP_EXTRAARG  ,
+  &&TARGET_OP_GETTABUPCALL,
+  &&TARGET_OP_SELFCALL  ,
+  &&TARGET_OP_EQBOOL    ,
+  &&TARGET_OP_LTBOOL    ,
+  &&TARGET_OP_LEBOOL    ,
+  &&TARGET_OP_VARARGCALL,
+  &&TARGET_OP_LTNUM     ,
+  &&TARGET_OP_LENUM     ,
+  &&TARGET_OP_GETTABLEI ,
+  &&TARGET_OP_GETTABLES ,
 };
 //@formatter:on